@@ -0,0 +1,165 @@
+// Counts heap allocations and time per received packet on the decode + dispatch path.
+// The registry path is the old PacketRegistry (map lookup, std::function, unique_ptr per packet), kept here
+// as the reference. The exit code is non zero if the real receive path allocates in steady state.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include "network/packet_dispatch.h"
+#include "network/stream_buffer.h"
+
+static constexpr int ROUNDS = 20000;
+
+static uint64_t gAllocations = 0;
+
+void* operator new(size_t size) {
+    gAllocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// -------------------- reference: the old registry --------------------
+
+using Factory = std::function<std::unique_ptr<IPacket>()>;
+
+static std::unordered_map<PacketType, Factory>& registryMap() {
+    static std::unordered_map<PacketType, Factory> map;
+    return map;
+}
+
+template <typename T>
+static void registerPacket() {
+    registryMap()[T::TYPE] = []() -> std::unique_ptr<IPacket> { return std::make_unique<T>(); };
+}
+
+// the old nextPacket, minus the handler call which went through a virtual function
+static bool registryNext(StreamBuffer& in, std::unique_ptr<IPacket>& out) {
+    out.reset();
+    if (in.readable() < 3) return false;
+
+    const uint8_t* header = in.readPtr();
+    const uint16_t payloadLen = static_cast<uint16_t>((header[1] << 8) | header[2]);
+    const size_t frameSize = 3 + static_cast<size_t>(payloadLen);
+    if (in.readable() < frameSize) return false;
+
+    auto it = registryMap().find(static_cast<PacketType>(header[0]));
+    if (it != registryMap().end()) {
+        std::unique_ptr<IPacket> pkt = it->second();
+        if (pkt->deserialize(in.readPtr() + 3, payloadLen)) out = std::move(pkt);
+    }
+    in.consume(frameSize);
+    return true;
+}
+
+// -------------------- bench --------------------
+
+struct Result {
+    double nsPerPacket;
+    double allocationsPerPacket;
+    uint64_t packets;
+};
+
+// one round is one of each packet, as they would arrive on a connection
+static std::vector<uint8_t> buildRound() {
+    std::vector<uint8_t> round;
+
+    ConnectPacket connect{};
+    std::strcpy(connect.name, "dispatch bench");
+    connect.id = -1;
+    PacketIO::writePacket(round, connect);
+
+    PlayerJoinPacket join{};
+    std::strcpy(join.name, "dispatch bench");
+    join.id = 42;
+    PacketIO::writePacket(round, join);
+
+    PlayerUpdatePacket update{};
+    update.id = 42;
+    update.posX = 100;
+    update.posY = -100;
+    for (int i = 0; i < 6; i++) PacketIO::writePacket(round, update);
+
+    PlayerDisconnectPacket disconnect{};
+    disconnect.id = 42;
+    PacketIO::writePacket(round, disconnect);
+
+    return round;
+}
+
+template <typename Step>
+static Result run(const std::vector<uint8_t>& round, Step&& step) {
+    StreamBuffer in;
+
+    // warm up so everything reaches its steady state size, every round is consumed completely
+    std::memcpy(in.writePtr(), round.data(), round.size());
+    in.commit(round.size());
+    while (step(in)) {}
+
+    const uint64_t before = gAllocations;
+    uint64_t packets = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        std::memcpy(in.writePtr(), round.data(), round.size());
+        in.commit(round.size());
+        while (step(in)) packets++;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return Result{
+        std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(packets),
+        static_cast<double>(gAllocations - before) / static_cast<double>(packets),
+        packets
+    };
+}
+
+int main() {
+    registerPacket<ConnectPacket>();
+    registerPacket<PlayerJoinPacket>();
+    registerPacket<PlayerDisconnectPacket>();
+    registerPacket<PlayerUpdatePacket>();
+
+    const std::vector<uint8_t> round = buildRound();
+    uint64_t checksum = 0;
+
+    const Result registry = run(round, [&](StreamBuffer& in) {
+        std::unique_ptr<IPacket> pkt;
+        if (!registryNext(in, pkt)) return false;
+        if (pkt) checksum += static_cast<uint64_t>(pkt->type());
+        return true;
+    });
+
+    AnyPacket packet;
+    const Result dispatch = run(round, [&](StreamBuffer& in) {
+        if (PacketIO::nextPacket(in, packet) != Net::Result::NET_OK) return false;
+        PacketDispatch::visit(packet, [&](const auto& p) { checksum += static_cast<uint64_t>(p.TYPE); });
+        return true;
+    });
+
+    std::printf("%llu packets per path (checksum %llu)\n", static_cast<unsigned long long>(dispatch.packets),
+                static_cast<unsigned long long>(checksum));
+    std::printf("%-10s %12s %14s\n", "path", "ns/packet", "allocs/packet");
+    std::printf("%-10s %12.2f %14.3f\n", "registry", registry.nsPerPacket, registry.allocationsPerPacket);
+    std::printf("%-10s %12.2f %14.3f\n", "dispatch", dispatch.nsPerPacket, dispatch.allocationsPerPacket);
+
+    if (dispatch.allocationsPerPacket != 0.0) {
+        std::printf("FAIL: the receive path allocated\n");
+        return 1;
+    }
+    return 0;
+}
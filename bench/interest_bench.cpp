@@ -0,0 +1,83 @@
+// Compares the state update fan-out of a plain broadcast with the area of interest grid.
+// Players random walk over a square world, every one of them sends one update per tick. The broadcast sends
+// each update to everybody else, the grid only to the players in range, plus the enter and leave packets.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "network/interest_grid.h"
+
+static constexpr int TICKS = 300;
+static constexpr int32_t WORLD = 32768;
+static constexpr int32_t STEP = 48;
+static constexpr int UPDATE_BYTES = 6 + 6;      // datagram header + bit packed update
+static constexpr int ENTER_BYTES = 3 + 8 + UPDATE_BYTES;   // join frame + its position
+static constexpr int LEAVE_BYTES = 3 + 6;
+
+struct Walker {
+    int32_t x;
+    int32_t y;
+};
+
+static void run(int players) {
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int32_t> place(0, WORLD);
+    std::uniform_int_distribution<int32_t> step(-STEP, STEP);
+
+    std::vector<Walker> walkers(players);
+    for (Walker& w : walkers) w = {place(rng), place(rng)};
+
+    InterestGrid grid;
+    grid.resize(players);
+
+    uint64_t broadcastBytes = 0;
+    uint64_t interestBytes = 0;
+    uint64_t events = 0;
+    double updateNs = 0;
+
+    for (int tick = 0; tick < TICKS; tick++) {
+        for (int id = 0; id < players; id++) {
+            Walker& w = walkers[id];
+            w.x = std::clamp(w.x + step(rng), 0, WORLD);
+            w.y = std::clamp(w.y + step(rng), 0, WORLD);
+            grid.setPosition(id, w.x, w.y);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const std::vector<InterestEvent>& changes = grid.update();
+        updateNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        for (const InterestEvent& event : changes) {
+            interestBytes += event.enter ? ENTER_BYTES : LEAVE_BYTES;
+        }
+        events += changes.size();
+
+        for (int id = 0; id < players; id++) {
+            broadcastBytes += static_cast<uint64_t>(players - 1) * UPDATE_BYTES;
+            interestBytes += grid.visibleTo(id).size() * UPDATE_BYTES;
+        }
+    }
+
+    const InterestStats stats = grid.stats();
+    std::printf("%8d %14.1f %14.1f %7.1f%% %10.1f %12.2f %10llu\n", players,
+                broadcastBytes / 1024.0 / TICKS, interestBytes / 1024.0 / TICKS,
+                100.0 * static_cast<double>(interestBytes) / static_cast<double>(broadcastBytes),
+                static_cast<double>(stats.visiblePairs) / players, updateNs / TICKS / 1000.0,
+                static_cast<unsigned long long>(events));
+}
+
+int main() {
+    std::printf("%d ticks, world %d x %d, range %d, cell %d, hysteresis %d\n", TICKS, WORLD, WORLD,
+                INTEREST_DEFAULT_RANGE, INTEREST_DEFAULT_CELL, INTEREST_DEFAULT_HYSTERESIS);
+    std::printf("%8s %14s %14s %8s %10s %12s %10s\n", "players", "bcast KiB/t", "interest KiB/t", "ratio",
+                "visible", "update us", "events");
+
+    for (const int players : {16, 64, 256, 1024}) {
+        run(players);
+    }
+    return 0;
+}
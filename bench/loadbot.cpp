@@ -0,0 +1,553 @@
+// Load test: one process plays thousands of scripted players against a server.
+// Every bot is a real Client that connects, joins with a ConnectPacket, walks around with PlayerInputPackets and
+// leaves again, so the server sees the same traffic humans would cause. Bots are polled from a single thread,
+// staggered over the update interval so the load is even. With --local the server runs in this process too and
+// its tick time is part of the report. Thresholds turn the run into a pass / fail check for CI.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "manager/console_manager.h"
+#include "manager/server_manager.h"
+#include "network/client.h"
+#include "network/packets.h"
+#include "network/packets/connect_packet.h"
+#include "player_movement.h"
+#include "util/net.h"
+
+// How often the main loop looks at the bots, also the resolution of the join latency
+static constexpr int POLL_MS = 1;
+// Chance per input that a bot walks somewhere else
+static constexpr double TURN_CHANCE = 0.05;
+
+// exit codes
+static constexpr int EXIT_PASSED = 0;
+static constexpr int EXIT_REGRESSED = 1;
+static constexpr int EXIT_SETUP = 2;
+
+static std::atomic<bool> gQuit{false};
+
+struct Options {
+    const char* host = nullptr;
+    uint16_t port = 0;
+
+    int bots = 100;
+    double connectRate = 100;       // new connections per second
+    double churnRate = 0;           // joined bots per second that leave and get replaced
+    double moveRate = 30;           // inputs per bot per second
+    double updateRate = 60;         // Client::update() per bot per second
+    double durationS = 30;
+    double reportS = 1;
+    double joinTimeoutMs = 5000;
+    uint32_t seed = 1;
+    bool local = false;
+    double tickRate = TICK_DEFAULT_RATE;
+    bool verbose = false;
+
+    // thresholds, negative ones are not checked
+    double maxJoinP99Ms = -1;
+    long maxJoinFailures = -1;
+    double minUpdatesPerS = -1;
+    double maxTickAvgMs = -1;
+};
+
+struct Bot {
+    std::unique_ptr<Client> client;
+    double startedMs = 0;       // connect() was called
+    double nextUpdateMs = 0;
+    double nextMoveMs = 0;
+    uint64_t countedUpdates = 0;
+    uint8_t buttons = 0;
+    bool joined = false;
+};
+
+struct Totals {
+    uint64_t connects = 0;
+    uint64_t joins = 0;
+    uint64_t refused = 0;       // closed or failed before the join finished
+    uint64_t timeouts = 0;
+    uint64_t kicked = 0;        // closed by the server after the join
+    uint64_t left = 0;          // churn
+    uint64_t inputs = 0;
+    uint64_t updates = 0;       // state updates of other players received
+
+    uint64_t failures() const {
+        return refused + timeouts + kicked;
+    }
+};
+
+static void onSignal(int) {
+    gQuit = true;
+}
+
+static double nowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// nearest rank, p in percent
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0;
+
+    const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(values.size())));
+    const size_t index = std::clamp<size_t>(rank, 1, values.size()) - 1;
+    std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+    return values[index];
+}
+
+static void printUsage(const char* program) {
+    std::fprintf(stderr,
+        "Usage: %s <ip> <port> [options]\n"
+        "  --bots <n>               bots kept connected (default 100)\n"
+        "  --connect-rate <n>       new connections per second (default 100)\n"
+        "  --churn <n>              joined bots per second that leave and are replaced (default 0)\n"
+        "  --move-rate <hz>         inputs per bot per second (default 30)\n"
+        "  --update-rate <hz>       network updates per bot per second (default 60)\n"
+        "  --duration <s>           length of the run (default 30)\n"
+        "  --report <s>             seconds between report lines (default 1)\n"
+        "  --join-timeout <ms>      a join taking longer counts as failed (default 5000)\n"
+        "  --seed <n>               bot movement and churn choices (default 1)\n"
+        "  --local                  host the server in this process on ip:port, reports its tick time\n"
+        "  --tick-rate <hz>         tick rate of the --local server (default %.0f)\n"
+        "  --verbose                print the client and server log\n"
+        "Thresholds, a run that misses one exits with %d:\n"
+        "  --max-join-p99 <ms>      99th percentile of the join latency\n"
+        "  --max-join-failures <n>  refused, timed out and kicked bots\n"
+        "  --min-updates <n>        state updates per second received by all bots together\n"
+        "  --max-tick-avg <ms>      average server tick time, needs --local\n",
+        program, TICK_DEFAULT_RATE, EXIT_REGRESSED);
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    if (argc < 3) return false;
+
+    options.host = argv[1];
+    if (!Net::parsePort(argv[2], options.port)) return false;
+
+    for (int i = 3; i < argc; i++) {
+        const char* name = argv[i];
+
+        if (std::strcmp(name, "--local") == 0) {
+            options.local = true;
+            continue;
+        }
+        if (std::strcmp(name, "--verbose") == 0) {
+            options.verbose = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) return false;
+        const char* value = argv[++i];
+
+        if (std::strcmp(name, "--bots") == 0) options.bots = std::atoi(value);
+        else if (std::strcmp(name, "--connect-rate") == 0) options.connectRate = std::atof(value);
+        else if (std::strcmp(name, "--churn") == 0) options.churnRate = std::atof(value);
+        else if (std::strcmp(name, "--move-rate") == 0) options.moveRate = std::atof(value);
+        else if (std::strcmp(name, "--update-rate") == 0) options.updateRate = std::atof(value);
+        else if (std::strcmp(name, "--duration") == 0) options.durationS = std::atof(value);
+        else if (std::strcmp(name, "--report") == 0) options.reportS = std::atof(value);
+        else if (std::strcmp(name, "--join-timeout") == 0) options.joinTimeoutMs = std::atof(value);
+        else if (std::strcmp(name, "--seed") == 0) options.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (std::strcmp(name, "--tick-rate") == 0) options.tickRate = std::atof(value);
+        else if (std::strcmp(name, "--max-join-p99") == 0) options.maxJoinP99Ms = std::atof(value);
+        else if (std::strcmp(name, "--max-join-failures") == 0) options.maxJoinFailures = std::atol(value);
+        else if (std::strcmp(name, "--min-updates") == 0) options.minUpdatesPerS = std::atof(value);
+        else if (std::strcmp(name, "--max-tick-avg") == 0) options.maxTickAvgMs = std::atof(value);
+        else return false;
+    }
+
+    return options.bots > 0 && options.connectRate > 0 && options.churnRate >= 0 && options.moveRate > 0 &&
+           options.updateRate > 0 && options.durationS > 0 && options.reportS > 0 && options.joinTimeoutMs > 0;
+}
+
+// every bot holds two sockets and a local server one more per bot
+static void raiseFileLimit() {
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return;
+
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+class Swarm {
+public:
+    Swarm(const Options& options, Net::Address address) : mOptions(options), mAddress(address), mRandom(options.seed) {
+        mBots.resize(static_cast<size_t>(options.bots));
+    }
+
+    void step(double now);
+    void drop(Bot& bot);
+    void dropAll();
+    void countAllUpdates();
+
+    size_t alive() const;
+    size_t joined() const;
+
+    Totals totals{};
+    std::vector<double> joinLatencies;      // whole run, ms
+    size_t reportedLatencies = 0;           // index of the first one of the current interval
+
+    double averageRttMs() const;
+
+private:
+    bool spawn(Bot& bot, double now);
+    void move(Bot& bot);
+    void countUpdates(Bot& bot);
+
+    const Options& mOptions;
+    Net::Address mAddress;
+    std::mt19937 mRandom;
+    std::vector<Bot> mBots;
+
+    double mLastMs = 0;
+    double mConnectBudget = 0;
+    double mChurnBudget = 0;
+    uint32_t mNextName = 0;
+};
+
+bool Swarm::spawn(Bot& bot, double now) {
+    bot = Bot{};
+    bot.client = std::make_unique<Client>(mAddress);
+    bot.startedMs = now;
+    bot.nextUpdateMs = now;
+    totals.connects++;
+
+    bot.client->connect();
+    if (bot.client->mState != NetState::CONNECTING) {
+        totals.refused++;
+        bot.client.reset();
+        return false;
+    }
+
+    ConnectPacket connectPacket{};
+    connectPacket.id = -1;
+    std::snprintf(connectPacket.name, sizeof(connectPacket.name), "bot%u", mNextName++);
+
+    if (bot.client->sendPacket(connectPacket) != Net::Result::NET_OK) {
+        totals.refused++;
+        bot.client.reset();
+        return false;
+    }
+    return true;
+}
+
+void Swarm::countUpdates(Bot& bot) {
+    const uint64_t received = bot.client->mRemotePlayers.stats().received;
+    totals.updates += received - bot.countedUpdates;
+    bot.countedUpdates = received;
+}
+
+// the client's destructor tells the server it left
+void Swarm::drop(Bot& bot) {
+    countUpdates(bot);
+    bot.client.reset();
+    bot.joined = false;
+}
+
+void Swarm::countAllUpdates() {
+    for (Bot& bot : mBots) {
+        if (bot.client) countUpdates(bot);
+    }
+}
+
+void Swarm::dropAll() {
+    for (Bot& bot : mBots) {
+        if (bot.client) drop(bot);
+    }
+}
+
+// walk in one direction for a while, then pick another, sometimes standing still
+void Swarm::move(Bot& bot) {
+    static const uint8_t DIRECTIONS[] = {
+        0,
+        static_cast<uint8_t>(PlayerButton::BTN_UP),
+        static_cast<uint8_t>(PlayerButton::BTN_DOWN),
+        static_cast<uint8_t>(PlayerButton::BTN_LEFT),
+        static_cast<uint8_t>(PlayerButton::BTN_RIGHT),
+        static_cast<uint8_t>(PlayerButton::BTN_UP) | static_cast<uint8_t>(PlayerButton::BTN_LEFT),
+        static_cast<uint8_t>(PlayerButton::BTN_UP) | static_cast<uint8_t>(PlayerButton::BTN_RIGHT),
+        static_cast<uint8_t>(PlayerButton::BTN_DOWN) | static_cast<uint8_t>(PlayerButton::BTN_LEFT),
+        static_cast<uint8_t>(PlayerButton::BTN_DOWN) | static_cast<uint8_t>(PlayerButton::BTN_RIGHT),
+    };
+
+    if (std::uniform_real_distribution<double>(0, 1)(mRandom) < TURN_CHANCE) {
+        bot.buttons = DIRECTIONS[std::uniform_int_distribution<size_t>(0, std::size(DIRECTIONS) - 1)(mRandom)];
+    }
+
+    bot.client->sendInput(bot.buttons);
+    totals.inputs++;
+}
+
+/**
+ *
+ * One pass over the swarm: connect and churn as the rates allow, then update every bot that is due
+ *
+ * @param now
+ */
+void Swarm::step(double now) {
+    const double elapsedS = mLastMs > 0 ? (now - mLastMs) / 1000.0 : 0;
+    mLastMs = now;
+
+    // new connections fill empty slots, the budget does not pile up while the swarm is full
+    mConnectBudget += mOptions.connectRate * elapsedS;
+    for (Bot& bot : mBots) {
+        if (mConnectBudget < 1) break;
+        if (bot.client) continue;
+
+        spawn(bot, now);
+        mConnectBudget -= 1;
+    }
+    mConnectBudget = std::min(mConnectBudget, 1.0);
+
+    if (mOptions.churnRate > 0) {
+        mChurnBudget += mOptions.churnRate * elapsedS;
+
+        const size_t ready = joined();
+        while (mChurnBudget >= 1 && ready > 0) {
+            // random joined bot, there is one so this ends
+            Bot& bot = mBots[std::uniform_int_distribution<size_t>(0, mBots.size() - 1)(mRandom)];
+            if (!bot.joined) continue;
+
+            drop(bot);
+            totals.left++;
+            mChurnBudget -= 1;
+            if (joined() == 0) break;
+        }
+        mChurnBudget = std::min(mChurnBudget, 1.0);
+    }
+
+    const double updateMs = 1000.0 / mOptions.updateRate;
+    const double moveMs = 1000.0 / mOptions.moveRate;
+
+    for (Bot& bot : mBots) {
+        if (!bot.client) continue;
+
+        // joining bots are looked at every pass, the join latency is only as exact as that
+        if (bot.joined && now < bot.nextUpdateMs) continue;
+
+        if (bot.joined && now >= bot.nextMoveMs) {
+            move(bot);
+            bot.nextMoveMs = std::max(bot.nextMoveMs + moveMs, now);
+        }
+
+        bot.client->update();
+
+        if (bot.client->mState == NetState::CLOSED) {
+            (bot.joined ? totals.kicked : totals.refused)++;
+            drop(bot);
+            continue;
+        }
+
+        if (!bot.joined) {
+            if (bot.client->mState == NetState::READY) {
+                const double joinedMs = nowMs();
+                joinLatencies.push_back(joinedMs - bot.startedMs);
+                totals.joins++;
+
+                bot.joined = true;
+                // spread the bots over the interval
+                bot.nextUpdateMs = joinedMs + std::uniform_real_distribution<double>(0, updateMs)(mRandom);
+                bot.nextMoveMs = joinedMs + std::uniform_real_distribution<double>(0, moveMs)(mRandom);
+            } else if (now - bot.startedMs > mOptions.joinTimeoutMs) {
+                totals.timeouts++;
+                drop(bot);
+            }
+            continue;
+        }
+
+        bot.nextUpdateMs = std::max(bot.nextUpdateMs + updateMs, now);
+    }
+}
+
+size_t Swarm::alive() const {
+    return static_cast<size_t>(std::count_if(mBots.begin(), mBots.end(), [](const Bot& bot) { return bot.client != nullptr; }));
+}
+
+size_t Swarm::joined() const {
+    return static_cast<size_t>(std::count_if(mBots.begin(), mBots.end(), [](const Bot& bot) { return bot.joined; }));
+}
+
+// input round trip of the joined bots, the ones with a measurement
+double Swarm::averageRttMs() const {
+    double sum = 0;
+    int count = 0;
+    for (const Bot& bot : mBots) {
+        if (!bot.joined) continue;
+
+        const double rtt = bot.client->mPrediction.stats().rttMs;
+        if (rtt <= 0) continue;
+        sum += rtt;
+        count++;
+    }
+    return count > 0 ? sum / count : 0;
+}
+
+//------------------------------------------------------------------------------------
+// Load test entry point
+//------------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return EXIT_SETUP;
+    }
+
+    // Initialization
+    //--------------------------------------------------------------------------------------
+    raiseFileLimit();
+    Net::init();
+
+    // thousands of clients would bury the report
+    Console& console = ConsoleManager::create();
+    console.setOutputLevel(options.verbose ? SUCCESS : FATAL);
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    Net::Address address{};
+    if (Net::resolve(options.host, options.port, address) != Net::Result::NET_OK) {
+        std::fprintf(stderr, "Could not resolve %s\n", options.host);
+        return EXIT_SETUP;
+    }
+
+    if (options.local) {
+        Server& server = ServerManager::create(address, PLAYER_ID_MAX + 1);
+        if (!server.isListening()) {
+            std::fprintf(stderr, "Could not listen on %s:%u\n", options.host, options.port);
+            ServerManager::stop();
+            return EXIT_SETUP;
+        }
+        server.setTickRate(options.tickRate);
+        server.run();
+    } else if (options.maxTickAvgMs >= 0) {
+        std::fprintf(stderr, "--max-tick-avg needs --local, the tick time of a remote server is not known\n");
+        return EXIT_SETUP;
+    }
+
+    Swarm swarm(options, address);
+
+    std::printf("%d bots against %s:%u%s, %.0f connects/s, %.1f churn/s, %.0f inputs/s per bot, %.0f s\n",
+        options.bots, options.host, options.port, options.local ? " (local)" : "", options.connectRate,
+        options.churnRate, options.moveRate, options.durationS);
+    std::printf("%7s %6s %6s %7s %6s %9s %9s %10s %10s %8s %10s\n", "time", "bots", "joined", "joins", "fails",
+        "join p50", "join p99", "inputs/s", "updates/s", "rtt ms", "tick ms");
+    //--------------------------------------------------------------------------------------
+
+    const double startMs = nowMs();
+    const double endMs = startMs + options.durationS * 1000.0;
+    double reportMs = startMs;
+    double nextReportMs = startMs + options.reportS * 1000.0;
+
+    Totals last{};
+    Server::TickTimeStats lastTick{};
+
+    while (!gQuit) {
+        const double now = nowMs();
+        if (now >= endMs) break;
+
+        swarm.step(now);
+
+        if (now >= nextReportMs) {
+            const double intervalS = (now - reportMs) / 1000.0;
+            reportMs = now;
+            nextReportMs += options.reportS * 1000.0;
+
+            swarm.countAllUpdates();
+
+            const std::vector<double> latencies(swarm.joinLatencies.begin() + static_cast<std::ptrdiff_t>(swarm.reportedLatencies),
+                                                swarm.joinLatencies.end());
+            swarm.reportedLatencies = swarm.joinLatencies.size();
+
+            char tick[16] = "-";
+            if (ServerManager::has()) {
+                const Server::TickTimeStats time = ServerManager::get().getTickTimeStats();
+                if (time.ticks > lastTick.ticks) {
+                    std::snprintf(tick, sizeof(tick), "%.3f", (time.totalNs - lastTick.totalNs) / 1e6 /
+                                  static_cast<double>(time.ticks - lastTick.ticks));
+                }
+                lastTick = time;
+            }
+
+            std::printf("%6.1fs %6zu %6zu %7llu %6llu %9.2f %9.2f %10.0f %10.0f %8.1f %10s\n",
+                (now - startMs) / 1000.0, swarm.alive(), swarm.joined(),
+                static_cast<unsigned long long>(swarm.totals.joins - last.joins),
+                static_cast<unsigned long long>(swarm.totals.failures() - last.failures()),
+                percentile(latencies, 50), percentile(latencies, 99),
+                (swarm.totals.inputs - last.inputs) / intervalS, (swarm.totals.updates - last.updates) / intervalS,
+                swarm.averageRttMs(), tick);
+            std::fflush(stdout);
+
+            last = swarm.totals;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+    }
+
+    const double runS = (nowMs() - startMs) / 1000.0;
+    swarm.dropAll();
+    const Totals& totals = swarm.totals;
+    //--------------------------------------------------------------------------------------
+
+    // Summary
+    //--------------------------------------------------------------------------------------
+    const std::vector<double>& latencies = swarm.joinLatencies;
+    const double joinP99 = percentile(latencies, 99);
+    const double updatesPerS = totals.updates / runS;
+
+    std::printf("\nSummary over %.1f s\n", runS);
+    std::printf("  connects %llu, joins %llu, left %llu\n", static_cast<unsigned long long>(totals.connects),
+        static_cast<unsigned long long>(totals.joins), static_cast<unsigned long long>(totals.left));
+    std::printf("  failures %llu: refused %llu, timed out %llu, kicked %llu\n",
+        static_cast<unsigned long long>(totals.failures()), static_cast<unsigned long long>(totals.refused),
+        static_cast<unsigned long long>(totals.timeouts), static_cast<unsigned long long>(totals.kicked));
+    std::printf("  join latency ms: p50 %.2f, p90 %.2f, p99 %.2f, p99.9 %.2f, max %.2f\n", percentile(latencies, 50),
+        percentile(latencies, 90), joinP99, percentile(latencies, 99.9), percentile(latencies, 100));
+    std::printf("  throughput: %.0f inputs/s sent, %.0f state updates/s received\n", totals.inputs / runS, updatesPerS);
+
+    double tickAvgMs = 0;
+    if (ServerManager::has()) {
+        const Server::TickTimeStats time = ServerManager::get().getTickTimeStats();
+        tickAvgMs = time.ticks > 0 ? time.totalNs / 1e6 / static_cast<double>(time.ticks) : 0;
+        std::printf("  server: %llu ticks at %.0f Hz, tick avg %.3f ms, max %.3f ms, %llu dropped\n",
+            static_cast<unsigned long long>(time.ticks), ServerManager::get().getTickRate(), tickAvgMs, time.maxNs / 1e6,
+            static_cast<unsigned long long>(ServerManager::get().getDroppedTicks()));
+    }
+
+    int result = EXIT_PASSED;
+    auto check = [&result](bool passed, const char* what, double value, double limit) {
+        std::printf("  %s %s: %.2f, limit %.2f\n", passed ? "pass" : "FAIL", what, value, limit);
+        if (!passed) result = EXIT_REGRESSED;
+    };
+
+    if (options.maxJoinP99Ms >= 0) check(!latencies.empty() && joinP99 <= options.maxJoinP99Ms, "join p99 ms", joinP99, options.maxJoinP99Ms);
+    if (options.maxJoinFailures >= 0) {
+        check(totals.failures() <= static_cast<uint64_t>(options.maxJoinFailures), "join failures",
+              static_cast<double>(totals.failures()), static_cast<double>(options.maxJoinFailures));
+    }
+    if (options.minUpdatesPerS >= 0) check(updatesPerS >= options.minUpdatesPerS, "state updates/s", updatesPerS, options.minUpdatesPerS);
+    if (options.maxTickAvgMs >= 0) check(tickAvgMs <= options.maxTickAvgMs, "tick avg ms", tickAvgMs, options.maxTickAvgMs);
+    //--------------------------------------------------------------------------------------
+
+    // De-Initialization
+    //--------------------------------------------------------------------------------------
+    if (ServerManager::has()) {
+        ServerManager::stop();
+    }
+    ConsoleManager::destroy();
+    Net::shutdown();
+    //--------------------------------------------------------------------------------------
+
+    return result;
+}
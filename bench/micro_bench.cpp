@@ -0,0 +1,507 @@
+// Micro benchmarks of the packet layer: PacketCodec primitives, serialize / deserialize of every packet, the
+// PacketDispatch decode table and framed PacketIO sends and receives over a socketpair.
+// Every case reports ns/op, heap allocations and allocated bytes per op and the wire bytes one op handles.
+// --json writes the results, --baseline compares against such a file and exits with 1 if a case got slower
+// than the tolerance, allocates more or puts more bytes on the wire.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "network/packet_dispatch.h"
+#include "network/stream_buffer.h"
+
+// Shortest measured batch, the batch size grows until one takes this long
+static constexpr double DEFAULT_MIN_TIME_MS = 100.0;
+// Batches per case, the median is reported
+static constexpr int DEFAULT_REPEAT = 5;
+// A case this much slower than its baseline is a regression, in percent
+static constexpr double DEFAULT_TOLERANCE = 10.0;
+
+static constexpr int EXIT_PASSED = 0;
+static constexpr int EXIT_REGRESSED = 1;
+static constexpr int EXIT_SETUP = 2;
+
+static uint64_t gAllocations = 0;
+static uint64_t gAllocatedBytes = 0;
+
+void* operator new(size_t size) {
+    gAllocations++;
+    gAllocatedBytes += size;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// keeps the compiler from dropping work whose result nobody reads
+template <typename T>
+static void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// -------------------- harness --------------------
+
+struct Case {
+    std::string name;
+    size_t wireBytes;                               // encoded bytes one op writes or reads, 0 if none
+    std::function<void(uint64_t)> body;             // runs the op n times
+};
+
+struct Measurement {
+    std::string name;
+    uint64_t iterations = 0;
+    double nsPerOp = 0;
+    double allocsPerOp = 0;
+    double allocBytesPerOp = 0;
+    double wireBytesPerOp = 0;
+};
+
+struct Options {
+    const char* filter = nullptr;
+    double minTimeMs = DEFAULT_MIN_TIME_MS;
+    int repeat = DEFAULT_REPEAT;
+    const char* jsonPath = nullptr;
+    const char* baselinePath = nullptr;
+    double tolerance = DEFAULT_TOLERANCE;
+    bool list = false;
+};
+
+static double timeBatch(const Case& c, uint64_t n) {
+    const auto start = std::chrono::steady_clock::now();
+    c.body(n);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Measurement measure(const Case& c, const Options& options) {
+    // warm up, buffers reach their steady state size here
+    c.body(1000);
+
+    // grow the batch until it takes minTimeMs
+    uint64_t n = 1000;
+    double elapsedNs = timeBatch(c, n);
+    while (elapsedNs < options.minTimeMs * 1e6) {
+        const double perOp = std::max(elapsedNs / static_cast<double>(n), 0.1);
+        const uint64_t wanted = static_cast<uint64_t>(options.minTimeMs * 1e6 / perOp * 1.2);
+        n = std::clamp<uint64_t>(wanted, n + 1, n * 100);
+        elapsedNs = timeBatch(c, n);
+    }
+
+    std::vector<double> perOp;
+    uint64_t allocations = UINT64_MAX;
+    uint64_t allocatedBytes = UINT64_MAX;
+    for (int r = 0; r < options.repeat; r++) {
+        const uint64_t allocationsBefore = gAllocations;
+        const uint64_t bytesBefore = gAllocatedBytes;
+
+        perOp.push_back(timeBatch(c, n) / static_cast<double>(n));
+
+        allocations = std::min(allocations, gAllocations - allocationsBefore);
+        allocatedBytes = std::min(allocatedBytes, gAllocatedBytes - bytesBefore);
+    }
+    std::sort(perOp.begin(), perOp.end());
+
+    Measurement m;
+    m.name = c.name;
+    m.iterations = n;
+    m.nsPerOp = perOp[perOp.size() / 2];
+    m.allocsPerOp = static_cast<double>(allocations) / static_cast<double>(n);
+    m.allocBytesPerOp = static_cast<double>(allocatedBytes) / static_cast<double>(n);
+    m.wireBytesPerOp = static_cast<double>(c.wireBytes);
+    return m;
+}
+
+// -------------------- cases --------------------
+
+static void addCodecCases(std::vector<Case>& cases) {
+    cases.push_back({"codec/write_u8", 1, [out = std::vector<uint8_t>()](uint64_t n) mutable {
+        for (uint64_t i = 0; i < n; i++) {
+            out.clear();
+            PacketCodec::write_u8(out, static_cast<uint8_t>(i));
+            keep(out.data());
+        }
+    }});
+
+    cases.push_back({"codec/write_i32_be", 4, [out = std::vector<uint8_t>()](uint64_t n) mutable {
+        for (uint64_t i = 0; i < n; i++) {
+            out.clear();
+            PacketCodec::write_i32_be(out, static_cast<int32_t>(i));
+            keep(out.data());
+        }
+    }});
+
+    static const uint8_t DATA[32] = {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0};
+
+    cases.push_back({"codec/read_u8", 1, [](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            size_t off = i & 7;
+            uint8_t value{};
+            keep(PacketCodec::read_u8(DATA, sizeof(DATA), off, value));
+            keep(value);
+        }
+    }});
+
+    cases.push_back({"codec/read_i32_be", 4, [](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            size_t off = i & 7;
+            int32_t value{};
+            keep(PacketCodec::read_i32_be(DATA, sizeof(DATA), off, value));
+            keep(value);
+        }
+    }});
+
+    cases.push_back({"codec/read_bytes", 25, [](uint64_t n) {
+        char name[25];
+        for (uint64_t i = 0; i < n; i++) {
+            size_t off = i & 7;
+            keep(PacketCodec::read_bytes(DATA, sizeof(DATA), off, name, sizeof(name)));
+            keep(name);
+        }
+    }});
+}
+
+// serialize, deserialize and the dispatch table decode of one packet
+template <typename T>
+static void addPacketCases(std::vector<Case>& cases, const char* name, const T& sample) {
+    std::vector<uint8_t> payload;
+    sample.serialize(payload);
+    const size_t size = payload.size();
+
+    cases.push_back({std::string("packet/") + name + "/serialize", size,
+                     [sample, out = std::vector<uint8_t>()](uint64_t n) mutable {
+        for (uint64_t i = 0; i < n; i++) {
+            out.clear();
+            sample.serialize(out);
+            keep(out.data());
+        }
+    }});
+
+    cases.push_back({std::string("packet/") + name + "/deserialize", size, [payload](uint64_t n) {
+        T packet{};
+        for (uint64_t i = 0; i < n; i++) {
+            keep(packet.deserialize(payload.data(), payload.size()));
+            keep(packet);
+        }
+    }});
+
+    // what PacketRegistry::create plus deserialize used to be, the type byte picks the decoder
+    cases.push_back({std::string("dispatch/decode/") + name, size, [payload](uint64_t n) {
+        AnyPacket packet;
+        for (uint64_t i = 0; i < n; i++) {
+            keep(PacketDispatch::decode(T::TYPE, payload.data(), payload.size(), packet));
+            keep(packet);
+        }
+    }});
+}
+
+static void addPacketCases(std::vector<Case>& cases) {
+    ConnectPacket connect{};
+    std::strcpy(connect.name, "micro bench");
+    connect.id = -1;
+    addPacketCases(cases, "ConnectPacket", connect);
+
+    PlayerJoinPacket join{};
+    std::strcpy(join.name, "micro bench");
+    join.announce = 1;
+    join.id = 42;
+    addPacketCases(cases, "PlayerJoinPacket", join);
+
+    PlayerDisconnectPacket disconnect{};
+    disconnect.reason = DisconnectReason::DIS_LEFT;
+    disconnect.id = 42;
+    addPacketCases(cases, "PlayerDisconnectPacket", disconnect);
+
+    PlayerUpdatePacket update{};
+    update.id = 42;
+    update.posX = 1200;
+    update.posY = -800;
+    addPacketCases(cases, "PlayerUpdatePacket", update);
+
+    PlayerInputPacket input{};
+    input.sequence = 1000;
+    input.count = PLAYER_INPUT_REDUNDANCY;
+    input.history = 0x1249;
+    addPacketCases(cases, "PlayerInputPacket", input);
+}
+
+// framing in memory and a whole send + receive through the kernel
+template <typename T>
+static void addIoCases(std::vector<Case>& cases, const char* name, const T& sample) {
+    std::vector<uint8_t> frame;
+    PacketIO::writePacket(frame, sample);
+    const size_t size = frame.size();
+
+    cases.push_back({std::string("io/writePacket/") + name, size,
+                     [sample, out = std::vector<uint8_t>()](uint64_t n) mutable {
+        for (uint64_t i = 0; i < n; i++) {
+            out.clear();
+            keep(PacketIO::writePacket(out, sample));
+        }
+    }});
+
+    // the buffer outlives the batch, its first allocation belongs to the warm up
+    cases.push_back({std::string("io/nextPacket/") + name, size, [frame, in = std::make_shared<StreamBuffer>()](uint64_t n) {
+        AnyPacket packet;
+        for (uint64_t i = 0; i < n; i++) {
+            if (in->writable() < frame.size()) in->compact();
+            std::memcpy(in->writePtr(), frame.data(), frame.size());
+            in->commit(frame.size());
+            keep(PacketIO::nextPacket(*in, packet));
+            keep(packet);
+        }
+    }});
+
+    // one socketpair for the whole run, the ends are closed at exit
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        std::fprintf(stderr, "socketpair failed, skipping io/socketpair/%s\n", name);
+        return;
+    }
+    const Socket writer{static_cast<uintptr_t>(fds[0])};
+    const Socket reader{static_cast<uintptr_t>(fds[1])};
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+
+    cases.push_back({std::string("io/socketpair/") + name, size,
+                     [sample, writer, reader, in = std::make_shared<StreamBuffer>()](uint64_t n) {
+        AnyPacket packet;
+        for (uint64_t i = 0; i < n; i++) {
+            PacketIO::sendPacket(writer, sample);
+
+            packet.reset();
+            while (packet.empty()) {
+                if (PacketIO::receivePacket(reader, *in, packet) == Net::Result::NET_ERROR) return;
+            }
+            keep(packet);
+        }
+    }});
+}
+
+static void addIoCases(std::vector<Case>& cases) {
+    ConnectPacket connect{};
+    std::strcpy(connect.name, "micro bench");
+    connect.id = -1;
+    addIoCases(cases, "ConnectPacket", connect);
+
+    PlayerUpdatePacket update{};
+    update.id = 42;
+    update.posX = 1200;
+    update.posY = -800;
+    addIoCases(cases, "PlayerUpdatePacket", update);
+}
+
+// -------------------- results --------------------
+
+static bool writeJson(const char* path, const std::vector<Measurement>& results) {
+    std::FILE* file = std::fopen(path, "w");
+    if (!file) return false;
+
+    std::fprintf(file, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Measurement& m = results[i];
+        std::fprintf(file,
+            "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.4f, \"allocs_per_op\": %.4f, "
+            "\"alloc_bytes_per_op\": %.4f, \"wire_bytes_per_op\": %.0f}%s\n",
+            m.name.c_str(), static_cast<unsigned long long>(m.iterations), m.nsPerOp, m.allocsPerOp,
+            m.allocBytesPerOp, m.wireBytesPerOp, i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+
+    return std::fclose(file) == 0;
+}
+
+// reads what writeJson wrote: flat objects of string and number fields inside "benchmarks"
+static bool readJson(const char* path, std::vector<Measurement>& out) {
+    std::ifstream file(path);
+    if (!file) return false;
+    const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    size_t pos = text.find("\"benchmarks\"");
+    if (pos == std::string::npos) return false;
+
+    while ((pos = text.find('{', pos)) != std::string::npos) {
+        const size_t end = text.find('}', pos);
+        if (end == std::string::npos) return false;
+
+        Measurement m;
+        size_t p = pos + 1;
+        while (true) {
+            const size_t keyStart = text.find('"', p);
+            if (keyStart == std::string::npos || keyStart > end) break;
+            const size_t keyEnd = text.find('"', keyStart + 1);
+            const size_t colon = text.find(':', keyEnd);
+            if (keyEnd == std::string::npos || colon == std::string::npos || colon > end) return false;
+            const std::string key = text.substr(keyStart + 1, keyEnd - keyStart - 1);
+
+            size_t v = text.find_first_not_of(" \t\r\n", colon + 1);
+            if (v == std::string::npos || v > end) return false;
+
+            if (text[v] == '"') {
+                const size_t valueEnd = text.find('"', v + 1);
+                if (valueEnd == std::string::npos || valueEnd > end) return false;
+                if (key == "name") m.name = text.substr(v + 1, valueEnd - v - 1);
+                p = valueEnd + 1;
+                continue;
+            }
+
+            char* stop = nullptr;
+            const double value = std::strtod(text.c_str() + v, &stop);
+            if (stop == text.c_str() + v) return false;
+            p = static_cast<size_t>(stop - text.c_str());
+
+            if (key == "iterations") m.iterations = static_cast<uint64_t>(value);
+            else if (key == "ns_per_op") m.nsPerOp = value;
+            else if (key == "allocs_per_op") m.allocsPerOp = value;
+            else if (key == "alloc_bytes_per_op") m.allocBytesPerOp = value;
+            else if (key == "wire_bytes_per_op") m.wireBytesPerOp = value;
+        }
+
+        if (!m.name.empty()) out.push_back(std::move(m));
+        pos = end + 1;
+    }
+    return true;
+}
+
+// prints every case next to its baseline, returns the number of regressions
+static int compare(const std::vector<Measurement>& results, const std::vector<Measurement>& baseline, double tolerance) {
+    std::printf("\n%-44s %10s %10s %8s  %s\n", "compared to baseline", "ns/op", "base", "change", "");
+
+    int regressions = 0;
+    for (const Measurement& m : results) {
+        auto it = std::find_if(baseline.begin(), baseline.end(), [&](const Measurement& b) { return b.name == m.name; });
+        if (it == baseline.end()) {
+            std::printf("%-44s %10.2f %10s %8s  new\n", m.name.c_str(), m.nsPerOp, "-", "-");
+            continue;
+        }
+
+        const double change = it->nsPerOp > 0 ? (m.nsPerOp / it->nsPerOp - 1.0) * 100.0 : 0;
+
+        const bool slower = change > tolerance;
+        // allocation counts are exact, any growth is real
+        const bool moreAllocs = m.allocsPerOp > it->allocsPerOp + 1e-3;
+        const bool moreWire = m.wireBytesPerOp > it->wireBytesPerOp;
+        if (slower || moreAllocs || moreWire) regressions++;
+
+        std::string verdict;
+        if (slower) verdict += "SLOWER ";
+        else if (change < -tolerance) verdict += "faster ";
+        if (moreAllocs) verdict += "MORE ALLOCS ";
+        if (moreWire) verdict += "MORE WIRE BYTES ";
+        else if (m.wireBytesPerOp < it->wireBytesPerOp) verdict += "fewer wire bytes ";
+
+        std::printf("%-44s %10.2f %10.2f %+7.1f%%  %s\n", m.name.c_str(), m.nsPerOp, it->nsPerOp, change, verdict.c_str());
+    }
+    return regressions;
+}
+
+static void printUsage(const char* program) {
+    std::fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --filter <text>          only cases whose name contains text\n"
+        "  --min-time <ms>          shortest measured batch (default %.0f)\n"
+        "  --repeat <n>             batches per case, the median is reported (default %d)\n"
+        "  --json <file>            write the results as JSON\n"
+        "  --baseline <file>        compare with results written by --json, exits with %d on a regression\n"
+        "  --tolerance <percent>    ns/op change still counted as noise (default %.0f)\n"
+        "  --list                   print the case names and exit\n",
+        program, DEFAULT_MIN_TIME_MS, DEFAULT_REPEAT, EXIT_REGRESSED, DEFAULT_TOLERANCE);
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* name = argv[i];
+
+        if (std::strcmp(name, "--list") == 0) {
+            options.list = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) return false;
+        const char* value = argv[++i];
+
+        if (std::strcmp(name, "--filter") == 0) options.filter = value;
+        else if (std::strcmp(name, "--min-time") == 0) options.minTimeMs = std::atof(value);
+        else if (std::strcmp(name, "--repeat") == 0) options.repeat = std::atoi(value);
+        else if (std::strcmp(name, "--json") == 0) options.jsonPath = value;
+        else if (std::strcmp(name, "--baseline") == 0) options.baselinePath = value;
+        else if (std::strcmp(name, "--tolerance") == 0) options.tolerance = std::atof(value);
+        else return false;
+    }
+
+    return options.minTimeMs > 0 && options.repeat > 0 && options.tolerance >= 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return EXIT_SETUP;
+    }
+
+    // read first, a typo should not cost a whole run
+    std::vector<Measurement> baseline;
+    if (options.baselinePath && !readJson(options.baselinePath, baseline)) {
+        std::fprintf(stderr, "Could not read baseline %s\n", options.baselinePath);
+        return EXIT_SETUP;
+    }
+
+    std::vector<Case> cases;
+    addCodecCases(cases);
+    addPacketCases(cases);
+    addIoCases(cases);
+
+    if (options.filter) {
+        std::erase_if(cases, [&](const Case& c) { return c.name.find(options.filter) == std::string::npos; });
+    }
+
+    if (options.list) {
+        for (const Case& c : cases) std::printf("%s\n", c.name.c_str());
+        return EXIT_PASSED;
+    }
+
+    std::printf("%-44s %14s %10s %10s %12s %10s\n", "case", "iterations", "ns/op", "allocs/op", "alloc B/op", "wire B/op");
+
+    std::vector<Measurement> results;
+    for (const Case& c : cases) {
+        const Measurement m = measure(c, options);
+        std::printf("%-44s %14llu %10.2f %10.3f %12.1f %10.0f\n", m.name.c_str(),
+            static_cast<unsigned long long>(m.iterations), m.nsPerOp, m.allocsPerOp, m.allocBytesPerOp, m.wireBytesPerOp);
+        std::fflush(stdout);
+        results.push_back(m);
+    }
+
+    if (options.jsonPath && !writeJson(options.jsonPath, results)) {
+        std::fprintf(stderr, "Could not write %s\n", options.jsonPath);
+        return EXIT_SETUP;
+    }
+
+    if (options.baselinePath) {
+        const int regressions = compare(results, baseline, options.tolerance);
+        if (regressions > 0) {
+            std::printf("FAIL: %d regressed\n", regressions);
+            return EXIT_REGRESSED;
+        }
+        std::printf("No regressions\n");
+    }
+
+    return EXIT_PASSED;
+}
@@ -0,0 +1,212 @@
+// Compares the schema generated packet codecs with the hand-written ones they replaced.
+// Each case encodes into a reused vector and decodes the result again, so the numbers are pure codec cost.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "network/packets.h"
+#include "network/packet_schema.h"
+
+static constexpr int ITERATIONS = 2000000;
+static constexpr int BENCH_ID_MAX = 1023;
+static constexpr int BENCH_POS_LIMIT = 65535;
+
+// same fields as the real packets, without the client/server handlers
+struct ConnectFields {
+    char name[25]{};
+    int32_t id{};
+
+    using Layout = PacketSchema::Layout<
+        PacketSchema::Bytes<&ConnectFields::name>,
+        PacketSchema::I32<&ConnectFields::id>>;
+
+    void writeByHand(std::vector<uint8_t>& out) const {
+        out.insert(out.end(), reinterpret_cast<const uint8_t*>(name), reinterpret_cast<const uint8_t*>(name) + 25);
+        PacketCodec::write_i32_be(out, id);
+    }
+
+    bool readByHand(const uint8_t* payload, size_t size) {
+        size_t off = 0;
+        if (size != 25 + 4) return false;
+        if (!PacketCodec::read_bytes(payload, size, off, name, 25)) return false;
+        return PacketCodec::read_i32_be(payload, size, off, id);
+    }
+};
+
+struct DisconnectFields {
+    uint8_t announce{};
+    DisconnectReason reason{};
+    int32_t id{};
+
+    using Layout = PacketSchema::Layout<
+        PacketSchema::U8<&DisconnectFields::announce>,
+        PacketSchema::U8<&DisconnectFields::reason>,
+        PacketSchema::I32<&DisconnectFields::id>>;
+
+    void writeByHand(std::vector<uint8_t>& out) const {
+        PacketCodec::write_u8(out, announce);
+        PacketCodec::write_u8(out, static_cast<uint8_t>(reason));
+        PacketCodec::write_i32_be(out, id);
+    }
+
+    bool readByHand(const uint8_t* payload, size_t size) {
+        size_t off = 0;
+        if (size != 1 + 1 + 4) return false;
+
+        uint8_t r{};
+        if (!PacketCodec::read_u8(payload, size, off, announce)) return false;
+        if (!PacketCodec::read_u8(payload, size, off, r)) return false;
+        reason = static_cast<DisconnectReason>(r);
+        return PacketCodec::read_i32_be(payload, size, off, id);
+    }
+};
+
+struct JoinFields {
+    char name[25]{};
+    uint8_t announce{};
+    DisconnectReason reason{};
+    int32_t id{};
+
+    using Layout = PacketSchema::Layout<
+        PacketSchema::String<&JoinFields::name>,
+        PacketSchema::Bool<&JoinFields::announce>,
+        PacketSchema::Ranged<&JoinFields::reason, 0, static_cast<int64_t>(DisconnectReason::DIS_CLOSE)>,
+        PacketSchema::Ranged<&JoinFields::id, 0, BENCH_ID_MAX>>;
+
+    void writeByHand(std::vector<uint8_t>& out) const {
+        BitWriter writer(out);
+        writer.writeString(name, sizeof(name) - 1);
+        writer.writeBool(announce != 0);
+        writer.writeRanged(static_cast<int32_t>(reason), 0, static_cast<int32_t>(DisconnectReason::DIS_CLOSE));
+        writer.writeRanged(id, 0, BENCH_ID_MAX);
+        writer.flush();
+    }
+
+    bool readByHand(const uint8_t* payload, size_t size) {
+        BitReader reader(payload, size);
+        if (!reader.readString(name, sizeof(name) - 1)) return false;
+
+        bool a{};
+        if (!reader.readBool(a)) return false;
+        announce = a ? 1 : 0;
+
+        int32_t r{};
+        if (!reader.readRanged(0, static_cast<int32_t>(DisconnectReason::DIS_CLOSE), r)) return false;
+        reason = static_cast<DisconnectReason>(r);
+
+        if (!reader.readRanged(0, BENCH_ID_MAX, id)) return false;
+        return reader.finished();
+    }
+};
+
+struct UpdateFields {
+    int32_t id{};
+    int32_t posX{};
+    int32_t posY{};
+
+    using Layout = PacketSchema::Layout<
+        PacketSchema::Ranged<&UpdateFields::id, 0, BENCH_ID_MAX>,
+        PacketSchema::Ranged<&UpdateFields::posX, -BENCH_POS_LIMIT, BENCH_POS_LIMIT>,
+        PacketSchema::Ranged<&UpdateFields::posY, -BENCH_POS_LIMIT, BENCH_POS_LIMIT>>;
+
+    void writeByHand(std::vector<uint8_t>& out) const {
+        BitWriter writer(out);
+        writer.writeRanged(id, 0, BENCH_ID_MAX);
+        writer.writeRanged(posX, -BENCH_POS_LIMIT, BENCH_POS_LIMIT);
+        writer.writeRanged(posY, -BENCH_POS_LIMIT, BENCH_POS_LIMIT);
+        writer.flush();
+    }
+
+    bool readByHand(const uint8_t* payload, size_t size) {
+        BitReader reader(payload, size);
+        if (!reader.readRanged(0, BENCH_ID_MAX, id)) return false;
+        if (!reader.readRanged(-BENCH_POS_LIMIT, BENCH_POS_LIMIT, posX)) return false;
+        if (!reader.readRanged(-BENCH_POS_LIMIT, BENCH_POS_LIMIT, posY)) return false;
+        return reader.finished();
+    }
+};
+
+struct Timing {
+    double encodeNs;
+    double decodeNs;
+    size_t bytes;
+    bool ok;
+};
+
+// keeps the optimizer from dropping the decoded values
+static volatile uint32_t gSink;
+
+template <typename T, bool Schema>
+static Timing measure(T sample) {
+    std::vector<uint8_t> buffer;
+    buffer.reserve(64);
+    uint32_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        buffer.clear();
+        sample.id = i & BENCH_ID_MAX;
+        if constexpr (Schema) T::Layout::write(sample, buffer);
+        else sample.writeByHand(buffer);
+        checksum += buffer[buffer.size() - 1];
+    }
+    auto encoded = std::chrono::steady_clock::now();
+
+    T decoded{};
+    bool ok = true;
+    for (int i = 0; i < ITERATIONS; i++) {
+        if constexpr (Schema) ok &= T::Layout::read(decoded, buffer.data(), buffer.size());
+        else ok &= decoded.readByHand(buffer.data(), buffer.size());
+        checksum += static_cast<uint32_t>(decoded.id);
+    }
+    auto end = std::chrono::steady_clock::now();
+    gSink = checksum;
+
+    return Timing{
+        std::chrono::duration<double, std::nano>(encoded - start).count() / ITERATIONS,
+        std::chrono::duration<double, std::nano>(end - encoded).count() / ITERATIONS,
+        buffer.size(),
+        ok && decoded.id == sample.id
+    };
+}
+
+template <typename T>
+static void report(const char* name, const T& sample) {
+    const Timing hand = measure<T, false>(sample);
+    const Timing schema = measure<T, true>(sample);
+
+    std::printf("%-12s %6zu %6zu %10.2f %10.2f %10.2f %10.2f %s\n", name, hand.bytes, schema.bytes,
+                hand.encodeNs, schema.encodeNs, hand.decodeNs, schema.decodeNs,
+                hand.ok && schema.ok ? "" : "ROUND TRIP FAILED");
+}
+
+int main() {
+    std::printf("%d iterations per codec, times in ns per packet\n", ITERATIONS);
+    std::printf("%-12s %6s %6s %10s %10s %10s %10s\n", "packet", "hand", "schema", "enc hand", "enc schema",
+                "dec hand", "dec schema");
+
+    ConnectFields connect{};
+    std::strcpy(connect.name, "benchmark player");
+    report("connect", connect);
+
+    DisconnectFields disconnect{};
+    disconnect.announce = 1;
+    disconnect.reason = DisconnectReason::DIS_KICK;
+    report("disconnect", disconnect);
+
+    JoinFields join{};
+    std::strcpy(join.name, "benchmark player");
+    join.announce = 1;
+    join.reason = DisconnectReason::DIS_LEFT;
+    report("player_join", join);
+
+    UpdateFields update{};
+    update.posX = 1234;
+    update.posY = -4321;
+    report("player_update", update);
+
+    return 0;
+}
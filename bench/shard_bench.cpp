@@ -0,0 +1,123 @@
+// Measures how packet decode throughput scales with the number of server io workers.
+// Every simulated client is one end of a local socketpair, a feeder thread writes frames into the other end
+// while the main thread plays the simulation and drains the shard event queues.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "network/packets.h"
+#include "network/packets/connect_packet.h"
+#include "network/server_shard.h"
+
+static constexpr int CLIENTS = 256;
+static constexpr int ROUNDS = 200;
+static constexpr int FRAMES_PER_ROUND = 8;
+
+struct Peer {
+    Socket server;
+    Socket remote;
+};
+
+static bool openPeers(int count, std::vector<Peer>& out) {
+    for (int i = 0; i < count; i++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return false;
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+        out.push_back(Peer{Socket{static_cast<uintptr_t>(fds[0])}, Socket{static_cast<uintptr_t>(fds[1])}});
+    }
+    return true;
+}
+
+// returns packets per second seen by the simulation thread
+static double run(int workers) {
+    std::vector<Peer> peers;
+    if (!openPeers(CLIENTS, peers)) return -1.0;
+
+    std::vector<std::unique_ptr<ServerShard>> shards;
+    for (int i = 0; i < workers; i++) {
+        shards.push_back(std::make_unique<ServerShard>(i));
+        shards.back()->start();
+    }
+    for (int i = 0; i < CLIENTS; i++) {
+        shards[i % workers]->addClient(i, 1, peers[i].server);
+    }
+
+    std::vector<uint8_t> round;
+    // about the size of a state update, decoded field by field like every real packet
+    ConnectPacket packet{};
+    std::strcpy(packet.name, "shard bench");
+    for (int f = 0; f < FRAMES_PER_ROUND; f++) {
+        packet.id = f;
+        PacketIO::writePacket(round, packet);
+    }
+
+    const uint64_t expected = static_cast<uint64_t>(CLIENTS) * ROUNDS * FRAMES_PER_ROUND;
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread feeder([&] {
+        for (int r = 0; r < ROUNDS; r++) {
+            for (const Peer& p : peers) {
+                Socket::send(p.remote, round.data(), static_cast<int>(round.size()));
+            }
+        }
+    });
+
+    uint64_t received = 0;
+    ServerShard::Event event;
+    while (received < expected) {
+        bool any = false;
+        for (auto& shard : shards) {
+            while (shard->poll(event)) {
+                if (event.kind == ServerShard::Event::Kind::PACKET) received++;
+                any = true;
+            }
+        }
+        if (!any) std::this_thread::yield();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    feeder.join();
+
+    // the shards close the server ends
+    for (int i = 0; i < CLIENTS; i++) shards[i % workers]->removeClient(i);
+    shards.clear();
+    for (const Peer& p : peers) Socket::close(p.remote);
+
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    return static_cast<double>(expected) / seconds;
+}
+
+int main() {
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    std::printf("%u hardware threads, %d clients, %d packets per run\n",
+                std::thread::hardware_concurrency(), CLIENTS, CLIENTS * ROUNDS * FRAMES_PER_ROUND);
+    std::printf("%8s %16s %10s\n", "workers", "packets/s", "speedup");
+
+    double baseline = 0.0;
+    for (int workers : {1, 2, 4, 8, 16}) {
+        const double rate = run(workers);
+        if (rate < 0.0) {
+            std::printf("%8d failed to open socket pairs\n", workers);
+            continue;
+        }
+        if (baseline == 0.0) baseline = rate;
+
+        std::printf("%8d %16.0f %9.2fx\n", workers, rate, rate / baseline);
+    }
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+// Compares per-call socket receives and sends against the batched io_uring transport.
+// Every simulated client is one end of a local socketpair. Each tick the other end writes one input frame,
+// the server side reads it and answers with FRAMES_PER_TICK frames, which are drained after the tick.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "util/net.h"
+#include "util/uring_transport.h"
+
+struct Peer {
+    Socket server;
+    Socket remote;
+};
+
+static constexpr int TICKS = 200;
+static constexpr int FRAMES_PER_TICK = 4;
+static constexpr int PAYLOAD_SIZE = 31; // PlayerJoinPacket
+static constexpr int INPUT_SIZE = 10;   // PlayerInputPacket frame
+
+static bool openPeers(int count, std::vector<Peer>& out) {
+    for (int i = 0; i < count; i++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return false;
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        out.push_back(Peer{Socket{static_cast<uintptr_t>(fds[0])}, Socket{static_cast<uintptr_t>(fds[1])}});
+    }
+    return true;
+}
+
+static void closePeers(std::vector<Peer>& peers) {
+    for (const Peer& p : peers) {
+        Socket::close(p.server);
+        Socket::close(p.remote);
+    }
+    peers.clear();
+}
+
+static void drainPeers(const std::vector<Peer>& peers) {
+    uint8_t buffer[4096];
+    for (const Peer& p : peers) {
+        while (recv(static_cast<int>(p.remote.handle), buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {}
+    }
+}
+
+static void writeInputs(const std::vector<Peer>& peers) {
+    uint8_t input[INPUT_SIZE] = {5, 0, INPUT_SIZE - 3};
+    for (const Peer& p : peers) {
+        send(static_cast<int>(p.remote.handle), input, sizeof(input), 0);
+    }
+}
+
+static void writeFrame(uint8_t* frame, uint8_t tick) {
+    frame[0] = 2;
+    frame[1] = 0;
+    frame[2] = PAYLOAD_SIZE;
+    std::memset(frame + 3, tick, PAYLOAD_SIZE);
+}
+
+// one recv per client and one send per frame, the way PacketIO::receivePacket and sendPacket do it
+static double runSyscall(const std::vector<Peer>& peers, uint64_t& received) {
+    uint8_t frame[3 + PAYLOAD_SIZE];
+    uint8_t buffer[4096];
+
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < TICKS; t++) {
+        writeInputs(peers);
+
+        writeFrame(frame, static_cast<uint8_t>(t));
+        for (const Peer& p : peers) {
+            int read = 0;
+            if (Socket::read(p.server, buffer, sizeof(buffer), &read) == Net::Result::NET_OK) received += read;
+
+            for (int f = 0; f < FRAMES_PER_TICK; f++) {
+                Socket::send(p.server, frame, 3 + PAYLOAD_SIZE);
+            }
+        }
+        drainPeers(peers);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::micro>(end - start).count() / TICKS;
+}
+
+static double runUring(const std::vector<Peer>& peers, uint64_t& received, uint64_t& submits) {
+    const int count = static_cast<int>(peers.size());
+    UringTransport transport(4096, count, FRAMES_PER_TICK * (3 + PAYLOAD_SIZE), count);
+    std::vector<UringTransport::Completion> completions;
+
+    for (int i = 0; i < count; i++) transport.startReceive(peers[i].server, static_cast<uint64_t>(i));
+    transport.submit();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < TICKS; t++) {
+        writeInputs(peers);
+
+        // whatever the kernel read since the last tick, the way Server::processRing collects it
+        completions.clear();
+        transport.reap(completions);
+        for (const UringTransport::Completion& c : completions) {
+            if (c.receive && c.result > 0) received += c.result;
+        }
+
+        // a client's frames of one tick go out as one send, the way Server::flushClient queues them
+        for (const Peer& p : peers) {
+            uint8_t* frames = transport.prepareSend(p.server, FRAMES_PER_TICK * (3 + PAYLOAD_SIZE));
+            if (!frames) continue;
+            for (int f = 0; f < FRAMES_PER_TICK; f++) {
+                writeFrame(frames + f * (3 + PAYLOAD_SIZE), static_cast<uint8_t>(t));
+            }
+        }
+        transport.submit();
+        transport.drainSends();
+        drainPeers(peers);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    submits = transport.submitCalls();
+    return std::chrono::duration<double, std::micro>(end - start).count() / TICKS;
+}
+
+int main() {
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    const bool uring = UringTransport::available();
+    if (!uring) std::printf("io_uring not available in this build, only the syscall path is measured\n");
+
+    // inputs read is the share of the written input bytes that arrived, the ring hands out the last tick's late
+    std::printf("%8s %16s %16s %14s %12s\n", "clients", "syscall us/tick", "uring us/tick", "submits/tick", "inputs read");
+
+    for (int clients : {64, 256, 1024}) {
+        std::vector<Peer> peers;
+        if (!openPeers(clients, peers)) {
+            std::printf("%8d failed to open socket pairs\n", clients);
+            closePeers(peers);
+            continue;
+        }
+
+        const double written = static_cast<double>(TICKS) * clients * INPUT_SIZE;
+
+        uint64_t syscallRead = 0;
+        double syscallUs = runSyscall(peers, syscallRead);
+
+        if (uring) {
+            uint64_t uringRead = 0;
+            uint64_t submits = 0;
+            double uringUs = runUring(peers, uringRead, submits);
+            std::printf("%8d %16.1f %16.1f %14.2f %11.1f%%\n", clients, syscallUs, uringUs,
+                        static_cast<double>(submits) / TICKS, 100.0 * static_cast<double>(uringRead) / written);
+        } else {
+            std::printf("%8d %16.1f %16s %14s %11.1f%%\n", clients, syscallUs, "-", "-",
+                        100.0 * static_cast<double>(syscallRead) / written);
+        }
+
+        closePeers(peers);
+    }
+
+    return 0;
+}
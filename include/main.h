@@ -2,9 +2,10 @@
 #define MAIN_H
 #include "screen_manager.h"
 #include "input/input.h"
+#include "player.h"
 
 void setup();
-void draw(ScreenManager* screenManager);
+void draw(ScreenManager* screenManager, Player* player);
 void shutdown();
 
 #endif //MAIN_H
\ No newline at end of file
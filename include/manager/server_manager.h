@@ -11,7 +11,8 @@
 
 class ServerManager {
 public:
-    static Server& create(const Net::Address& addr, int maxClients);
+    static Server& create(const Net::Address& addr, int maxClients, Net::Transport transport = Net::Transport::NET_SYSCALL,
+                          int workers = 0);
     static bool has();
     static Server& get();
     static void stop();
@@ -0,0 +1,167 @@
+#ifndef CHANNEL_ENDPOINT_H
+#define CHANNEL_ENDPOINT_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "network/datagram_channel.h"
+#include "util/arena.h"
+#include "util/net.h"
+#include "util/object_pool.h"
+
+class Histogram;
+class IPacket;
+struct AnyPacket;
+enum class PacketType : uint8_t;
+
+enum class ChannelType : uint8_t {
+    CH_RELIABLE_ORDERED    = 0,    // every message, in send order
+    CH_RELIABLE_UNORDERED  = 1,    // every message, as soon as it arrives
+    CH_UNRELIABLE_SEQUENCED = 2,   // may be lost, anything older than the newest is dropped
+};
+
+#define CHANNEL_COUNT 3
+// Resend timer bounds, the timer itself follows the measured rtt
+#define CHANNEL_MIN_RESEND_MS 50.0
+#define CHANNEL_MAX_RESEND_MS 1000.0
+// Send an ack-only datagram if nothing else went out for this long
+#define CHANNEL_HEARTBEAT_MS 1000.0
+#define CHANNEL_MAX_DATAGRAMS_PER_UPDATE 32
+// Messages are kept in fixed size pooled buffers, longer payloads belong to no known packet
+#define CHANNEL_MAX_MESSAGE_PAYLOAD 64
+
+/**
+ * Message channels over the udp lane for one remote peer.
+ *
+ * Every datagram carries its own sequence plus the newest remote sequence and a 32 bit field of the ones
+ * before it, so acks ride along with normal traffic and a single lost ack does not cause a resend.
+ * Reliable messages are kept until a datagram that carried them is acked and are resent when the rtt based
+ * timer runs out. Messages from all channels are packed together into datagrams up to DATAGRAM_MAX_SIZE.
+ *
+ * Datagram: | kind:u8 | sender:u16 | token:u32 | sequence:u16 | ack:u16 | ackBits:u32 | message... |
+ * Message:  | channel:u8 | messageSeq:u16 | type:u8 | payloadLen:u16 | payload... |
+ */
+class ChannelEndpoint {
+public:
+    ChannelEndpoint();
+
+    // Send
+    bool send(ChannelType channel, const IPacket& packet);
+    void update(double nowMs, DatagramChannel& out, Net::Address to, uint16_t sender, uint32_t token);
+
+    // Receive
+    bool receive(const uint8_t* data, int length, double nowMs, Arena& arena);
+    bool poll(AnyPacket& out, ChannelType& outChannel);
+
+    // Getter / Setter
+    double rttMs() const {
+        return mSmoothedRtt;
+    }
+
+    double resendTimeoutMs() const;
+
+    uint64_t resends() const {
+        return mResends;
+    }
+
+    // datagram bytes staged by update(), acks and resends included
+    uint64_t bytesSent() const {
+        return mBytesSent;
+    }
+
+    // every rtt sample is also recorded there in microseconds, the owner keeps it alive
+    void setRttHistogram(Histogram* histogram) {
+        mRttHistogram = histogram;
+    }
+
+    const PoolStats& pendingPoolStats() const {
+        return mPendingPool.stats();
+    }
+
+    const PoolStats& bufferedPoolStats() const {
+        return mBufferedPool.stats();
+    }
+
+private:
+    struct Pending {
+        uint16_t sequence{};
+        PacketType type{};
+        uint16_t length{};
+        uint8_t payload[CHANNEL_MAX_MESSAGE_PAYLOAD]{};
+        double lastSentMs = -1.0;
+        bool acked = false;
+    };
+
+    struct SentRecord {
+        uint16_t sequence{};
+        bool valid = false;
+        bool acked = false;
+        double sentMs{};
+        std::vector<std::pair<uint8_t, uint16_t>> messages;    // channel, message sequence
+    };
+
+    // reliable ordered message that arrived before the ones in front of it
+    struct Buffered {
+        uint16_t sequence{};
+        PacketType type{};
+        uint16_t length{};
+        uint8_t payload[CHANNEL_MAX_MESSAGE_PAYLOAD]{};
+    };
+
+    // payload lives in the arena passed to receive(), poll() drains these before it is reset
+    struct Delivered {
+        ChannelType channel{};
+        PacketType type{};
+        uint16_t length{};
+        const uint8_t* payload{};
+    };
+
+    static constexpr int SENT_WINDOW = 1024;
+    static constexpr int DEDUP_WINDOW = 1024;
+
+    void beginDatagram(uint8_t* buffer, uint16_t sender, uint32_t token);
+    void ackRecord(uint16_t sequence, double nowMs);
+    void markAcked(uint8_t channel, uint16_t messageSequence);
+    void deliver(uint8_t channel, uint16_t messageSequence, PacketType type, const uint8_t* payload, uint16_t length,
+                 Arena& arena);
+    void emit(uint8_t channel, PacketType type, const uint8_t* payload, size_t length, Arena& arena);
+
+    // Send side
+    uint16_t mLocalSequence = 0;
+    uint16_t mMessageSequence[CHANNEL_COUNT]{};
+    ObjectPool<Pending> mPendingPool;
+    std::vector<Pending*> mPending[CHANNEL_COUNT];     // oldest first
+    std::vector<SentRecord> mSent = std::vector<SentRecord>(SENT_WINDOW);
+    std::vector<uint8_t> mScratch;
+
+    double mLastSendMs = -1.0;
+    bool mAckOwed = false;
+
+    // Receive side
+    uint16_t mRemoteSequence = 0;
+    uint32_t mAckBits = 0;
+    bool mHasRemote = false;
+
+    uint16_t mNextOrdered = 0;
+    ObjectPool<Buffered> mBufferedPool;
+    std::vector<Buffered*> mOrderedBuffer = std::vector<Buffered*>(DEDUP_WINDOW);  // by sequence % DEDUP_WINDOW
+    std::vector<int32_t> mUnorderedSeen = std::vector<int32_t>(DEDUP_WINDOW, -1);
+    uint16_t mLastSequenced = 0;
+    bool mHasSequenced = false;
+
+    // drained by poll() every tick, so it only allocates while growing to the largest burst
+    std::vector<Delivered> mDelivered;
+    size_t mDeliveredHead = 0;
+
+    // Rtt
+    double mSmoothedRtt = 0.0;
+    double mRttVariance = 0.0;
+    bool mHasRtt = false;
+    Histogram* mRttHistogram = nullptr;
+
+    uint64_t mResends = 0;
+    uint64_t mBytesSent = 0;
+};
+
+#endif //CHANNEL_ENDPOINT_H
@@ -1,11 +1,23 @@
 #ifndef CLIENT_H
 #define CLIENT_H
+#include <cstdint>
+
+#include "network/channel_endpoint.h"
+#include "network/datagram_channel.h"
+#include "network/net_stats.h"
+#include "network/prediction.h"
+#include "network/snapshot_buffer.h"
+#include "network/stream_buffer.h"
+#include "util/histogram.h"
 #include "util/net.h"
 
+class IPacket;
+
 enum class NetState {
     IDLE = 0,
     CONNECTING = 1,
-    READY = 2
+    READY = 2,
+    CLOSED = 3      // the server ended the connection, whoever owns the client drops it
 };
 
 class Client {
@@ -19,20 +31,81 @@ public:
     void disconnect();
     void update();
 
+    Net::Result sendPacket(const IPacket& packet);
+    void sendDatagram(const IPacket& packet);
+    void sendInput(uint8_t buttons);
+    bool sendChannel(ChannelType channel, const IPacket& packet);
+
     // Getter / Setter
     Socket getServer() const {
         return mServer;
     }
 
+    const ArenaStats& getFrameArenaStats() const {
+        return mFrameArena.stats();
+    }
+
+    const ChannelEndpoint& getChannel() const {
+        return mChannel;
+    }
+
+    // Traffic of this connection, the rates are refreshed every NET_STATS_PUBLISH_MS
+    struct NetStats {
+        ConnectionStats connection;     // queueDepth stays 0, nothing is queued between updates
+        ConnectionRates rates;
+        Histogram rttUs;                // channel rtt samples since the last reset
+        Histogram updateNs;             // time spent in update() since the last reset
+    };
+
+    const NetStats& getNetStats() const {
+        return mNetStats;
+    }
+
+    // clears the histograms, the counters keep running
+    void resetNetStats();
+
     int mId{};
 
+    // udp session token from the server's ConnectPacket, 0 until then
+    uint32_t mUdpToken{};
+
     NetState mState = NetState::IDLE;
+
+    // local clock of the current update(), the one snapshots are stamped with
+    double getTimeMs() const {
+        return mNowMs;
+    }
+
+    // Every other player, from the udp lane, interpolated once per update()
+    SnapshotBuffer mRemotePlayers;
+
+    // The local player, moved by its inputs before the server confirms them
+    Prediction mPrediction;
 private:
     void processNetwork();
+    void processDatagrams();
+    void publishNetStats();
 
     Net::Address mServerAddr;
     Socket mServer;
 
+    StreamBuffer mIn;
+    std::vector<uint8_t> mOut;
+
+    DatagramChannel mDatagram;
+    uint16_t mDatagramSequence = 0;
+
+    ChannelEndpoint mChannel;
+
+    // Memory that lives for one update(), released in one go at its end
+    Arena mFrameArena;
+
+    double mNowMs = 0;
+
+    NetStats mNetStats;
+    ConnectionStats mPublishedStats;
+    double mNetStatsPublishedMs = -1.0;
+
     bool mReadable = false;
     bool mWritable = false;
 
@@ -0,0 +1,69 @@
+#ifndef DATAGRAM_CHANNEL_H
+#define DATAGRAM_CHANNEL_H
+
+#include <cstdint>
+#include <vector>
+
+#include "util/net.h"
+
+// Largest datagram we send, stays below the usual 1500 byte MTU after IP/UDP headers
+#define DATAGRAM_MAX_SIZE 1200
+// Datagrams moved per recvmmsg/sendmmsg call
+#define DATAGRAM_BATCH 64
+
+/**
+ * Unreliable UDP lane next to the TCP control connection.
+ *
+ * Datagrams are staged during a tick and leave with one sendmmsg per DATAGRAM_BATCH datagrams in flush().
+ * receive() pulls up to DATAGRAM_BATCH datagrams with a single recvmmsg. Platforms without the
+ * batched calls fall back to one sendto/recvfrom per datagram.
+ */
+class DatagramChannel {
+public:
+    struct Datagram {
+        Net::Address addr;
+        int length;
+        uint8_t data[DATAGRAM_MAX_SIZE];
+    };
+
+    DatagramChannel();
+    ~DatagramChannel();
+
+    DatagramChannel(const DatagramChannel&) = delete;
+    DatagramChannel& operator=(const DatagramChannel&) = delete;
+
+    bool open(Net::Address bindAddr);
+    void close();
+
+    // Send
+    uint8_t* prepare(Net::Address to);
+    void commit(int length);
+    int flush();
+
+    // Receive
+    int receive();
+
+    // Getter / Setter
+    bool isOpen() const {
+        return mOpen;
+    }
+
+    Socket getSocket() const {
+        return mSocket;
+    }
+
+    const Datagram& received(int index) const {
+        return mRecv[index];
+    }
+
+private:
+    Socket mSocket{};
+    bool mOpen = false;
+
+    std::vector<Datagram> mSend;
+    int mSendCount = 0;
+
+    std::vector<Datagram> mRecv;
+};
+
+#endif //DATAGRAM_CHANNEL_H
@@ -0,0 +1,133 @@
+#ifndef INTEREST_GRID_H
+#define INTEREST_GRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// World units per grid cell. Half the range keeps both the cells visited and the distance tests low
+#define INTEREST_DEFAULT_CELL 1024
+// Distance up to which a player sees another one, 0 turns interest management off
+#define INTEREST_DEFAULT_RANGE 2048
+// Extra distance a visible player has to move away before it is dropped, stops enter/leave flapping at the edge
+#define INTEREST_DEFAULT_HYSTERESIS 256
+// Hash buckets, power of two. Several cells may share one bucket, entries are filtered by their cell
+#define INTEREST_BUCKETS 4096
+
+struct InterestEvent {
+    int viewer;
+    int subject;
+    bool enter;     // false: subject left the viewer's range
+};
+
+struct InterestStats {
+    size_t entities = 0;
+    size_t visiblePairs = 0;        // counted once per direction
+    uint64_t dirty = 0;             // entities that moved during the last update
+    uint64_t pairChecks = 0;        // distance tests done by the last update
+    uint64_t enters = 0;
+    uint64_t leaves = 0;
+};
+
+/**
+ * Server side area of interest over a uniform spatial hash grid.
+ *
+ * Entities are indexed by client id and kept in intrusive lists per hash bucket. update() only looks at the
+ * entities that moved since the last call: pairs that drifted further apart than range + hysteresis are
+ * dropped, neighbours in the surrounding cells that came within range are added. Visibility is symmetric,
+ * so every change comes out as two events, one for each side. Not thread safe, it belongs to the tick thread.
+ */
+class InterestGrid {
+public:
+    InterestGrid() = default;
+
+    void resize(int maxEntities);
+    void configure(int32_t cellSize, int32_t range, int32_t hysteresis);
+
+    void setPosition(int id, int32_t x, int32_t y);
+    void remove(int id);
+
+    const std::vector<InterestEvent>& update();
+
+    // Getter / Setter
+    bool has(int id) const {
+        return id >= 0 && id < static_cast<int>(mEntities.size()) && mEntities[id].active;
+    }
+
+    bool sees(int viewer, int subject) const {
+        return (mVisibleBits[static_cast<size_t>(viewer) * mWords + (subject >> 6)] >> (subject & 63)) & 1;
+    }
+
+    // entities the viewer currently sees, does not contain the viewer itself
+    const std::vector<int>& visibleTo(int viewer) const {
+        return mEntities[viewer].visible;
+    }
+
+    int32_t getX(int id) const {
+        return mEntities[id].x;
+    }
+
+    int32_t getY(int id) const {
+        return mEntities[id].y;
+    }
+
+    int32_t getCellSize() const {
+        return mCellSize;
+    }
+
+    int32_t getRange() const {
+        return mRange;
+    }
+
+    int32_t getHysteresis() const {
+        return mHysteresis;
+    }
+
+    InterestStats stats() const;
+
+private:
+    struct Entity {
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t cellX = 0;
+        int32_t cellY = 0;
+
+        // bucket list
+        int bucket = -1;
+        int prev = -1;
+        int next = -1;
+
+        bool active = false;
+        bool dirty = false;
+
+        std::vector<int> visible;
+    };
+
+    int32_t cellOf(int32_t v) const;
+    size_t bucketOf(int32_t cellX, int32_t cellY) const;
+    void link(int id);
+    void unlink(int id);
+    void markDirty(int id);
+
+    void setVisible(int a, int b, bool visible);
+    void dropVisible(int viewer, int subject);
+
+    std::vector<Entity> mEntities;
+    std::vector<int> mBuckets;
+    std::vector<uint64_t> mVisibleBits;     // one row of bits per viewer
+    size_t mWords = 0;                      // words per row
+
+    std::vector<int> mDirty;
+    std::vector<InterestEvent> mEvents;
+
+    int32_t mCellSize = INTEREST_DEFAULT_CELL;
+    int32_t mRange = INTEREST_DEFAULT_RANGE;
+    int32_t mHysteresis = INTEREST_DEFAULT_HYSTERESIS;
+
+    uint64_t mLastDirty = 0;
+    uint64_t mLastChecks = 0;
+    uint64_t mLastEnters = 0;
+    uint64_t mLastLeaves = 0;
+};
+
+#endif //INTEREST_GRID_H
@@ -0,0 +1,85 @@
+#ifndef LAG_HISTORY_H
+#define LAG_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Longest rewind, the history keeps this much at the current tick rate
+#define LAG_HISTORY_MS 1000.0
+// Frames kept at most, bounds the memory at very high tick rates
+#define LAG_HISTORY_MAX_FRAMES 1024
+
+struct LagHistoryStats {
+    size_t frames = 0;
+    size_t maxPlayers = 0;
+    size_t recorded = 0;                // players in the newest frame
+    double spanMs = 0;                  // time covered once every frame is filled
+    size_t bytes = 0;                   // preallocated for all frames and players
+    double bytesPerPlayerSecond = 0;
+    uint64_t oldestTick = 0;
+    uint64_t newestTick = 0;
+};
+
+/**
+ * Where every player was during the last ticks, for lag compensated hit detection.
+ *
+ * One frame per tick in a ring indexed by tick number, each frame is structure of arrays: a presence bitset
+ * plus x and y arrays indexed by client id. Everything is allocated by resize(), recording a tick only writes
+ * into the frame it reuses. Queries take a fractional tick and interpolate between the two frames around it,
+ * the same way clients draw remote players between two snapshots.
+ */
+class LagHistory {
+public:
+    LagHistory() = default;
+
+    void resize(int maxPlayers, double tickRate);
+
+    void beginTick(uint64_t tick);
+    void record(int id, int32_t x, int32_t y);
+
+    bool positionAt(int id, double tick, int32_t& outX, int32_t& outY) const;
+    size_t queryRadius(double tick, int32_t x, int32_t y, int32_t radius, std::vector<int>& out, int exceptId = -1) const;
+
+    // Getter / Setter
+    bool covers(double tick) const;
+
+    double getTickRate() const {
+        return mTickRate;
+    }
+
+    uint64_t getOldestTick() const;
+
+    uint64_t getNewestTick() const {
+        return mNewest;
+    }
+
+    LagHistoryStats stats() const;
+
+private:
+    size_t rowOf(uint64_t tick) const {
+        return static_cast<size_t>(tick % mFrames);
+    }
+
+    bool present(size_t row, int id) const {
+        return (mPresent[row * mWords + (id >> 6)] >> (id & 63)) & 1;
+    }
+
+    void lerp(size_t row, double fraction, int id, int32_t& outX, int32_t& outY) const;
+
+    size_t mFrames = 0;
+    size_t mPlayers = 0;
+    size_t mWords = 0;
+    double mTickRate = 0;
+
+    std::vector<uint64_t> mTicks;       // tick held by each frame
+    std::vector<uint64_t> mPresent;     // frame * mWords
+    std::vector<int32_t> mX;            // frame * mPlayers + id
+    std::vector<int32_t> mY;
+
+    uint64_t mFirst = 0;                // first tick recorded since resize()
+    uint64_t mNewest = 0;
+    bool mEmpty = true;
+};
+
+#endif //LAG_HISTORY_H
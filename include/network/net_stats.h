@@ -0,0 +1,78 @@
+#ifndef NET_STATS_H
+#define NET_STATS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+enum class PacketType : uint8_t;
+
+// PacketType values with their own counter, unknown packets are counted as PCK_NOTHING
+#define NET_STATS_PACKET_TYPES 6
+// How often counters are turned into rates, also how old Server::getNetStats() can be
+#define NET_STATS_PUBLISH_MS 250.0
+
+// Parts of a server tick, each one has its own timing histogram
+enum class TickPhase : uint8_t {
+    PHASE_POLL = 0,         // reactor wait and accepts
+    PHASE_RECEIVE = 1,      // tcp, io worker and udp input with their packet handlers
+    PHASE_SIMULATE = 2,     // area of interest and lag history
+    PHASE_FLUSH = 3,        // output queues, message channels and datagrams
+    PHASE_TICK = 4,         // the whole tick
+};
+
+#define TICK_PHASE_COUNT 5
+
+// Per second, over the last publish interval
+struct ConnectionRates {
+    double bytesIn = 0;
+    double bytesOut = 0;
+    double packetsIn = 0;
+    double packetsOut = 0;
+};
+
+// Traffic of one connection, tcp and udp together. Packets are counted where they are handled or queued
+struct ConnectionStats {
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    uint64_t packetsIn[NET_STATS_PACKET_TYPES]{};     // by PacketType, channel messages included
+    uint64_t packetsOut[NET_STATS_PACKET_TYPES]{};
+    uint64_t wouldBlock = 0;        // sends the socket or the output queue could not take completely
+    size_t queueDepth = 0;          // bytes left in the output queue after the last flush
+    double rttMs = 0;               // smoothed rtt of the udp channel, 0 before the first ack
+
+    void countIn(PacketType type, size_t bytes) {
+        packetsIn[slotOf(type)]++;
+        bytesIn += bytes;
+    }
+
+    void countOut(PacketType type, size_t bytes) {
+        packetsOut[slotOf(type)]++;
+        bytesOut += bytes;
+    }
+
+    uint64_t totalPacketsIn() const;
+    uint64_t totalPacketsOut() const;
+
+    void add(const ConnectionStats& other);
+    ConnectionRates ratesSince(const ConnectionStats& before, double seconds) const;
+
+private:
+    static size_t slotOf(PacketType type) {
+        const size_t slot = static_cast<size_t>(type);
+        return slot < NET_STATS_PACKET_TYPES ? slot : 0;
+    }
+};
+
+// One connection as published by the server
+struct ConnectionSample {
+    int id = -1;
+    ConnectionStats stats;
+    ConnectionRates rates;
+};
+
+// short names for tables
+const char* packetTypeName(size_t type);
+const char* tickPhaseName(TickPhase phase);
+
+#endif //NET_STATS_H
@@ -0,0 +1,133 @@
+#ifndef PACKET_DISPATCH_H
+#define PACKET_DISPATCH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <variant>
+
+#include "network/packets.h"
+#include "network/packets/connect_packet.h"
+#include "network/packets/player_disconnect_packet.h"
+#include "network/packets/player_input_packet.h"
+#include "network/packets/player_join_packet.h"
+#include "network/packets/player_update_packet.h"
+
+/**
+ * Every packet the game knows, decoded in place.
+ *
+ * A received packet is deserialized straight into this variant, which lives on the stack or inside a queue
+ * slot, and is handled through static visitation. Nothing on the receive path touches the heap.
+ * A new packet type is added to the list below and gets a `static constexpr PacketType TYPE`.
+ */
+struct AnyPacket {
+    using Variant = std::variant<
+        std::monostate,
+        ConnectPacket,
+        PlayerJoinPacket,
+        PlayerDisconnectPacket,
+        PlayerUpdatePacket,
+        PlayerInputPacket>;
+
+    Variant value;
+
+    // size on the wire including the frame or datagram header, 0 for channel messages
+    uint16_t wireBytes = 0;
+
+    bool empty() const {
+        return std::holds_alternative<std::monostate>(value);
+    }
+
+    // PCK_NOTHING while empty, also for frames of a type nobody registered
+    PacketType type() const {
+        return std::visit([](const auto& p) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(p)>, std::monostate>) return PacketType::PCK_NOTHING;
+            else return std::decay_t<decltype(p)>::TYPE;
+        }, value);
+    }
+
+    void reset() {
+        value.emplace<std::monostate>();
+        wireBytes = 0;
+    }
+
+    template <typename T>
+    T* get() {
+        return std::get_if<T>(&value);
+    }
+};
+
+namespace PacketDispatch {
+    using Decoder = bool (*)(AnyPacket& out, const uint8_t* payload, size_t payloadSize);
+
+    template <typename T>
+    bool decodeAs(AnyPacket& out, const uint8_t* payload, size_t payloadSize) {
+        // packets are final, so this is a direct call
+        return out.value.template emplace<T>().deserialize(payload, payloadSize);
+    }
+
+    template <size_t... I>
+    constexpr std::array<Decoder, 256> buildTable(std::index_sequence<I...>) {
+        std::array<Decoder, 256> table{};
+        ((table[static_cast<uint8_t>(std::variant_alternative_t<I + 1, AnyPacket::Variant>::TYPE)] =
+              &decodeAs<std::variant_alternative_t<I + 1, AnyPacket::Variant>>), ...);
+        return table;
+    }
+
+    // indexed by PacketType, null for types nobody registered
+    inline constexpr std::array<Decoder, 256> TABLE =
+        buildTable(std::make_index_sequence<std::variant_size_v<AnyPacket::Variant> - 1>{});
+
+    template <size_t... I>
+    constexpr size_t largestPayload(std::index_sequence<I...>) {
+        size_t largest = 0;
+        ((largest = std::max(largest, std::variant_alternative_t<I + 1, AnyPacket::Variant>::Layout::MAX_WIRE_SIZE)), ...);
+        return largest;
+    }
+
+    static_assert(largestPayload(std::make_index_sequence<std::variant_size_v<AnyPacket::Variant> - 1>{}) <= PACKET_MAX_PAYLOAD,
+                  "PACKET_MAX_PAYLOAD must fit every packet");
+
+    /**
+     *
+     * Decode a payload into out
+     *
+     * @param type
+     * @param payload
+     * @param payloadSize
+     * @param out left empty for unknown packet types
+     * @return false if the payload is malformed
+     */
+    inline bool decode(PacketType type, const uint8_t* payload, size_t payloadSize, AnyPacket& out) {
+        const Decoder decoder = TABLE[static_cast<uint8_t>(type)];
+        if (!decoder) {
+            out.reset();
+            return true;
+        }
+
+        if (!decoder(out, payload, payloadSize)) {
+            out.reset();
+            return false;
+        }
+        return true;
+    }
+
+    // calls f with the concrete packet, nothing for an empty AnyPacket
+    template <typename F>
+    void visit(const AnyPacket& packet, F&& f) {
+        std::visit([&](const auto& p) {
+            if constexpr (!std::is_same_v<std::decay_t<decltype(p)>, std::monostate>) f(p);
+        }, packet.value);
+    }
+
+    inline void handleServer(const AnyPacket& packet, Server* server, Server::Client* client) {
+        visit(packet, [&](const auto& p) { p.handleServer(server, client); });
+    }
+
+    inline void handleClient(const AnyPacket& packet, Client* client) {
+        visit(packet, [&](const auto& p) { p.handleClient(client); });
+    }
+}
+
+#endif //PACKET_DISPATCH_H
@@ -0,0 +1,323 @@
+#ifndef PACKET_SCHEMA_H
+#define PACKET_SCHEMA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "network/packets.h"
+
+/**
+ * Compile-time packet layouts.
+ *
+ * A packet lists its fields once as a PacketSchema::Layout and gets serialize/deserialize from it:
+ *
+ *     using Layout = PacketSchema::Layout<
+ *         PacketSchema::U8<&MyPacket::flags>,
+ *         PacketSchema::Ranged<&MyPacket::id, 0, PLAYER_ID_MAX>>;
+ *
+ * Field widths are summed at compile time, so Layout::MAX_WIRE_SIZE sizes a stack buffer and a layout
+ * without variable fields has an exact Layout::WIRE_SIZE. Fields are packed most significant bit first,
+ * the same bit order as BitWriter, so byte wide fields at byte offsets give the plain PacketCodec layout.
+ * Decoding a fixed layout checks the payload size once and then reads every field without bounds checks,
+ * out of range values are collected into one flag instead of branching per field. Layouts made only of
+ * whole byte fields skip the bit stream and copy bytes directly.
+ */
+namespace PacketSchema {
+    template <typename T>
+    struct MemberTraits;
+
+    template <typename C, typename M>
+    struct MemberTraits<M C::*> {
+        using Class = C;
+        using Type = M;
+    };
+
+    template <auto Member>
+    using MemberType = typename MemberTraits<decltype(Member)>::Type;
+
+    // -------------------- bit stream --------------------
+
+    struct Sink {
+        uint8_t* out;
+        uint64_t acc = 0;
+        int bits = 0;
+
+        void put(uint32_t value, int count) {
+            acc = (acc << count) | value;
+            bits += count;
+            while (bits >= 8) {
+                bits -= 8;
+                *out++ = static_cast<uint8_t>(acc >> bits);
+            }
+        }
+
+        void finish() {
+            if (bits > 0) *out++ = static_cast<uint8_t>(acc << (8 - bits));
+            bits = 0;
+        }
+    };
+
+    struct Source {
+        const uint8_t* in;
+        size_t availableBits;   // only checked by layouts with variable fields
+        uint64_t acc = 0;
+        int bits = 0;
+        bool ok = true;
+
+        template <bool Checked>
+        uint32_t get(int count) {
+            if constexpr (Checked) {
+                if (static_cast<size_t>(count) > availableBits) {
+                    ok = false;
+                    return 0;
+                }
+                availableBits -= static_cast<size_t>(count);
+            }
+
+            while (bits < count) {
+                acc = (acc << 8) | *in++;
+                bits += 8;
+            }
+            bits -= count;
+            return static_cast<uint32_t>((acc >> bits) & ((uint64_t{1} << count) - 1));
+        }
+    };
+
+    // -------------------- fields --------------------
+
+    // Every field knows its min/max width in bits and how to put/get itself. Whole byte fields also
+    // have writeAligned/readAligned, used when every field of a layout starts on a byte boundary
+
+    template <auto Member>
+    struct U8 {
+        static_assert(sizeof(MemberType<Member>) == 1, "U8 needs a one byte member");
+        static constexpr size_t MIN_BITS = 8;
+        static constexpr size_t MAX_BITS = 8;
+
+        template <typename P>
+        static void write(const P& p, Sink& sink) {
+            sink.put(static_cast<uint8_t>(p.*Member), 8);
+        }
+
+        template <bool Checked, typename P>
+        static void read(P& p, Source& src) {
+            p.*Member = static_cast<MemberType<Member>>(src.template get<Checked>(8));
+        }
+
+        template <typename P>
+        static void writeAligned(const P& p, uint8_t*& out) {
+            *out++ = static_cast<uint8_t>(p.*Member);
+        }
+
+        template <typename P>
+        static void readAligned(P& p, const uint8_t*& in) {
+            p.*Member = static_cast<MemberType<Member>>(*in++);
+        }
+    };
+
+    // big endian like PacketCodec::write_i32_be
+    template <auto Member>
+    struct I32 {
+        static_assert(sizeof(MemberType<Member>) == 4, "I32 needs a four byte member");
+        static constexpr size_t MIN_BITS = 32;
+        static constexpr size_t MAX_BITS = 32;
+
+        template <typename P>
+        static void write(const P& p, Sink& sink) {
+            sink.put(static_cast<uint32_t>(p.*Member), 32);
+        }
+
+        template <bool Checked, typename P>
+        static void read(P& p, Source& src) {
+            p.*Member = static_cast<MemberType<Member>>(src.template get<Checked>(32));
+        }
+
+        template <typename P>
+        static void writeAligned(const P& p, uint8_t*& out) {
+            const uint32_t v = static_cast<uint32_t>(p.*Member);
+            out[0] = static_cast<uint8_t>(v >> 24);
+            out[1] = static_cast<uint8_t>(v >> 16);
+            out[2] = static_cast<uint8_t>(v >> 8);
+            out[3] = static_cast<uint8_t>(v);
+            out += 4;
+        }
+
+        template <typename P>
+        static void readAligned(P& p, const uint8_t*& in) {
+            const uint32_t v = (uint32_t{in[0]} << 24) | (uint32_t{in[1]} << 16) | (uint32_t{in[2]} << 8) | uint32_t{in[3]};
+            p.*Member = static_cast<MemberType<Member>>(v);
+            in += 4;
+        }
+    };
+
+    template <auto Member>
+    struct Bool {
+        static constexpr size_t MIN_BITS = 1;
+        static constexpr size_t MAX_BITS = 1;
+
+        template <typename P>
+        static void write(const P& p, Sink& sink) {
+            sink.put((p.*Member) ? 1u : 0u, 1);
+        }
+
+        template <bool Checked, typename P>
+        static void read(P& p, Source& src) {
+            p.*Member = static_cast<MemberType<Member>>(src.template get<Checked>(1));
+        }
+    };
+
+    // integer or enum in [Min, Max], takes only the bits the range needs. Written values are clamped
+    template <auto Member, int64_t Min, int64_t Max>
+    struct Ranged {
+        static_assert(Max > Min && Max - Min <= UINT32_MAX, "Ranged needs a non empty range that fits 32 bits");
+        static constexpr uint32_t RANGE = static_cast<uint32_t>(Max - Min);
+        static constexpr int BITS = PacketCodec::bits_required(RANGE);
+        static constexpr size_t MIN_BITS = BITS;
+        static constexpr size_t MAX_BITS = BITS;
+
+        template <typename P>
+        static void write(const P& p, Sink& sink) {
+            int64_t v = static_cast<int64_t>(p.*Member);
+            v = v < Min ? Min : (v > Max ? Max : v);
+            sink.put(static_cast<uint32_t>(v - Min), BITS);
+        }
+
+        template <bool Checked, typename P>
+        static void read(P& p, Source& src) {
+            const uint32_t v = src.template get<Checked>(BITS);
+            src.ok &= v <= RANGE;
+            p.*Member = static_cast<MemberType<Member>>(static_cast<int64_t>(v) + Min);
+        }
+    };
+
+    // fixed size char array, sent as is
+    template <auto Member>
+    struct Bytes {
+        static constexpr size_t N = std::extent_v<MemberType<Member>>;
+        static_assert(N > 0, "Bytes needs an array member");
+        static constexpr size_t MIN_BITS = N * 8;
+        static constexpr size_t MAX_BITS = N * 8;
+
+        template <typename P>
+        static void write(const P& p, Sink& sink) {
+            for (size_t i = 0; i < N; i++) sink.put(static_cast<uint8_t>((p.*Member)[i]), 8);
+        }
+
+        template <bool Checked, typename P>
+        static void read(P& p, Source& src) {
+            for (size_t i = 0; i < N; i++) (p.*Member)[i] = static_cast<char>(src.template get<Checked>(8));
+        }
+
+        template <typename P>
+        static void writeAligned(const P& p, uint8_t*& out) {
+            std::memcpy(out, p.*Member, N);
+            out += N;
+        }
+
+        template <typename P>
+        static void readAligned(P& p, const uint8_t*& in) {
+            std::memcpy(p.*Member, in, N);
+            in += N;
+        }
+    };
+
+    // char array sent with its length, up to size - 1 chars. Makes the layout variable sized
+    template <auto Member>
+    struct String {
+        static constexpr size_t MAX_LENGTH = std::extent_v<MemberType<Member>> - 1;
+        static constexpr int LENGTH_BITS = PacketCodec::bits_required(MAX_LENGTH);
+        static constexpr size_t MIN_BITS = LENGTH_BITS;
+        static constexpr size_t MAX_BITS = LENGTH_BITS + MAX_LENGTH * 8;
+
+        template <typename P>
+        static void write(const P& p, Sink& sink) {
+            const char* str = p.*Member;
+            size_t length = 0;
+            while (length < MAX_LENGTH && str[length] != '\0') length++;
+
+            sink.put(static_cast<uint32_t>(length), LENGTH_BITS);
+            for (size_t i = 0; i < length; i++) sink.put(static_cast<uint8_t>(str[i]), 8);
+        }
+
+        template <bool Checked, typename P>
+        static void read(P& p, Source& src) {
+            char* str = p.*Member;
+
+            size_t length = src.template get<Checked>(LENGTH_BITS);
+            src.ok &= length <= MAX_LENGTH;
+            if (length > MAX_LENGTH) length = 0;
+
+            for (size_t i = 0; i < length; i++) str[i] = static_cast<char>(src.template get<Checked>(8));
+            str[src.ok ? length : 0] = '\0';
+        }
+    };
+
+    // -------------------- layout --------------------
+
+    template <typename... Fields>
+    struct Layout {
+        static constexpr size_t MIN_BITS = (Fields::MIN_BITS + ... + 0);
+        static constexpr size_t MAX_BITS = (Fields::MAX_BITS + ... + 0);
+        static constexpr bool FIXED = MIN_BITS == MAX_BITS;
+        static constexpr bool BYTE_ALIGNED = ((Fields::MAX_BITS % 8 == 0 && Fields::MIN_BITS == Fields::MAX_BITS) && ...);
+
+        static constexpr size_t MAX_WIRE_SIZE = (MAX_BITS + 7) / 8;
+        static constexpr size_t MIN_WIRE_SIZE = (MIN_BITS + 7) / 8;
+        // exact payload size, only meaningful for FIXED layouts
+        static constexpr size_t WIRE_SIZE = MAX_WIRE_SIZE;
+
+        // encode into out, returns the number of bytes written (at most MAX_WIRE_SIZE)
+        template <typename P>
+        static size_t write(const P& packet, uint8_t* out) {
+            if constexpr (BYTE_ALIGNED) {
+                uint8_t* cursor = out;
+                (Fields::writeAligned(packet, cursor), ...);
+                return static_cast<size_t>(cursor - out);
+            } else {
+                Sink sink{out};
+                (Fields::write(packet, sink), ...);
+                sink.finish();
+                return static_cast<size_t>(sink.out - out);
+            }
+        }
+
+        // appends to out like IPacket::serialize
+        template <typename P>
+        static void write(const P& packet, std::vector<uint8_t>& out) {
+            const size_t start = out.size();
+            out.resize(start + MAX_WIRE_SIZE);
+            const size_t length = write(packet, out.data() + start);
+            if constexpr (!FIXED) out.resize(start + length);
+        }
+
+        template <typename P>
+        static bool read(P& packet, const uint8_t* payload, size_t payloadSize) {
+            if constexpr (BYTE_ALIGNED) {
+                if (payloadSize != WIRE_SIZE) return false;
+
+                const uint8_t* cursor = payload;
+                (Fields::readAligned(packet, cursor), ...);
+                return true;
+            } else if constexpr (FIXED) {
+                if (payloadSize != WIRE_SIZE) return false;
+
+                Source src{payload, 0};
+                (Fields::template read<false>(packet, src), ...);
+                return src.ok;
+            } else {
+                if (payloadSize < MIN_WIRE_SIZE || payloadSize > MAX_WIRE_SIZE) return false;
+
+                Source src{payload, payloadSize * 8};
+                (Fields::template read<true>(packet, src), ...);
+
+                // nothing but the padding of the last byte may be left
+                return src.ok && src.availableBits < 8;
+            }
+        }
+    };
+} // namespace PacketSchema
+
+#endif //PACKET_SCHEMA_H
@@ -4,12 +4,11 @@
 #include "util/net.h"
 #include <cstdint>
 #include <cstring>
-#include <functional>
 #include <memory>
-#include <unordered_map>
 #include <vector>
 
 #include "server.h"
+#include "stream_buffer.h"
 
 class Client;
 class Server;
@@ -19,13 +18,35 @@ enum class PacketType : uint8_t {
     PCK_CONNECT    = 1,
     PCK_JOIN       = 2,
     PCK_DISCONNECT = 3,
+    PCK_PLAYER_UPDATE = 4,
+    PCK_PLAYER_INPUT  = 5,
 };
 
+// First byte of every udp datagram
+enum class DatagramKind : uint8_t {
+    DGRAM_STATE = 0,    // unreliable, newest sequence wins
+    DGRAM_CHANNEL = 1,  // message channels with acks, see ChannelEndpoint
+};
+
+// Sender id used by the server in datagrams it sends
+#define DATAGRAM_SENDER_SERVER 0xFFFF
+// | kind:u8 | sender:u16 | token:u32 | in front of every datagram. The token belongs to the client the datagram
+// comes from or goes to and only ever travels over that client's tcp connection
+#define DATAGRAM_HEADER_SIZE 7
+
+// Highest player id a server hands out, bounded so packets can store ids in a few bits
+#define PLAYER_ID_MAX 1023
+// Positions outside of +-PLAYER_POS_LIMIT are clamped on the wire
+#define PLAYER_POS_LIMIT 65535
+// Largest payload of any known packet, PacketIO::nextPacket drops a connection that announces a longer one
+#define PACKET_MAX_PAYLOAD 64
+
 enum class DisconnectReason : uint8_t {
     DIS_LEFT    = 0,
     DIS_KICK    = 1,
     DIS_TIMEOUT = 2,
-    DIS_CLOSE   = 3
+    DIS_CLOSE   = 3,
+    DIS_OUT_OF_RANGE = 4    // only leaves the receiver's area of interest, never sent with a join
 };
 
 
@@ -66,8 +87,251 @@ namespace PacketCodec {
         off += n;
         return true;
     }
+
+    // true if sequence a is newer than b, survives the u16 wrap around
+    inline bool sequence_greater(uint16_t a, uint16_t b) {
+        return ((a > b) && (a - b <= 32768)) ||
+               ((a < b) && (b - a > 32768));
+    }
 } // namespace PacketCodec
 
+// -------------------- Bit packing --------------------
+
+namespace PacketCodec {
+    // bits needed to store any value in 0..range
+    constexpr int bits_required(uint32_t range) {
+        int bits = 0;
+        while (range > 0) {
+            bits++;
+            range >>= 1;
+        }
+        return bits;
+    }
+
+    // fixed point steps for a float in [min, max] at the given resolution
+    constexpr uint32_t quantized_steps(float min, float max, float resolution) {
+        return static_cast<uint32_t>((max - min) / resolution + 0.5f);
+    }
+} // namespace PacketCodec
+
+/**
+ * Appends values to a payload bit by bit, most significant bit first.
+ *
+ * Fields only take the bits they need: bounded integers use just enough bits for their range, small numbers
+ * use a varint and floats are quantized to a fixed resolution. flush() pads the last byte with zeros,
+ * it must be called before the payload is used.
+ */
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : mOut(out) {}
+
+    void writeBits(uint32_t value, int bits) {
+        for (int i = bits - 1; i >= 0; i--) {
+            mScratch = static_cast<uint8_t>((mScratch << 1) | ((value >> i) & 1u));
+            if (++mScratchBits == 8) {
+                mOut.push_back(mScratch);
+                mScratch = 0;
+                mScratchBits = 0;
+            }
+        }
+        mBitsWritten += static_cast<size_t>(bits);
+    }
+
+    void writeBool(bool value) {
+        writeBits(value ? 1u : 0u, 1);
+    }
+
+    // value is clamped into [min, max]
+    void writeRanged(int32_t value, int32_t min, int32_t max) {
+        if (value < min) value = min;
+        if (value > max) value = max;
+
+        const uint32_t range = static_cast<uint32_t>(static_cast<int64_t>(max) - min);
+        writeBits(static_cast<uint32_t>(static_cast<int64_t>(value) - min), PacketCodec::bits_required(range));
+    }
+
+    // 7 bits per group plus a continue bit, values below 128 take one byte
+    void writeVarUint(uint32_t value) {
+        while (value >= 0x80) {
+            writeBits((value & 0x7F) | 0x80, 8);
+            value >>= 7;
+        }
+        writeBits(value, 8);
+    }
+
+    // zigzag, so small negative numbers stay small
+    void writeVarInt(int32_t value) {
+        writeVarUint((static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+    }
+
+    // fixed point: value is clamped into [min, max] and rounded to the nearest multiple of resolution
+    void writeQuantized(float value, float min, float max, float resolution) {
+        if (value < min) value = min;
+        if (value > max) value = max;
+
+        const uint32_t steps = PacketCodec::quantized_steps(min, max, resolution);
+        const uint32_t q = static_cast<uint32_t>((value - min) / resolution + 0.5f);
+        writeBits(q > steps ? steps : q, PacketCodec::bits_required(steps));
+    }
+
+    // any angle in radians, wrapped into one turn and stored in the given number of bits (1..32)
+    void writeAngle(float radians, int bits) {
+        constexpr float turn = 6.28318530718f;
+        float wrapped = radians - turn * static_cast<float>(static_cast<int64_t>(radians / turn));
+        if (wrapped < 0.0f) wrapped += turn;
+
+        // 64 bit, one turn in 32 bits is 2^32 steps
+        const uint64_t steps = uint64_t{1} << bits;
+        const uint64_t q = static_cast<uint64_t>(static_cast<double>(wrapped) / turn * static_cast<double>(steps) + 0.5);
+        writeBits(static_cast<uint32_t>(q & (steps - 1)), bits);
+    }
+
+    // up to maxLength chars, only the used ones are sent
+    void writeString(const char* str, size_t maxLength) {
+        size_t length = 0;
+        while (length < maxLength && str[length] != '\0') length++;
+
+        writeBits(static_cast<uint32_t>(length), PacketCodec::bits_required(static_cast<uint32_t>(maxLength)));
+        for (size_t i = 0; i < length; i++) {
+            writeBits(static_cast<uint8_t>(str[i]), 8);
+        }
+    }
+
+    void flush() {
+        if (mScratchBits == 0) return;
+
+        mOut.push_back(static_cast<uint8_t>(mScratch << (8 - mScratchBits)));
+        mScratch = 0;
+        mScratchBits = 0;
+    }
+
+    size_t bitsWritten() const {
+        return mBitsWritten;
+    }
+
+private:
+    std::vector<uint8_t>& mOut;
+    uint8_t mScratch = 0;
+    int mScratchBits = 0;
+    size_t mBitsWritten = 0;
+};
+
+/**
+ * Reads what a BitWriter wrote, field by field in the same order. Every read returns false once the payload
+ * is exhausted or a value is out of its range, after that the reader stays failed.
+ */
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+
+    bool readBits(int bits, uint32_t& out) {
+        if (mFailed || mBitPos + static_cast<size_t>(bits) > mSize * 8) {
+            mFailed = true;
+            return false;
+        }
+
+        uint32_t value = 0;
+        for (int i = 0; i < bits; i++) {
+            const uint8_t byte = mData[mBitPos >> 3];
+            value = (value << 1) | ((byte >> (7 - (mBitPos & 7))) & 1u);
+            mBitPos++;
+        }
+
+        out = value;
+        return true;
+    }
+
+    bool readBool(bool& out) {
+        uint32_t v{};
+        if (!readBits(1, v)) return false;
+        out = v != 0;
+        return true;
+    }
+
+    bool readRanged(int32_t min, int32_t max, int32_t& out) {
+        const uint32_t range = static_cast<uint32_t>(static_cast<int64_t>(max) - min);
+
+        uint32_t v{};
+        if (!readBits(PacketCodec::bits_required(range), v)) return false;
+        if (v > range) return fail();
+
+        out = static_cast<int32_t>(static_cast<int64_t>(min) + v);
+        return true;
+    }
+
+    bool readVarUint(uint32_t& out) {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint32_t group{};
+            if (!readBits(8, group)) return false;
+
+            value |= (group & 0x7F) << shift;
+            if ((group & 0x80) == 0) {
+                out = value;
+                return true;
+            }
+        }
+        return fail();
+    }
+
+    bool readVarInt(int32_t& out) {
+        uint32_t v{};
+        if (!readVarUint(v)) return false;
+        out = static_cast<int32_t>((v >> 1) ^ (0u - (v & 1u)));
+        return true;
+    }
+
+    bool readQuantized(float min, float max, float resolution, float& out) {
+        const uint32_t steps = PacketCodec::quantized_steps(min, max, resolution);
+
+        uint32_t q{};
+        if (!readBits(PacketCodec::bits_required(steps), q)) return false;
+        if (q > steps) return fail();
+
+        out = min + static_cast<float>(q) * resolution;
+        return true;
+    }
+
+    bool readAngle(int bits, float& out) {
+        uint32_t q{};
+        if (!readBits(bits, q)) return false;
+
+        out = static_cast<float>(static_cast<double>(q) / static_cast<double>(uint64_t{1} << bits) * 6.28318530718);
+        return true;
+    }
+
+    // out must hold maxLength + 1 chars, it is always terminated
+    bool readString(char* out, size_t maxLength) {
+        uint32_t length{};
+        if (!readBits(PacketCodec::bits_required(static_cast<uint32_t>(maxLength)), length)) return false;
+        if (length > maxLength) return fail();
+
+        for (uint32_t i = 0; i < length; i++) {
+            uint32_t c{};
+            if (!readBits(8, c)) return false;
+            out[i] = static_cast<char>(c);
+        }
+        out[length] = '\0';
+        return true;
+    }
+
+    // true if everything up to the padding of the last byte was read
+    bool finished() const {
+        return !mFailed && (mSize * 8 - mBitPos) < 8;
+    }
+
+private:
+    bool fail() {
+        mFailed = true;
+        return false;
+    }
+
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mBitPos = 0;
+    bool mFailed = false;
+};
+
 // packet interface
 class IPacket {
 public:
@@ -75,43 +339,44 @@ public:
 
     virtual PacketType type() const = 0;
 
-    // payload only (no framing)
+    // payload only (no framing), appended to outPayload which may already hold other frames
     virtual void serialize(std::vector<uint8_t>& outPayload) const = 0;
     virtual bool deserialize(const uint8_t* payload, size_t payloadSize) = 0;
 
-    virtual void handleClient(Client* client) const {}
-    virtual void handleServer(Server* server, Server::Client* client) const {}
+    // Received packets are handled through AnyPacket (network/packet_dispatch.h), every packet class provides
+    // non-virtual handleClient(Client*) and handleServer(Server*, Server::Client*)
 };
 
-// packet registry
-class PacketRegistry {
-public:
-    using Factory = std::function<std::unique_ptr<IPacket>()>;
-
-    static void registerFactory(PacketType type, Factory factory);
-    static std::unique_ptr<IPacket> create(PacketType type);
-};
-
-#define AUTO_REGISTER_PACKET(PacketClass, PacketTypeValue)                          \
-    namespace PacketAutoReg {                                                       \
-        inline const bool PacketClass##_registered = []() {                         \
-            PacketRegistry::registerFactory(                                        \
-                PacketTypeValue,                                                    \
-                []() -> std::unique_ptr<IPacket> { return std::make_unique<PacketClass>(); } \
-            );                                                                      \
-            return true;                                                            \
-        }();                                                                        \
-    }
+// every known packet, decoded in place. See network/packet_dispatch.h
+struct AnyPacket;
 
 // -------------------- IO (framed packets) --------------------
 class PacketIO {
 public:
-    static Net::Result send(Socket socket, const void* buffer, int bufferSize);
-    static Net::Result receive(Socket socket, void* outBuffer, int bufferCapacity);
+    static Net::Result send(Socket socket, const void* buffer, int bufferSize, int* outSent = nullptr);
+    static Net::Result receive(Socket socket, void* outBuffer, int bufferCapacity, int* outRead = nullptr);
 
     // Framing: | type:u8 | payloadLen:u16 BE | payload... |
+    static bool writePacket(std::vector<uint8_t>& out, const IPacket& packet);
+    static Net::Result flush(Socket socket, std::vector<uint8_t>& out);
+
     static Net::Result sendPacket(Socket socket, const IPacket& packet);
-    static Net::Result receivePacket(Socket socket, std::unique_ptr<IPacket>& outPacket);
+
+    // Reassembly: the stream buffer carries half received frames over to the next call
+    static Net::Result fill(Socket socket, StreamBuffer& in);
+    static Net::Result nextPacket(StreamBuffer& in, AnyPacket& outPacket);
+    static Net::Result receivePacket(Socket socket, StreamBuffer& in, AnyPacket& outPacket);
+
+    // Datagram header, see DATAGRAM_HEADER_SIZE
+    static void writeDatagramHeader(uint8_t* out, DatagramKind kind, uint16_t sender, uint32_t token);
+    static bool readDatagramHeader(const uint8_t* data, int length, uint16_t& outSender, uint32_t& outToken);
+    static void setDatagramToken(uint8_t* datagram, uint32_t token);
+
+    // Datagram: | kind:u8 | sender:u16 BE | token:u32 BE | sequence:u16 BE | type:u8 | payload... |
+    static int writeDatagram(uint8_t* out, int capacity, uint16_t sender, uint32_t token, uint16_t sequence,
+                             const IPacket& packet);
+    static Net::Result readDatagram(const uint8_t* data, int length, uint16_t& outSender, uint16_t& outSequence,
+                                    AnyPacket& outPacket);
 };
 
 #endif //PACKETS_H
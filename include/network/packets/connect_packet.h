@@ -4,6 +4,7 @@
 #include "manager/console_manager.h"
 #include "network/client.h"
 #include "network/packets.h"
+#include "network/packet_schema.h"
 #include "network/server.h"
 
 class PlayerJoinPacket;
@@ -11,34 +12,31 @@ class ConnectPacket final : public IPacket {
 public:
     char name[25]{};
     int32_t id{};
+    uint32_t token{};   // 0 in the request, the reply carries the client's udp session token
 
-    PacketType type() const override { return PacketType::PCK_CONNECT; }
-    void serialize(std::vector<uint8_t>& outPayload) const override {
-        outPayload.clear();
-        outPayload.reserve(25 + 4);
+    // | name:25 bytes | id:i32 BE | token:u32 BE |
+    using Layout = PacketSchema::Layout<
+        PacketSchema::Bytes<&ConnectPacket::name>,
+        PacketSchema::I32<&ConnectPacket::id>,
+        PacketSchema::I32<&ConnectPacket::token>>;
 
-        outPayload.insert(outPayload.end(),
-                          reinterpret_cast<const uint8_t*>(name),
-                          reinterpret_cast<const uint8_t*>(name) + 25);
+    static constexpr PacketType TYPE = PacketType::PCK_CONNECT;
 
-        PacketCodec::write_i32_be(outPayload, id);
+    PacketType type() const override { return TYPE; }
+    void serialize(std::vector<uint8_t>& outPayload) const override {
+        Layout::write(*this, outPayload);
     }
     bool deserialize(const uint8_t* payload, size_t payloadSize) override {
-        size_t off = 0;
-        if (payloadSize != 25 + 4) return false;
-
-        if (!PacketCodec::read_bytes(payload, payloadSize, off, name, 25)) return false;
-        if (!PacketCodec::read_i32_be(payload, payloadSize, off, id)) return false;
-
-        return true;
+        return Layout::read(*this, payload, payloadSize);
     }
 
-    void handleClient(Client* client) const override {
+    void handleClient(Client* client) const {
         client->mId = id;
+        client->mUdpToken = token;
         client->mState = NetState::READY;
         ConsoleManager::get().log(SUCCESS, "Client: Connected to server");
     }
-    void handleServer(Server* server, Server::Client* client) const override {
+    void handleServer(Server* server, Server::Client* client) const {
         if (id != -1) {
             ConsoleManager::get().log(INFO, "Server: Somebody tried to join the server with a set id");
             return;
@@ -46,28 +44,32 @@ public:
 
         ConsoleManager::get().log(INFO, "Server: New client named: %s", name);
 
-        std::memcpy(client->name, &name[0], 25);
+        std::memcpy(server->getClientInfo(client->id).name, &name[0], 25);
         client->connected = true;
         client->accepted = true;
 
         ConnectPacket response{};
         std::memcpy(response.name, name, 25);
         response.id = client->id;
+        response.token = client->udpToken;
+
+        server->sendPacket(client, response);
 
-        PacketIO::sendPacket(client->sock, response);
+        // players are introduced once they come into range
+        if (server->isInterestEnabled()) return;
 
         // Tell new client about already-accepted clients
-        for (int i = 0; i < static_cast<int>(server->mClients.size()); i++) {
-            if (i == client->id) continue;
-            if (!server->mClients[i].accepted) continue;
+        for (const auto& other : server->mClients) {
+            if (other.id == client->id) continue;
+            if (!other.accepted) continue;
 
             PlayerJoinPacket playerPacket{};
-            playerPacket.id = i;
+            playerPacket.id = other.id;
             playerPacket.announce = 0;
             playerPacket.reason = DisconnectReason::DIS_LEFT;
-            std::memcpy(playerPacket.name, server->mClients[i].name, 25);
+            std::memcpy(playerPacket.name, server->getClientInfo(other.id).name, 25);
 
-            PacketIO::sendPacket(client->sock, playerPacket);
+            server->sendPacket(client, playerPacket);
         }
 
         // Broadcast: new client joined
@@ -80,6 +82,7 @@ public:
         server->broadcastPacket(joinPacket, true);
     }
 };
-AUTO_REGISTER_PACKET(ConnectPacket, PacketType::PCK_CONNECT);
+static_assert(ConnectPacket::Layout::BYTE_ALIGNED && ConnectPacket::Layout::WIRE_SIZE == 25 + 4 + 4,
+              "ConnectPacket must keep its byte layout");
 
 #endif //CONNECT_PACKET_H
\ No newline at end of file
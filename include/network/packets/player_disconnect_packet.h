@@ -1,9 +1,9 @@
 #ifndef PLAYER_DISCONNECT_PACKET_H
 #define PLAYER_DISCONNECT_PACKET_H
-#include "manager/client_manager.h"
 #include "manager/console_manager.h"
 #include "network/client.h"
 #include "network/packets.h"
+#include "network/packet_schema.h"
 
 class PlayerDisconnectPacket final : public IPacket {
 public:
@@ -11,32 +11,33 @@ public:
     DisconnectReason reason{};
     int32_t id{};
 
-    PacketType type() const override { return PacketType::PCK_DISCONNECT; }
-    void serialize(std::vector<uint8_t>& outPayload) const override {
-        outPayload.clear();
-        outPayload.reserve(1 + 1 + 4);
+    // | announce:u8 | reason:u8 | id:i32 BE |
+    using Layout = PacketSchema::Layout<
+        PacketSchema::U8<&PlayerDisconnectPacket::announce>,
+        PacketSchema::U8<&PlayerDisconnectPacket::reason>,
+        PacketSchema::I32<&PlayerDisconnectPacket::id>>;
+
+    static constexpr PacketType TYPE = PacketType::PCK_DISCONNECT;
 
-        PacketCodec::write_u8(outPayload, announce);
-        PacketCodec::write_u8(outPayload, static_cast<uint8_t>(reason));
-        PacketCodec::write_i32_be(outPayload, id);
+    PacketType type() const override { return TYPE; }
+    void serialize(std::vector<uint8_t>& outPayload) const override {
+        Layout::write(*this, outPayload);
     }
     bool deserialize(const uint8_t* payload, size_t payloadSize) override {
-        size_t off = 0;
-        if (payloadSize != 1 + 1 + 4) return false;
-
-        uint8_t r{};
-        if (!PacketCodec::read_u8(payload, payloadSize, off, announce)) return false;
-        if (!PacketCodec::read_u8(payload, payloadSize, off, r)) return false;
-        reason = static_cast<DisconnectReason>(r);
-
-        if (!PacketCodec::read_i32_be(payload, payloadSize, off, id)) return false;
-        return true;
+        return Layout::read(*this, payload, payloadSize);
     }
 
-    void handleClient(Client* client) const override {
+    void handleClient(Client* client) const {
         if (id == -1) {
             // get outa here
-            ClientManager::leave();
+            client->mState = NetState::CLOSED;
+            return;
+        }
+
+        client->mRemotePlayers.remove(id);
+
+        if (reason == DisconnectReason::DIS_OUT_OF_RANGE) {
+            ConsoleManager::get().log(INFO, "Client: Player %d is out of range", id);
             return;
         }
 
@@ -47,11 +48,12 @@ public:
 
         }
     }
-    void handleServer(Server* server, Server::Client* client) const override {
+    void handleServer(Server* server, Server::Client* client) const {
         ConsoleManager::get().log(INFO, "Server: Client left the game: %d", reason);
         server->removeClient(client->id, DisconnectReason::DIS_LEFT);
     }
 };
-AUTO_REGISTER_PACKET(PlayerDisconnectPacket, PacketType::PCK_DISCONNECT);
+static_assert(PlayerDisconnectPacket::Layout::BYTE_ALIGNED && PlayerDisconnectPacket::Layout::WIRE_SIZE == 1 + 1 + 4,
+              "PlayerDisconnectPacket must keep its byte layout");
 
 #endif //PLAYER_DISCONNECT_PACKET_H
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef PLAYER_INPUT_PACKET_H
+#define PLAYER_INPUT_PACKET_H
+#include "network/client.h"
+#include "network/packets.h"
+#include "network/packet_schema.h"
+#include "network/server.h"
+#include "player_movement.h"
+
+// Inputs repeated in every packet, a lost datagram costs nothing as long as one of the next ones arrives
+#define PLAYER_INPUT_REDUNDANCY 4
+
+// Sent over the udp state lane by the client, one per input step
+class PlayerInputPacket final : public IPacket {
+public:
+    uint16_t sequence{};    // of the newest input
+    uint8_t count{};        // inputs in history
+    uint16_t history{};     // PLAYER_BUTTON_BITS per input, newest in the lowest bits
+
+    // | sequence:16 bits | count:2 bits | history:16 bits |
+    using Layout = PacketSchema::Layout<
+        PacketSchema::Ranged<&PlayerInputPacket::sequence, 0, UINT16_MAX>,
+        PacketSchema::Ranged<&PlayerInputPacket::count, 1, PLAYER_INPUT_REDUNDANCY>,
+        PacketSchema::Ranged<&PlayerInputPacket::history, 0, UINT16_MAX>>;
+
+    static constexpr PacketType TYPE = PacketType::PCK_PLAYER_INPUT;
+
+    PacketType type() const override { return TYPE; }
+    void serialize(std::vector<uint8_t>& outPayload) const override {
+        Layout::write(*this, outPayload);
+    }
+    bool deserialize(const uint8_t* payload, size_t payloadSize) override {
+        return Layout::read(*this, payload, payloadSize);
+    }
+
+    // buttons of the input `age` steps before the newest one
+    uint8_t buttons(int age) const {
+        return static_cast<uint8_t>((history >> (age * PLAYER_BUTTON_BITS)) & ((1 << PLAYER_BUTTON_BITS) - 1));
+    }
+
+    void handleClient(Client*) const {}
+    void handleServer(Server* server, Server::Client* client) const {
+        server->applyInput(client, *this);
+    }
+};
+static_assert(PLAYER_INPUT_REDUNDANCY * PLAYER_BUTTON_BITS <= 16, "Input history must fit 16 bits");
+static_assert(PlayerInputPacket::Layout::FIXED && PlayerInputPacket::Layout::WIRE_SIZE == 5,
+              "PlayerInputPacket is expected to fit 5 bytes");
+
+#endif //PLAYER_INPUT_PACKET_H
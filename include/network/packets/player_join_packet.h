@@ -3,44 +3,36 @@
 #include "manager/console_manager.h"
 #include "network/client.h"
 #include "network/packets.h"
+#include "network/packet_schema.h"
 
 class PlayerJoinPacket final : public IPacket {
 public:
+    // payload size of the old encoding with the name padded to 25 bytes
+    static constexpr size_t BYTE_ENCODED_SIZE = 25 + 1 + 1 + 4;
+
     char name[25]{};
     uint8_t announce{};
     DisconnectReason reason{};
     int32_t id{};
 
-    PacketType type() const override { return PacketType::PCK_JOIN; }
-    void serialize(std::vector<uint8_t>& outPayload) const override {
-        outPayload.clear();
-        outPayload.reserve(25 + 1 + 1 + 4);
+    // | name:5 bit length + chars | announce:1 bit | reason:2 bits | id:10 bits |
+    using Layout = PacketSchema::Layout<
+        PacketSchema::String<&PlayerJoinPacket::name>,
+        PacketSchema::Bool<&PlayerJoinPacket::announce>,
+        PacketSchema::Ranged<&PlayerJoinPacket::reason, 0, static_cast<int64_t>(DisconnectReason::DIS_CLOSE)>,
+        PacketSchema::Ranged<&PlayerJoinPacket::id, 0, PLAYER_ID_MAX>>;
 
-        outPayload.insert(outPayload.end(),
-                          reinterpret_cast<const uint8_t*>(name),
-                          reinterpret_cast<const uint8_t*>(name) + 25);
+    static constexpr PacketType TYPE = PacketType::PCK_JOIN;
 
-        PacketCodec::write_u8(outPayload, announce);
-        PacketCodec::write_u8(outPayload, static_cast<uint8_t>(reason));
-        PacketCodec::write_i32_be(outPayload, id);
+    PacketType type() const override { return TYPE; }
+    void serialize(std::vector<uint8_t>& outPayload) const override {
+        Layout::write(*this, outPayload);
     }
     bool deserialize(const uint8_t* payload, size_t payloadSize) override {
-        size_t off = 0;
-        if (payloadSize != 25 + 1 + 1 + 4) return false;
-
-        if (!PacketCodec::read_bytes(payload, payloadSize, off, name, 25)) return false;
-
-        uint8_t r{};
-        if (!PacketCodec::read_u8(payload, payloadSize, off, announce)) return false;
-        if (!PacketCodec::read_u8(payload, payloadSize, off, r)) return false;
-        reason = static_cast<DisconnectReason>(r);
-
-        if (!PacketCodec::read_i32_be(payload, payloadSize, off, id)) return false;
-
-        return true;
+        return Layout::read(*this, payload, payloadSize);
     }
 
-    void handleClient(Client* client) const override {
+    void handleClient(Client* client) const {
         if (id == client->mId) return;
 
         ConsoleManager::get().log(SUCCESS, "Client: New client discovered with the name %s and id %d", name, id);
@@ -49,8 +41,9 @@ public:
 
         }
     }
-    void handleServer(Server* server, Server::Client* client) const override {};
+    void handleServer(Server*, Server::Client*) const {};
 };
-AUTO_REGISTER_PACKET(PlayerJoinPacket, PacketType::PCK_JOIN);
+static_assert(PlayerJoinPacket::Layout::MAX_WIRE_SIZE < PlayerJoinPacket::BYTE_ENCODED_SIZE,
+              "PlayerJoinPacket should never be larger than its old byte layout");
 
 #endif //PLAYER_JOIN_PACKET_H
\ No newline at end of file
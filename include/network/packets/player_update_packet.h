@@ -1,34 +1,66 @@
 #ifndef PLAYER_UPDATE_PACKET_H
 #define PLAYER_UPDATE_PACKET_H
+#include "network/client.h"
 #include "network/packets.h"
+#include "network/packet_schema.h"
+#include "network/server.h"
 
+// Sent over the udp state lane, never over tcp
 class PlayerUpdatePacket final : public IPacket {
 public:
+    // payload size of the old | id:i32 | posX:i32 | posY:i32 | encoding
+    static constexpr size_t BYTE_ENCODED_SIZE = 12;
+
     int32_t id{};
     int32_t posX{};
     int32_t posY{};
 
-    PacketType type() const override { return PacketType::PCK_NOTHING; }
+    // from the datagram header, not part of the payload
+    uint16_t sequence{};
+
+    // | id:10 bits | posX:17 bits | posY:17 bits |
+    using Layout = PacketSchema::Layout<
+        PacketSchema::Ranged<&PlayerUpdatePacket::id, 0, PLAYER_ID_MAX>,
+        PacketSchema::Ranged<&PlayerUpdatePacket::posX, -PLAYER_POS_LIMIT, PLAYER_POS_LIMIT>,
+        PacketSchema::Ranged<&PlayerUpdatePacket::posY, -PLAYER_POS_LIMIT, PLAYER_POS_LIMIT>>;
+
+    static constexpr PacketType TYPE = PacketType::PCK_PLAYER_UPDATE;
+
+    PacketType type() const override { return TYPE; }
     void serialize(std::vector<uint8_t>& outPayload) const override {
-        outPayload.clear();
-        outPayload.reserve(12);
-        PacketCodec::write_i32_be(outPayload, id);
-        PacketCodec::write_i32_be(outPayload, posX);
-        PacketCodec::write_i32_be(outPayload, posY);
+        Layout::write(*this, outPayload);
     }
     bool deserialize(const uint8_t* payload, size_t payloadSize) override {
-        size_t off = 0;
-        if (payloadSize != 12) return false;
-        if (!PacketCodec::read_i32_be(payload, payloadSize, off, id)) return false;
-        if (!PacketCodec::read_i32_be(payload, payloadSize, off, posX)) return false;
-        if (!PacketCodec::read_i32_be(payload, payloadSize, off, posY)) return false;
-        return true;
+        return Layout::read(*this, payload, payloadSize);
     }
 
-    void handleClient(Client* client) const override {
+    void handleClient(Client* client) const {
+        // our own state, tagged with the newest input the server applied
+        if (id == client->mId) {
+            client->mPrediction.reconcile(sequence, posX, posY, client->getTimeMs());
+            return;
+        }
 
+        // stale ones are dropped by the buffer
+        client->mRemotePlayers.push(id, sequence, posX, posY, client->getTimeMs());
     }
-    void handleServer(Server* server, Server::Client* client) const override {};
+    void handleServer(Server* server, Server::Client* client) const {
+        // once a client sends inputs its position is simulated here, not taken from it
+        if (client->hasInput) return;
+        if (client->hasUpdateSequence && !PacketCodec::sequence_greater(sequence, client->updateSequence)) return; // stale
+
+        client->updateSequence = sequence;
+        client->hasUpdateSequence = true;
+
+        // never trust the id on the wire, the sender is already known
+        PlayerUpdatePacket relay = *this;
+        relay.id = client->id;
+
+        server->moveClient(client, posX, posY);
+        server->relayDatagram(relay, sequence, client->id);
+    };
 };
+static_assert(PlayerUpdatePacket::Layout::FIXED && PlayerUpdatePacket::Layout::WIRE_SIZE == 6,
+              "PlayerUpdatePacket is expected to fit 6 bytes");
 
-#endif //PLAYER_UPDATE_PACKET_H
\ No newline at end of file
+#endif //PLAYER_UPDATE_PACKET_H
@@ -0,0 +1,99 @@
+#ifndef PREDICTION_H
+#define PREDICTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounds of the replay buffer in inputs, the size in between follows the measured rtt
+#define PREDICTION_MIN_INPUTS 16
+#define PREDICTION_MAX_INPUTS 1024
+// Round trips worth of inputs kept, covers rtt spikes and a late server tick
+#define PREDICTION_RTT_MARGIN 2.0
+
+struct PredictionStats {
+    double rttMs = 0;               // input sent until the server state that acked it arrived
+    size_t pending = 0;             // inputs not acked yet
+    size_t capacity = 0;
+    uint64_t acks = 0;
+    uint64_t corrections = 0;       // acks whose state did not match the prediction
+    uint64_t dropped = 0;           // inputs that fell out of the full buffer before they were acked
+    size_t lastReplayed = 0;        // inputs replayed by the last correction
+    double lastCorrection = 0;      // world units the predicted position moved on the last correction
+    double maxCorrection = 0;
+};
+
+/**
+ * Client side prediction of the local player.
+ *
+ * Every input is applied to the predicted position right away and kept with its sequence and the position it
+ * produced. When the server's state for an input arrives, everything up to that input is dropped. If the state
+ * differs from what was predicted for that input, the position is reset to the server's and the inputs the
+ * server has not seen yet are applied again. The buffer holds PREDICTION_RTT_MARGIN round trips of inputs,
+ * with the rtt measured from the inputs themselves.
+ */
+class Prediction {
+public:
+    Prediction();
+
+    void reset(int32_t x, int32_t y);
+
+    uint16_t apply(uint8_t buttons, double nowMs);
+    void reconcile(uint16_t ackSequence, int32_t x, int32_t y, double nowMs);
+
+    uint16_t history(int maxCount, uint8_t& outCount) const;
+
+    // Getter / Setter
+    int32_t getX() const {
+        return mX;
+    }
+
+    int32_t getY() const {
+        return mY;
+    }
+
+    // last state the server confirmed
+    int32_t getServerX() const {
+        return mServerX;
+    }
+
+    int32_t getServerY() const {
+        return mServerY;
+    }
+
+    uint16_t getSequence() const {
+        return mSequence;
+    }
+
+    PredictionStats stats() const;
+
+private:
+    struct Input {
+        uint16_t sequence;
+        uint8_t buttons;
+        int32_t x;          // position after this input
+        int32_t y;
+        double sentMs;
+    };
+
+    const Input& at(size_t age) const;
+    void fit();
+
+    // ring, oldest at mHead
+    std::vector<Input> mInputs;
+    size_t mHead = 0;
+    size_t mCount = 0;
+
+    int32_t mX = 0;
+    int32_t mY = 0;
+    int32_t mServerX = 0;
+    int32_t mServerY = 0;
+    uint16_t mSequence = 0;
+    uint16_t mLastAck = 0;
+    bool mHasAck = false;
+
+    double mRtt = 0;
+    PredictionStats mStats{};
+};
+
+#endif //PREDICTION_H
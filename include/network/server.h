@@ -2,19 +2,45 @@
 #define SERVER_H
 #include <atomic>
 
+#include "network/channel_endpoint.h"
+#include "network/datagram_channel.h"
+#include "network/interest_grid.h"
+#include "network/lag_history.h"
+#include "network/net_stats.h"
+#include "network/stream_buffer.h"
+#include "util/arena.h"
+#include "util/histogram.h"
 #include "util/net.h"
+#include "util/net_reactor.h"
+#include "util/slot_map.h"
+#include "util/tick_scheduler.h"
+#include "util/uring_transport.h"
 #include <memory>
 #include <cstdint>
+#include <mutex>
+#include <random>
+#include <thread>
 #include <vector>
 
+// Output queue limits per client
+#define SERVER_OUT_HIGH_WATER (256 * 1024)
+#define SERVER_OUT_MAX_STALL_TICKS 90
+// Input steps a client may run ahead of PLAYER_INPUT_RATE, covers 250 ms of datagrams arriving bunched up
+#define SERVER_INPUT_BURST 15
+// Longest block on the listener while nobody is connected, also bounds how long stop() takes to be noticed
+#define SERVER_IDLE_WAIT_MS 250
+
 class IPacket;
+class PlayerInputPacket;
+class ServerShard;
 enum class PacketType : uint8_t;
 struct PacketData;
 enum class DisconnectReason : uint8_t;
 
 class Server {
 public:
-    explicit Server(const Net::Address& address, int maxClients);
+    explicit Server(const Net::Address& address, int maxClients, Net::Transport transport = Net::Transport::NET_SYSCALL,
+                    int workers = 0);
     ~Server();
 
     void run();
@@ -28,13 +54,147 @@ public:
     // Status
     bool isRunning() const;
 
-    struct Client {
-        int id = -1;
+    // false if the constructor could not bind or listen
+    bool isListening() const {
+        return mListening;
+    }
 
-        char name[25] {};
+    // Tick scheduling, picked up by the tick thread at the start of the next frame
+    void setTickRate(double rate);
+    void setTickPolicy(TickPolicy policy);
+
+    double getTickRate() const {
+        return mTickRate;
+    }
+
+    TickPolicy getTickPolicy() const {
+        return mTickPolicy;
+    }
+
+    uint64_t getTick() const {
+        return mTick;
+    }
+
+    uint64_t getDroppedTicks() const {
+        return mDroppedTicks;
+    }
+
+    // Time spent in tick() since the server started, readable from any thread
+    struct TickTimeStats {
+        uint64_t ticks = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+    };
+
+    TickTimeStats getTickTimeStats() const {
+        return {mTicksRun, mTickTotalNs, mTickMaxNs};
+    }
+
+    // Broadcast fan-out counters for one tick, other threads read them through getNetStats()
+    struct BroadcastStats {
+        uint64_t broadcasts = 0;
+        uint64_t encodes = 0;
+        uint64_t encodesSaved = 0;     // serializations a per-recipient encode would have done on top
+        uint64_t bytesFannedOut = 0;
+        uint64_t encodeNs = 0;
+        uint64_t encodeNsSaved = 0;    // estimated from the measured encode time
+    };
+
+    // Allocator counters, taken at the end of every tick
+    struct AllocatorStats {
+        ArenaStats tickArena;
+        PoolStats pendingMessages;      // reliable messages waiting for their ack, over all client channels
+        PoolStats bufferedMessages;     // reliable messages that arrived before the gap in front of them filled
+    };
+
+    // copy, readable from any thread
+    AllocatorStats getAllocatorStats() const;
+
+    // Per connection counters and latency histograms, published by the tick thread every NET_STATS_PUBLISH_MS
+    struct NetStats {
+        double intervalMs = 0;                      // what the rates were taken over
+        std::vector<ConnectionSample> connections;  // connected clients by id
+        ConnectionStats total;
+        ConnectionRates totalRates;
+        Histogram rttUs;                            // channel rtt samples of every client since the last reset
+        Histogram phaseNs[TICK_PHASE_COUNT];        // by TickPhase, since the last reset
+        BroadcastStats broadcast;                   // of the tick that published
+    };
+
+    // copy of the last published stats, readable from any thread
+    NetStats getNetStats() const;
+
+    // clears the histograms at the start of the next tick, the counters keep running
+    void resetNetStats();
+
+    // Area of interest, picked up by the tick thread at the start of the next tick. A range of 0 sends
+    // every update to everybody
+    void setInterest(int32_t cellSize, int32_t range, int32_t hysteresis);
+
+    int32_t getInterestCellSize() const {
+        return mInterestCellSize;
+    }
+
+    int32_t getInterestRange() const {
+        return mInterestRange;
+    }
+
+    int32_t getInterestHysteresis() const {
+        return mInterestHysteresis;
+    }
+
+    // counters of the last tick's interest update, copy readable from any thread
+    InterestStats getInterestStats() const;
+
+    // tick thread only, follows the settings applied at the start of the tick
+    bool isInterestEnabled() const {
+        return mInterest.getRange() > 0;
+    }
+
+    // tick thread only, packet handlers query it. Other threads use getLagHistoryStats()
+    const LagHistory& getLagHistory() const {
+        return mLagHistory;
+    }
+
+    // sizes and ticks covered as of the last tick, copy readable from any thread
+    LagHistoryStats getLagHistoryStats() const;
+
+    // Per tick state of a connection, kept densely packed for the loops that visit every client
+    struct Client {
+        int id = -1;                // slot index, also the player id on the wire
+        uint32_t generation = 0;    // slot generation, tells apart connections that reused the same id
 
         Socket sock{};
-        Net::Address addr{};
+
+        // framed bytes queued this tick or not yet taken by the socket
+        std::vector<uint8_t> out;
+        int stalledTicks = 0;
+
+        // received bytes not yet cut into packets
+        StreamBuffer in;
+
+        // udp state lane, bound to the first datagram that carries the token. The token is random per
+        // connection and only sent over tcp, so nobody else can send as or redirect this client
+        uint32_t udpToken = 0;
+        Net::Address udpAddr{};
+        bool hasUdp = false;
+        uint16_t updateSequence = 0;
+        bool hasUpdateSequence = false;
+
+        // authoritative position, simulated from the client's inputs
+        int32_t posX = 0;
+        int32_t posY = 0;
+        uint16_t inputSequence = 0;
+        bool hasInput = false;
+
+        // input steps the client may still apply, refilled at PLAYER_INPUT_RATE up to SERVER_INPUT_BURST
+        double inputBudget = SERVER_INPUT_BURST;
+        double inputRefillMs = -1.0;
+
+        // message channels over the udp lane, created on first use
+        std::unique_ptr<ChannelEndpoint> channel;
+
+        ConnectionStats stats;
 
         bool connected = false;
         bool accepted = false;
@@ -43,18 +203,128 @@ public:
         bool writable = false;
     };
 
-    std::vector<Client> mClients;
+    // Rarely touched details of a connection, indexed by client id
+    struct ClientInfo {
+        char name[25] {};
+        Net::Address addr{};
+
+        // counters as of the last net stats publish, rates are taken against them
+        ConnectionStats publishedStats;
+    };
+
+    using ClientHandle = SlotMap<Client>::Handle;
+
+    // Live clients. Removed clients stay in here with connected = false until the end of the tick,
+    // so Client pointers stay valid for the whole tick
+    SlotMap<Client> mClients;
+
+    Client* getClient(int id) {
+        return id < 0 ? nullptr : mClients.find(static_cast<uint32_t>(id));
+    }
+
+    ClientInfo& getClientInfo(int id) {
+        return mClientInfo[id];
+    }
+
+    Net::Result sendPacket(Client* client, const IPacket& packet);
+    void sendDatagram(Client* client, const IPacket& packet, uint16_t sequence);
+    void broadcastDatagram(const IPacket& packet, uint16_t sequence, int exceptId = -1);
+    void relayDatagram(const IPacket& packet, uint16_t sequence, int senderId);
+    void moveClient(Client* client, int32_t x, int32_t y);
+    double viewTick(const Client* client, double renderDelayMs) const;
+    void applyInput(Client* client, const PlayerInputPacket& input);
+    bool sendChannel(Client* client, ChannelType channel, const IPacket& packet);
 private:
     void processPackage(Client* client);
     void acceptClients();
-    void sleep(double tickStartTimeMs);
+    void tick();
+    void retireClients();
+    bool hasConnectedClients() const;
     void processClients();
+    void processRing();
+    void pollEvents(int timeoutMs);
+    void processShards();
+    void processDatagrams();
+    void updateInterest();
+    void recordHistory();
+    Net::Result flushClient(Client& client);
+    void flushClients();
+    ChannelEndpoint& channelOf(Client& client);
+    void publishNetStats();
 
     Socket mSocket{};
     int mMaxClients{};
+    bool mListening = false;
+
+    // Readiness
+    static constexpr uint64_t LISTENER_KEY = UINT64_MAX;
+
+    NetReactor mReactor{};
+    std::vector<int> mReadyClients;
+    std::vector<int> mProcessing;
+    std::vector<int> mSlowClients;
+    std::vector<ClientHandle> mRetired;
+    std::vector<ClientInfo> mClientInfo;
+
+    // State lane
+    DatagramChannel mDatagram;
+    std::random_device mTokenSource;
+
+    // Broadcast
+    std::vector<uint8_t> mBroadcastFrame;
+    BroadcastStats mBroadcastStats{};
+    BroadcastStats mLastBroadcastStats{};
+    bool mAcceptPending = false;
+
+    // Area of interest, positions by client id
+    InterestGrid mInterest;
+    std::atomic<int32_t> mInterestCellSize{INTEREST_DEFAULT_CELL};
+    std::atomic<int32_t> mInterestRange{INTEREST_DEFAULT_RANGE};
+    std::atomic<int32_t> mInterestHysteresis{INTEREST_DEFAULT_HYSTERESIS};
+    std::atomic<bool> mInterestChanged{false};
+
+    // Lag compensation, positions of the last ticks keyed by mTick
+    LagHistory mLagHistory;
+
+    // Net stats, the histograms belong to the tick thread and are copied out when publishing
+    Histogram mRttHistogram;
+    Histogram mPhaseHistograms[TICK_PHASE_COUNT];
+    double mNetStatsPublishedMs = -1.0;
+    std::atomic<bool> mNetStatsReset{false};
+    mutable std::mutex mNetStatsMutex;
+    NetStats mNetStats;
+
+    // Memory that lives for one tick, released in one go at its end
+    Arena mTickArena;
+
+    // Per tick stats the tick thread publishes for other threads
+    mutable std::mutex mStatsMutex;
+    AllocatorStats mAllocatorStats{};
+    InterestStats mInterestStats{};
+    LagHistoryStats mLagHistoryStats{};
+
+    // Transport
+    std::unique_ptr<UringTransport> mUring;
+    std::vector<UringTransport::Completion> mCompletions;
+
+    // Sharded io, client sockets live on worker threads. Empty when everything runs on the tick thread
+    std::vector<std::unique_ptr<ServerShard>> mShards;
+
+    ServerShard* shardOf(int id) const {
+        return mShards.empty() ? nullptr : mShards[id % mShards.size()].get();
+    }
 
+    // Scheduling
+    TickScheduler mScheduler{};
+    std::atomic<double> mTickRate{TICK_DEFAULT_RATE};
+    std::atomic<TickPolicy> mTickPolicy{TickPolicy::TICK_CATCH_UP};
+    std::atomic<uint64_t> mTick{};
+    std::atomic<uint64_t> mDroppedTicks{};
+    std::atomic<uint64_t> mTicksRun{};
+    std::atomic<uint64_t> mTickTotalNs{};
+    std::atomic<uint64_t> mTickMaxNs{};
 
-    uint64_t mTick{};
+    std::thread mThread;
     std::atomic<bool> mRunning{false};
 };
 
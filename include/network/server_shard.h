@@ -0,0 +1,123 @@
+#ifndef SERVER_SHARD_H
+#define SERVER_SHARD_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "network/packet_dispatch.h"
+#include "network/stream_buffer.h"
+#include "util/net.h"
+#include "util/net_reactor.h"
+#include "util/spsc_queue.h"
+
+/**
+ * One I/O worker of a sharded server.
+ *
+ * The worker thread owns the sockets of its clients: it waits on its own reactor, reassembles and decodes
+ * packets and pushes them to the simulation thread through a lock-free queue. The simulation thread never
+ * touches those sockets, it hands finished output buffers back through a second queue and the worker sends
+ * them. Emptied buffers travel back through a third queue so steady state does not allocate.
+ *
+ * All public functions except the constructor/destructor are for the simulation thread only.
+ */
+class ServerShard {
+public:
+    struct Event {
+        enum class Kind : uint8_t {
+            PACKET,         // packet decoded for clientId
+            DISCONNECTED,   // the socket of clientId closed or failed
+            SLOW,           // clientId is over SERVER_OUT_HIGH_WATER
+        };
+
+        Kind kind{};
+        int clientId{};
+        uint32_t generation{};  // ids are reused, this tells connections on the same id apart
+        AnyPacket packet;
+    };
+
+    explicit ServerShard(int index);
+    ~ServerShard();
+
+    ServerShard(const ServerShard&) = delete;
+    ServerShard& operator=(const ServerShard&) = delete;
+
+    void start();
+    void stop();
+
+    // Simulation thread
+    void addClient(int id, uint32_t generation, Socket sock);
+    void send(int id, std::vector<uint8_t>& bytes);
+    void removeClient(int id);
+    bool poll(Event& out);
+
+    // Getter / Setter
+    int getIndex() const {
+        return mIndex;
+    }
+
+    uint64_t packetsDecoded() const {
+        return mPacketsDecoded.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Command {
+        enum class Kind : uint8_t {
+            ADD,
+            SEND,
+            REMOVE,
+        };
+
+        Kind kind{};
+        int clientId{};
+        uint32_t generation{};
+        Socket sock{};
+        std::vector<uint8_t> bytes;
+    };
+
+    struct Connection {
+        int id{};
+        uint32_t generation{};
+        Socket sock{};
+
+        StreamBuffer in;
+        std::vector<uint8_t> out;
+
+        bool readable = false;
+        bool closed = false;
+        bool slowReported = false;
+
+        // decoded but the event queue was full
+        AnyPacket stalled;
+    };
+
+    void run();
+    void pushCommand(Command&& command);
+    void handleCommand(Command& command);
+    void readConnection(Connection& conn);
+    void flushConnection(Connection& conn);
+    void closeConnection(Connection& conn);
+
+    int mIndex{};
+
+    std::thread mThread;
+    std::atomic<bool> mRunning{false};
+
+    // sized in the constructor
+    SpscQueue<Command> mCommands;
+    SpscQueue<Event> mEvents;
+    SpscQueue<std::vector<uint8_t>> mRecycled;
+
+    std::atomic<uint64_t> mPacketsDecoded{0};
+
+    // Worker thread only
+    NetReactor mReactor{};
+    std::unordered_map<int, Connection> mConnections;
+    std::vector<int> mReadable;
+    std::vector<std::pair<int, uint32_t>> mUnreported;
+};
+
+#endif //SERVER_SHARD_H
@@ -0,0 +1,123 @@
+#ifndef SNAPSHOT_BUFFER_H
+#define SNAPSHOT_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Snapshots kept per remote player, power of two
+#define SNAPSHOT_RING 32
+// Bounds of the playback delay, the delay itself follows the measured jitter
+#define SNAPSHOT_MIN_DELAY_MS 50.0
+#define SNAPSHOT_MAX_DELAY_MS 500.0
+// Jitter multiples added to the update interval for the target delay
+#define SNAPSHOT_JITTER_FACTOR 2.5
+// Longest a player is moved along its last velocity when the next snapshot is late
+#define SNAPSHOT_MAX_EXTRAPOLATION_MS 100.0
+// Arrival this far off the expected timeline restarts it, the sender paused or was out of range
+#define SNAPSHOT_RESYNC_MS 250.0
+// Update interval assumed until the first ones were measured
+#define SNAPSHOT_DEFAULT_INTERVAL_MS (1000.0 / 30.0)
+// Sender steps the interval is measured over before the measurement restarts
+#define SNAPSHOT_INTERVAL_WINDOW 256
+
+struct SnapshotStats {
+    size_t players = 0;
+    size_t extrapolated = 0;    // last sample(): newest snapshot was older than the render time
+    size_t starved = 0;         // last sample(): extrapolated past SNAPSHOT_MAX_EXTRAPOLATION_MS and held
+    uint64_t received = 0;
+    uint64_t stale = 0;         // older than a snapshot that was already there
+    uint64_t resyncs = 0;
+    double intervalMs = 0;
+    double jitterMs = 0;
+    double delayMs = 0;
+    double targetDelayMs = 0;
+};
+
+/**
+ * Timestamped state of every remote player and where to draw it.
+ *
+ * Each player gets a ring of the last SNAPSHOT_RING positions. Snapshots are not stamped with their raw arrival
+ * time: the sender sequence and the measured update interval give a smooth timeline that only follows the
+ * arrivals slowly, the difference between the two is the jitter. Drawing happens at now - delay, between the
+ * two snapshots around that time, or briefly along the last velocity if nothing newer arrived yet. The delay
+ * aims at interval + SNAPSHOT_JITTER_FACTOR * jitter and changes by at most 10% of the elapsed time, so playback
+ * only runs slightly faster or slower while it adapts.
+ *
+ * Players are stored densely, sample() goes over all of them in one loop and writes the render positions.
+ */
+class SnapshotBuffer {
+public:
+    explicit SnapshotBuffer(int maxPlayers);
+
+    bool push(int id, uint16_t sequence, int32_t x, int32_t y, double arrivalMs);
+    void remove(int id);
+    void clear();
+
+    void sample(double nowMs);
+
+    // Getter / Setter
+    size_t size() const {
+        return mIds.size();
+    }
+
+    // dense index order, valid until the next push() or remove()
+    int idAt(size_t index) const {
+        return mIds[index];
+    }
+
+    float renderX(size_t index) const {
+        return mRenderX[index];
+    }
+
+    float renderY(size_t index) const {
+        return mRenderY[index];
+    }
+
+    bool has(int id) const {
+        return id >= 0 && id < static_cast<int>(mIndexOf.size()) && mIndexOf[id] != -1;
+    }
+
+    SnapshotStats stats() const;
+
+private:
+    struct Ring {
+        double time[SNAPSHOT_RING];
+        float x[SNAPSHOT_RING];
+        float y[SNAPSHOT_RING];
+        uint32_t head = 0;      // next write
+        uint32_t count = 0;
+    };
+
+    struct Timeline {
+        double lastTime = 0;        // timeline stamp of the newest snapshot
+        double interval = SNAPSHOT_DEFAULT_INTERVAL_MS;
+        uint16_t lastSequence = 0;
+
+        // interval is measured over many updates, single late or reordered ones barely move it
+        double baseArrival = 0;
+        uint32_t stepsSinceBase = 0;
+    };
+
+    std::vector<int> mIndexOf;      // by player id, -1 if unknown
+    std::vector<int> mIds;
+    std::vector<Ring> mRings;
+    std::vector<Timeline> mTimelines;
+    std::vector<float> mRenderX;
+    std::vector<float> mRenderY;
+
+    double mInterval = SNAPSHOT_DEFAULT_INTERVAL_MS;
+    double mJitter = 0;
+    double mDelay = SNAPSHOT_MIN_DELAY_MS;
+    double mLastSampleMs = -1;
+
+    size_t mExtrapolated = 0;
+    size_t mStarved = 0;
+    uint64_t mReceived = 0;
+    uint64_t mStale = 0;
+    uint64_t mResyncs = 0;
+
+    double targetDelay() const;
+};
+
+#endif //SNAPSHOT_BUFFER_H
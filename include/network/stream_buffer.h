@@ -0,0 +1,60 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Receive buffer for one TCP stream.
+ *
+ * The socket is read into the free space at the back with large reads and complete frames
+ * are cut from the front without copying. A frame that is only half received stays in the
+ * buffer until the rest arrives. When the back runs out of space the unread bytes (at most one
+ * partial frame once everything complete was consumed) are moved to the front, so every frame is
+ * always contiguous and can be handed to IPacket::deserialize as is.
+ */
+class StreamBuffer {
+public:
+    explicit StreamBuffer(size_t capacity = 8 * 1024);
+
+    // Write side
+    uint8_t* writePtr() {
+        return mData.data() + mEnd;
+    }
+
+    size_t writable() const {
+        return mData.size() - mEnd;
+    }
+
+    void commit(size_t n) {
+        mEnd += n;
+    }
+
+    // Read side
+    const uint8_t* readPtr() const {
+        return mData.data() + mBegin;
+    }
+
+    size_t readable() const {
+        return mEnd - mBegin;
+    }
+
+    void consume(size_t n);
+
+    void reserve(size_t frameSize);
+    void compact();
+    void clear();
+
+    size_t capacity() const {
+        return mData.size();
+    }
+
+private:
+    std::vector<uint8_t> mData;
+
+    size_t mBegin{};
+    size_t mEnd{};
+};
+
+#endif //STREAM_BUFFER_H
@@ -2,19 +2,26 @@
 #define PLAYER_H
 #include "input/input.h"
 
+// Input steps run in one frame at most, a longer stall drops the rest instead of fast forwarding
+#define PLAYER_MAX_STEPS_PER_FRAME 5
+
 class Player {
 public:
     explicit Player();
     ~Player() = default;
 
     void draw();
-    void update();
+    void update(float frameTime);
 
 private:
     int mPosX, mPozY;
 
-    std::map<int, Player> mEnimies{};
+    // frame time not turned into input steps yet
+    double mInputTime = 0;
+    bool mShowOverlay = false;
+
+    // other players are not Players, they live interpolated in Client::mRemotePlayers
 };
 
 
-#endif //PLAYER_H
\ No newline at end of file
+#endif //PLAYER_H
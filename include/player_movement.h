@@ -0,0 +1,45 @@
+#ifndef PLAYER_MOVEMENT_H
+#define PLAYER_MOVEMENT_H
+#include <cstdint>
+
+#include "network/packets.h"
+
+// Inputs per second, the client predicts and the server simulates with the same fixed step
+#define PLAYER_INPUT_RATE 60.0
+// World units moved per input step
+#define PLAYER_MOVE_SPEED 4
+// Bits of one input on the wire
+#define PLAYER_BUTTON_BITS 4
+
+enum class PlayerButton : uint8_t {
+    BTN_UP    = 1 << 0,
+    BTN_DOWN  = 1 << 1,
+    BTN_LEFT  = 1 << 2,
+    BTN_RIGHT = 1 << 3
+};
+
+namespace PlayerMovement {
+    inline bool held(uint8_t buttons, PlayerButton button) {
+        return (buttons & static_cast<uint8_t>(button)) != 0;
+    }
+
+    /**
+     *
+     * Move by one input. Integer only, so prediction and server always end up on the same position
+     *
+     * @param x
+     * @param y
+     * @param buttons PlayerButton bits
+     */
+    inline void step(int32_t& x, int32_t& y, uint8_t buttons) {
+        if (held(buttons, PlayerButton::BTN_UP)) y -= PLAYER_MOVE_SPEED;
+        if (held(buttons, PlayerButton::BTN_DOWN)) y += PLAYER_MOVE_SPEED;
+        if (held(buttons, PlayerButton::BTN_LEFT)) x -= PLAYER_MOVE_SPEED;
+        if (held(buttons, PlayerButton::BTN_RIGHT)) x += PLAYER_MOVE_SPEED;
+
+        x = x < -PLAYER_POS_LIMIT ? -PLAYER_POS_LIMIT : (x > PLAYER_POS_LIMIT ? PLAYER_POS_LIMIT : x);
+        y = y < -PLAYER_POS_LIMIT ? -PLAYER_POS_LIMIT : (y > PLAYER_POS_LIMIT ? PLAYER_POS_LIMIT : y);
+    }
+}
+
+#endif //PLAYER_MOVEMENT_H
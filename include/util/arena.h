@@ -0,0 +1,92 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Size of the first block, later blocks double until one tick fits
+#define ARENA_DEFAULT_BLOCK (64 * 1024)
+
+struct ArenaStats {
+    size_t used = 0;                // bytes handed out since the last reset
+    size_t peak = 0;                // most bytes used in a single tick
+    size_t capacity = 0;            // bytes owned
+    uint64_t resets = 0;
+    uint64_t blockAllocations = 0;  // heap allocations over the whole lifetime
+    uint64_t lastTickAllocations = 0; // heap allocations during the tick before the last reset
+    uint64_t objects = 0;           // objects created since the last reset
+};
+
+/**
+ * Bump allocator for data that lives exactly one tick (or one frame on the client).
+ *
+ * Allocating moves a pointer, reset() releases everything at once. Objects with a destructor are
+ * remembered and destroyed by reset(), newest first. If a tick needed more than one block, reset()
+ * replaces them with a single block large enough for all of it, so a steady load stops touching the
+ * heap after the first ticks. Not thread safe, every arena belongs to one loop.
+ */
+class Arena {
+public:
+    explicit Arena(size_t blockSize = ARENA_DEFAULT_BLOCK);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t));
+    uint8_t* copy(const void* data, size_t size);
+    void reset();
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        void* memory = allocate(sizeof(T), alignof(T));
+        T* object = new (memory) T(std::forward<Args>(args)...);
+
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            Destructor* d = static_cast<Destructor*>(allocate(sizeof(Destructor), alignof(Destructor)));
+            d->object = object;
+            d->destroy = [](void* p) { static_cast<T*>(p)->~T(); };
+            d->next = mDestructors;
+            mDestructors = d;
+        }
+
+        mStats.objects++;
+        return object;
+    }
+
+    // Getter / Setter
+    const ArenaStats& stats() const {
+        return mStats;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size{};
+    };
+
+    struct Destructor {
+        void* object;
+        void (*destroy)(void*);
+        Destructor* next;
+    };
+
+    void addBlock(size_t minimum);
+
+    std::vector<Block> mBlocks;
+    size_t mCurrent = 0;    // block being bumped
+    size_t mOffset = 0;     // into the current block
+    size_t mBlockSize;
+
+    Destructor* mDestructors = nullptr;
+    uint64_t mTickAllocations = 0;
+
+    ArenaStats mStats;
+};
+
+#endif //ARENA_H
@@ -5,5 +5,7 @@
 #include <vector>
 
 std::vector<std::string> CompleteCommandNames(std::string_view prefix);
+std::vector<std::string> CompleteTransportNames(std::string_view prefix);
+std::vector<std::string> CompleteTickPolicies(std::string_view prefix);
 
 #endif //AUTO_COMPLETION_H
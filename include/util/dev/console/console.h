@@ -1,11 +1,15 @@
 #ifndef CONSOLE_H
 #define CONSOLE_H
+#include <cstdio>
 #include <deque>
+#include <mutex>
 #include <span>
 #include <string_view>
 #include <vector>
 
+#if !defined(MP_HEADLESS)
 #include "raylib.h"
+#endif
 #include "util/dev/console/command/registry.h"
 
 #define CONSOLE_MAX_LOG 1000
@@ -28,9 +32,13 @@ public:
     ~Console();
 
     // Core
+#if !defined(MP_HEADLESS)
     void draw();
     void handleInput();
+#endif
     void log(LogLevel level, const char* format, ...);
+    void execute(std::string_view line);
+    bool openLogFile(const char* path);
 
     void clearLogs();
 
@@ -38,6 +46,11 @@ public:
     void setOpen(bool open);
     bool isOpen() const;
 
+    // lines of a later LogLevel stay in the console but are not written to stdout or the log file
+    void setOutputLevel(LogLevel level) {
+        mOutputLevel = level;
+    }
+
     CommandRegistry* getRegistry() {
         return &mRegistry;
     }
@@ -50,6 +63,7 @@ private:
 
     void executeCommand();
     void autoComplete();
+    void writeLine(LogLevel level, const char* text);
 
     // Dependencies
     CommandRegistry mRegistry{};
@@ -68,7 +82,14 @@ private:
     bool mOpen = false;
     bool mCursorBlink = true;
 
+    // Output, stdout in the headless server and the log file if one is open
+    std::FILE* mLogFile = nullptr;
+    LogLevel mOutputLevel = SUCCESS;
+    std::mutex mOutputMutex;
+
+#if !defined(MP_HEADLESS)
     Font mFont;
+#endif
 };
 
 class ConsoleCommand {
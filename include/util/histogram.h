@@ -0,0 +1,61 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// 64 buckets per power of two, a recorded value is off by at most 1/64 (1.6%)
+#define HISTOGRAM_SUB_BUCKET_BITS 6
+// Values up to 2^36 (68 s in ns), larger ones are counted in the last bucket
+#define HISTOGRAM_MAX_BITS 36
+
+/**
+ * Fixed memory latency histogram in the style of HdrHistogram.
+ *
+ * Values below 2 * 2^HISTOGRAM_SUB_BUCKET_BITS get a bucket each, above that every power of two is split into
+ * 2^HISTOGRAM_SUB_BUCKET_BITS buckets, so the relative error stays the same from nanoseconds to seconds.
+ * record() is a few shifts and an increment, nothing allocates. Percentiles are reported as the highest value
+ * of their bucket, never below the real value. The unit is whatever the caller records, the name says it.
+ */
+class Histogram {
+public:
+    static constexpr size_t LINEAR = size_t{2} << HISTOGRAM_SUB_BUCKET_BITS;
+    static constexpr size_t SUB_BUCKETS = size_t{1} << HISTOGRAM_SUB_BUCKET_BITS;
+    static constexpr size_t BUCKETS = LINEAR + (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BUCKET_BITS - 1) * SUB_BUCKETS;
+
+    void record(uint64_t value);
+    void merge(const Histogram& other);
+    void reset();
+
+    uint64_t percentile(double percent) const;
+
+    // Getter / Setter
+    uint64_t count() const {
+        return mCount;
+    }
+
+    uint64_t min() const {
+        return mCount > 0 ? mMin : 0;
+    }
+
+    uint64_t max() const {
+        return mMax;
+    }
+
+    double mean() const {
+        return mCount > 0 ? static_cast<double>(mSum) / static_cast<double>(mCount) : 0;
+    }
+
+private:
+    static size_t indexOf(uint64_t value);
+    static uint64_t highestOf(size_t index);
+
+    std::array<uint64_t, BUCKETS> mCounts{};
+    uint64_t mCount = 0;
+    uint64_t mSum = 0;
+    uint64_t mMin = UINT64_MAX;
+    uint64_t mMax = 0;
+};
+
+#endif //HISTOGRAM_H
@@ -18,6 +18,12 @@ public:
         NET_UDP,
     };
 
+    // How a server moves bytes between its sockets and the kernel
+    enum class Transport {
+        NET_SYSCALL,    // one send/recv per call
+        NET_URING,      // io_uring, one batched submit per tick
+    };
+
     struct Address {
         uint32_t ip;
         uint16_t port;
@@ -26,7 +32,10 @@ public:
     static void init();
     static void shutdown();
     static bool parsePort(std::string_view str, uint16_t& out);
+    static bool parseAddress(const char* str, uint16_t port, Address& out);
 
+    // Blocking, see Resolver for the asynchronous version
+    static Result resolve(const char* hostname, uint16_t port, Address& out);
     static Address resolveAddress(const char* hostname, uint16_t port);
 };
 
@@ -40,8 +49,10 @@ public:
     static Net::Result listen(Socket sock, int backlog);
     static Net::Result close(Socket sock);
     static Net::Result accept(Socket sock, Socket* outSocket, Net::Address* outAddr);
-    static Net::Result read(Socket sock, void* buffer, int length);
-    static Net::Result send(Socket sock, const void* data, int length);
+    static Net::Result read(Socket sock, void* buffer, int length, int* outRead = nullptr);
+    static Net::Result send(Socket sock, const void* data, int length, int* outSent = nullptr);
+    static Net::Result sendTo(Socket sock, const void* data, int length, Net::Address addr);
+    static Net::Result readFrom(Socket sock, void* buffer, int length, int* outRead, Net::Address* outAddr);
     static Net::Result poll(const Socket* sockets, int count, int timeoutMs, bool* readable, bool* writable);
 };
 #endif //NET_H
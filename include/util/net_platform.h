@@ -0,0 +1,55 @@
+#ifndef NET_PLATFORM_H
+#define NET_PLATFORM_H
+
+// Platform socket headers and the few WinSock names the net code relies on.
+// Only include this from translation units, never from public headers.
+
+#if defined(PLATFORM_WINDOWS)
+#include <ws2tcpip.h>
+#include <winsock2.h>
+
+using NetSockLen = int;
+
+inline int NetLastError() {
+    return WSAGetLastError();
+}
+
+inline bool NetIsWouldBlock(int err) {
+    return err == WSAEWOULDBLOCK;
+}
+
+#define NET_SEND_FLAGS 0
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using SOCKET = int;
+using SOCKADDR = sockaddr;
+using SOCKADDR_IN = sockaddr_in;
+using TIMEVAL = timeval;
+using NetSockLen = socklen_t;
+
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define closesocket ::close
+
+inline int NetLastError() {
+    return errno;
+}
+
+inline bool NetIsWouldBlock(int err) {
+    return err == EWOULDBLOCK || err == EAGAIN || err == EINPROGRESS;
+}
+
+// never raise SIGPIPE on a peer that went away, report it as an error instead
+#define NET_SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+#endif //NET_PLATFORM_H
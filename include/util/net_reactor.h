@@ -0,0 +1,59 @@
+#ifndef NET_REACTOR_H
+#define NET_REACTOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include "util/net.h"
+
+/**
+ * Readiness based event loop for many sockets.
+ *
+ * Sockets are registered once together with a key, after that a single wait()
+ * per tick reports only the sockets that became readable or writable.
+ * On Linux this is backed by edge-triggered epoll: a readable event is only
+ * reported again after the socket has been drained until NET_WOULDBLOCK.
+ * Other platforms fall back to a single select() over all registered sockets.
+ */
+class NetReactor {
+public:
+    struct Event {
+        uint64_t key;
+        bool readable;
+        bool writable;
+        bool hangup;
+    };
+
+    explicit NetReactor(int maxEvents = 256);
+    ~NetReactor();
+
+    NetReactor(const NetReactor&) = delete;
+    NetReactor& operator=(const NetReactor&) = delete;
+
+    Net::Result add(Socket sock, uint64_t key);
+    Net::Result remove(Socket sock);
+
+    Net::Result wait(int timeoutMs, int* outCount);
+
+    // Getter / Setter
+    const Event* events() const {
+        return mEvents.data();
+    }
+
+    int size() const {
+        return static_cast<int>(mSockets.size());
+    }
+
+private:
+    struct Entry {
+        Socket sock;
+        uint64_t key;
+    };
+
+    std::vector<Entry> mSockets;
+    std::vector<Event> mEvents;
+
+    intptr_t mHandle = -1;
+};
+
+#endif //NET_REACTOR_H
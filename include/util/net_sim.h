@@ -0,0 +1,157 @@
+#ifndef NET_SIM_H
+#define NET_SIM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "util/net.h"
+
+// Bytes a simulated stream holds before send() reports NET_WOULDBLOCK, like a full socket buffer
+#define NETSIM_STREAM_QUEUE_BYTES (256 * 1024)
+// A bandwidth limited link drops datagrams once this much is waiting to go out, like a router queue
+#define NETSIM_MAX_QUEUE_MS 250.0
+// A lost stream segment shows up this late, the minimum TCP retransmission timeout on Linux
+#define NETSIM_STREAM_RTO_MS 200.0
+// Extra delay of a reordered datagram, so the ones after it overtake it
+#define NETSIM_REORDER_MIN_MS 10.0
+#define NETSIM_REORDER_MAX_MS 50.0
+#define NETSIM_DEFAULT_SEED 0x5eed
+
+// Network conditions of one direction of a connection
+struct NetSimProfile {
+    double latencyMs = 0;           // one way
+    double jitterMs = 0;            // uniform -jitter..+jitter on top of the latency
+    double lossPercent = 0;         // datagrams are dropped, stream segments come late by NETSIM_STREAM_RTO_MS
+    double duplicatePercent = 0;    // datagrams only
+    double reorderPercent = 0;      // datagrams only
+    uint32_t bandwidthKbps = 0;     // 0 for unlimited
+};
+
+struct NetSimLinkStats {
+    uint32_t id = 0;
+    bool stream = false;
+    Net::Address peer{};            // datagram links only
+    bool overridden = false;        // has its own profile
+    size_t queuedBytes = 0;
+    uint64_t sentBytes = 0;
+    uint64_t deliveredBytes = 0;
+    uint64_t dropped = 0;           // lost datagrams and lost stream segments (delayed, not dropped)
+    uint64_t duplicated = 0;
+    uint64_t reordered = 0;
+    uint64_t overflowed = 0;        // datagrams dropped by the bandwidth queue
+};
+
+/**
+ * Reproducible bad network between this process and its peers.
+ *
+ * While enabled, Socket::send / Socket::sendTo and DatagramChannel::flush hand their data to NetSim instead of
+ * the kernel. Every connection is a link with its own queue, bandwidth budget and random stream: data gets a
+ * release time from the link's profile and a pump thread hands it to the kernel once that time has come.
+ * Streams keep their byte order, so they only see latency, jitter, bandwidth and retransmission delays.
+ * Datagrams can also be lost, duplicated and reordered.
+ *
+ * Only outgoing data is simulated, delaying reads would starve the edge-triggered reactor. A server and client
+ * in the same process both go through it, so a local game sees the conditions in both directions. Each link
+ * draws from its own generator, the n-th link after the seed was set always gets the same one, so the same
+ * traffic gives the same decisions.
+ * The io_uring transport does not go through Socket and is not simulated.
+ */
+class NetSim {
+public:
+    static NetSim& get();
+
+    // cheap check for the socket calls, also true while queued data drains after disable()
+    static bool active() {
+        return sActive.load(std::memory_order_relaxed);
+    }
+
+    ~NetSim();
+
+    NetSim(const NetSim&) = delete;
+    NetSim& operator=(const NetSim&) = delete;
+
+    void enable(const NetSimProfile& profile);
+    void disable();
+    void setSeed(uint64_t seed);
+    bool setLinkProfile(uint32_t link, const NetSimProfile& profile);
+    bool clearLinkProfile(uint32_t link);
+
+    // Socket hooks, send and sendTo return false if the caller should hand the data to the kernel itself
+    bool send(Socket sock, const void* data, int length, int* outSent, Net::Result* outResult);
+    bool sendTo(Socket sock, const void* data, int length, Net::Address addr);
+    void forget(Socket sock);
+
+    // Getter / Setter
+    bool isEnabled() const;
+    NetSimProfile getProfile() const;
+    uint64_t getSeed() const;
+    std::vector<NetSimLinkStats> links() const;
+
+private:
+    NetSim() = default;
+
+    struct Packet {
+        double releaseMs;
+        std::vector<uint8_t> data;
+    };
+
+    struct Link {
+        uint32_t id = 0;
+        Socket sock{};
+        bool stream = false;
+        Net::Address peer{};
+
+        bool overridden = false;
+        NetSimProfile profile{};
+
+        uint64_t rng = 0;
+        double lastReleaseMs = 0;       // streams never release out of order
+        double busyUntilMs = 0;         // bandwidth, when the link is free again
+        size_t sentOffset = 0;          // bytes of the front stream packet the kernel already took
+
+        std::deque<Packet> queue;       // by release time
+        NetSimLinkStats stats{};
+    };
+
+    using LinkKey = std::pair<uintptr_t, uint64_t>;
+
+    static LinkKey keyOf(Socket sock, bool stream, Net::Address peer);
+    Link& linkFor(Socket sock, bool stream, Net::Address peer);
+    Link* takingLink(Socket sock, bool stream, Net::Address peer);
+    const NetSimProfile& profileOf(const Link& link) const;
+    double nextUniform(Link& link);
+    double releaseTime(Link& link, double nowMs, size_t bytes);
+    bool chance(Link& link, double percent);
+
+    void startPump();
+    void pump();
+    double deliver(double nowMs);
+
+    static double nowMs();
+    static uint64_t seedFor(uint64_t seed, uint32_t ordinal);
+
+    static std::atomic<bool> sActive;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mWake;
+    std::thread mPump;
+    bool mStopping = false;
+
+    bool mEnabled = false;
+    NetSimProfile mProfile{};
+    uint64_t mSeed = NETSIM_DEFAULT_SEED;
+    uint32_t mNextLink = 1;
+    uint32_t mSeededLinks = 0;      // links that drew a stream since the seed was set
+
+    // streams by (socket, 0), datagrams by (socket, peer address)
+    std::map<LinkKey, Link> mLinks;
+};
+
+#endif //NET_SIM_H
@@ -0,0 +1,115 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#define OBJECT_POOL_CHUNK 64
+
+struct PoolStats {
+    size_t live = 0;
+    size_t peak = 0;
+    size_t capacity = 0;
+    uint64_t acquired = 0;
+    uint64_t chunkAllocations = 0;
+
+    // for totals over many pools, peak then is the sum of the peaks
+    PoolStats& operator+=(const PoolStats& other) {
+        live += other.live;
+        peak += other.peak;
+        capacity += other.capacity;
+        acquired += other.acquired;
+        chunkAllocations += other.chunkAllocations;
+        return *this;
+    }
+};
+
+/**
+ * Free-list pool for objects that outlive a tick, like reliable messages waiting for their ack.
+ *
+ * Objects are carved from chunks of OBJECT_POOL_CHUNK and released ones are reused first, so once the pool
+ * has grown to the largest number alive at the same time it never allocates again. Pointers stay valid
+ * until released, chunks are only freed with the pool.
+ */
+template <typename T>
+class ObjectPool {
+public:
+    ObjectPool() = default;
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+    ObjectPool(ObjectPool&&) noexcept = default;
+    ObjectPool& operator=(ObjectPool&&) noexcept = default;
+
+    ~ObjectPool() {
+        // whatever is still out belongs to nobody anymore, the chunks take its memory with them
+        for (auto& chunk : mChunks) {
+            for (size_t i = 0; i < OBJECT_POOL_CHUNK; i++) {
+                if (chunk[i].alive) reinterpret_cast<T*>(chunk[i].storage)->~T();
+            }
+        }
+    }
+
+    template <typename... Args>
+    T* acquire(Args&&... args) {
+        if (!mFree) grow();
+
+        Slot* slot = mFree;
+        mFree = slot->next;
+        slot->alive = true;
+
+        mStats.live++;
+        mStats.acquired++;
+        if (mStats.live > mStats.peak) mStats.peak = mStats.live;
+
+        return new (slot->storage) T(std::forward<Args>(args)...);
+    }
+
+    void release(T* object) {
+        if (!object) return;
+        object->~T();
+
+        // storage is the first member, so the object address is the slot address
+        Slot* slot = reinterpret_cast<Slot*>(object);
+        slot->alive = false;
+        slot->next = mFree;
+        mFree = slot;
+
+        mStats.live--;
+    }
+
+    // Getter / Setter
+    const PoolStats& stats() const {
+        return mStats;
+    }
+
+private:
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+        Slot* next = nullptr;
+        bool alive = false;
+    };
+
+    void grow() {
+        mChunks.push_back(std::make_unique<Slot[]>(OBJECT_POOL_CHUNK));
+        Slot* chunk = mChunks.back().get();
+
+        for (size_t i = OBJECT_POOL_CHUNK; i-- > 0;) {
+            chunk[i].next = mFree;
+            mFree = &chunk[i];
+        }
+
+        mStats.capacity += OBJECT_POOL_CHUNK;
+        mStats.chunkAllocations++;
+    }
+
+    std::vector<std::unique_ptr<Slot[]>> mChunks;
+    Slot* mFree = nullptr;
+    PoolStats mStats;
+};
+
+#endif //OBJECT_POOL_H
@@ -0,0 +1,32 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "util/net.h"
+
+// How long a resolved hostname is reused before it is looked up again
+#define RESOLVER_CACHE_TTL_MS 60000
+#define RESOLVER_CACHE_MAX 64
+
+/**
+ * Hostname resolution that never blocks the caller.
+ *
+ * Numeric addresses are parsed in place and cached names are answered from memory. Everything else is
+ * looked up with getaddrinfo on a background thread, requests for the same name share one lookup.
+ * Callbacks always run on the thread that calls dispatch(), which is the main loop, so they can touch
+ * the managers like any other frame code.
+ */
+class Resolver {
+public:
+    using Callback = std::function<void(Net::Result result, Net::Address address)>;
+
+    static void resolve(const std::string& hostname, uint16_t port, Callback callback);
+    static void dispatch();
+
+    static void clearCache();
+};
+
+#endif //RESOLVER_H
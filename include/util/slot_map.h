@@ -0,0 +1,153 @@
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Generational slot map.
+ *
+ * Values live densely packed in one vector, so iterating all of them touches no holes. Every value also owns
+ * a slot whose index never changes while the value is alive; a handle is that index plus the slot's generation.
+ * Erasing bumps the generation, so a handle to an erased value never resolves to whatever reuses the slot.
+ * Free slots form a linked list, insert and erase are O(1).
+ *
+ * Erase moves the last value into the hole, so pointers into the map are only stable until the next erase.
+ * Pointers also survive inserts as long as the size stays within what was reserved.
+ */
+template <typename T>
+class SlotMap {
+public:
+    struct Handle {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+
+        bool valid() const {
+            return index != UINT32_MAX;
+        }
+
+        bool operator==(const Handle& other) const {
+            return index == other.index && generation == other.generation;
+        }
+    };
+
+    void reserve(size_t capacity) {
+        mValues.reserve(capacity);
+        mValueSlot.reserve(capacity);
+        mSlots.reserve(capacity);
+    }
+
+    Handle insert(T&& value) {
+        uint32_t index;
+        if (mFreeHead != UINT32_MAX) {
+            index = mFreeHead;
+            mFreeHead = mSlots[index].nextFree;
+        } else {
+            index = static_cast<uint32_t>(mSlots.size());
+            mSlots.push_back(Slot{});
+        }
+
+        Slot& slot = mSlots[index];
+        slot.dense = static_cast<uint32_t>(mValues.size());
+        slot.live = true;
+
+        mValues.push_back(std::move(value));
+        mValueSlot.push_back(index);
+
+        return Handle{index, slot.generation};
+    }
+
+    bool erase(Handle handle) {
+        if (!get(handle)) return false;
+
+        Slot& slot = mSlots[handle.index];
+        const uint32_t dense = slot.dense;
+        const uint32_t last = static_cast<uint32_t>(mValues.size() - 1);
+
+        if (dense != last) {
+            mValues[dense] = std::move(mValues[last]);
+            mValueSlot[dense] = mValueSlot[last];
+            mSlots[mValueSlot[dense]].dense = dense;
+        }
+        mValues.pop_back();
+        mValueSlot.pop_back();
+
+        slot.live = false;
+        slot.generation++;
+        slot.nextFree = mFreeHead;
+        mFreeHead = handle.index;
+        return true;
+    }
+
+    // nullptr if the handle is stale
+    T* get(Handle handle) {
+        if (handle.index >= mSlots.size()) return nullptr;
+
+        const Slot& slot = mSlots[handle.index];
+        if (!slot.live || slot.generation != handle.generation) return nullptr;
+        return &mValues[slot.dense];
+    }
+
+    // the value currently in a slot, whatever its generation
+    T* find(uint32_t index) {
+        if (index >= mSlots.size() || !mSlots[index].live) return nullptr;
+        return &mValues[mSlots[index].dense];
+    }
+
+    const T* find(uint32_t index) const {
+        if (index >= mSlots.size() || !mSlots[index].live) return nullptr;
+        return &mValues[mSlots[index].dense];
+    }
+
+    Handle handleOf(uint32_t index) const {
+        if (index >= mSlots.size() || !mSlots[index].live) return Handle{};
+        return Handle{index, mSlots[index].generation};
+    }
+
+    // index of the slot the next insert will use
+    uint32_t nextIndex() const {
+        return mFreeHead != UINT32_MAX ? mFreeHead : static_cast<uint32_t>(mSlots.size());
+    }
+
+    size_t size() const {
+        return mValues.size();
+    }
+
+    bool empty() const {
+        return mValues.empty();
+    }
+
+    // dense iteration over live values, in no particular order
+    typename std::vector<T>::iterator begin() {
+        return mValues.begin();
+    }
+
+    typename std::vector<T>::iterator end() {
+        return mValues.end();
+    }
+
+    typename std::vector<T>::const_iterator begin() const {
+        return mValues.begin();
+    }
+
+    typename std::vector<T>::const_iterator end() const {
+        return mValues.end();
+    }
+
+private:
+    struct Slot {
+        uint32_t dense{};
+        uint32_t generation{};
+        uint32_t nextFree = UINT32_MAX;
+        bool live = false;
+    };
+
+    std::vector<T> mValues;
+    std::vector<uint32_t> mValueSlot;   // dense position -> slot index
+    std::vector<Slot> mSlots;
+    uint32_t mFreeHead = UINT32_MAX;
+};
+
+#endif //SLOT_MAP_H
@@ -0,0 +1,62 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ *
+ * Capacity is rounded up to a power of two. Slots are reused, so moving a T in and out does not allocate
+ * as long as T itself does not.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity = 1024) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+
+        mSlots.resize(size);
+        mMask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // producer only
+    bool push(T&& value) {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head - mTail.load(std::memory_order_acquire) > mMask) return false; // full
+
+        mSlots[head & mMask] = std::move(value);
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only
+    bool pop(T& out) {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail == mHead.load(std::memory_order_acquire)) return false; // empty
+
+        out = std::move(mSlots[tail & mMask]);
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return mHead.load(std::memory_order_acquire) - mTail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> mSlots;
+    size_t mMask{};
+
+    // on separate cache lines so producer and consumer do not fight over one
+    alignas(64) std::atomic<size_t> mHead{0};
+    alignas(64) std::atomic<size_t> mTail{0};
+};
+
+#endif //SPSC_QUEUE_H
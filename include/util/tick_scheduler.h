@@ -0,0 +1,85 @@
+#ifndef TICK_SCHEDULER_H
+#define TICK_SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+
+// What happens to ticks that are due but could not run in time
+enum class TickPolicy : uint8_t {
+    TICK_CATCH_UP = 0,  // run them back to back, up to TICK_MAX_CATCH_UP per frame
+    TICK_DROP     = 1,  // run one and skip the rest
+};
+
+#define TICK_DEFAULT_RATE 30.0
+#define TICK_MIN_RATE 1.0
+#define TICK_MAX_RATE 1000.0
+#define TICK_MAX_CATCH_UP 5
+// The os sleep is trusted up to this much before the deadline, the rest is spun
+#define TICK_SPIN_MARGIN_MS 2.0
+
+/**
+ * Fixed timestep clock for a simulation loop.
+ *
+ * Elapsed time goes into an accumulator and every full tick interval in it is one due tick, so a rate like
+ * 30 Hz keeps its exact 33.333 ms average instead of drifting with rounded sleeps. wait() sleeps most of the
+ * way to the next deadline and spins the rest for sub-millisecond precision. collect() hands out the due
+ * ticks and applies the overrun policy when the loop fell behind.
+ */
+class TickScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TickScheduler(double rate = TICK_DEFAULT_RATE, TickPolicy policy = TickPolicy::TICK_CATCH_UP);
+
+    void reset();
+    void wait();
+    int collect();
+    double untilNextMs() const;
+
+    // Getter / Setter
+    void setRate(double rate);
+
+    double getRate() const {
+        return mRate;
+    }
+
+    double getTickMs() const {
+        return mTickMs;
+    }
+
+    void setPolicy(TickPolicy policy) {
+        mPolicy = policy;
+    }
+
+    TickPolicy getPolicy() const {
+        return mPolicy;
+    }
+
+    // simulated ticks so far, only ever grows
+    uint64_t getTick() const {
+        return mTick;
+    }
+
+    uint64_t getDropped() const {
+        return mDropped;
+    }
+
+    // ticks run back to back to catch up
+    uint64_t getCaughtUp() const {
+        return mCaughtUp;
+    }
+
+private:
+    double mRate{};
+    double mTickMs{};
+    TickPolicy mPolicy{};
+
+    Clock::time_point mLast{};
+    double mAccumulatorMs{};
+
+    uint64_t mTick{};
+    uint64_t mDropped{};
+    uint64_t mCaughtUp{};
+};
+
+#endif //TICK_SCHEDULER_H
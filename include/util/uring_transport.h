@@ -0,0 +1,139 @@
+#ifndef URING_TRANSPORT_H
+#define URING_TRANSPORT_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "util/net.h"
+
+struct io_uring;
+
+// How long drainSends() waits for the kernel before it cancels what is still in flight
+#define URING_DRAIN_TIMEOUT_MS 250.0
+
+/**
+ * Batched socket io on top of io_uring (Linux, needs liburing at build time).
+ *
+ * Sends are only queued during a tick. All of them go to the kernel with a single submit() at the end of the
+ * tick and their results are collected with reap(). Data lives in a fixed pool of buffers that are registered
+ * with the kernel once, so queuing never allocates and the kernel never has to map user pages per call.
+ *
+ * The kernel does not order unlinked requests, so every socket has at most one send in flight. Later sends
+ * of the same socket wait behind it and are queued from its completion, a short write resends its tail first.
+ *
+ * Receives work without readiness events: startReceive() keeps one read per socket in the kernel, reap()
+ * hands out what it got and the read goes back to the kernel with the next submit(), so one submit per tick
+ * carries every queued send and receive.
+ *
+ * When liburing is missing or the kernel refuses the ring, valid() is false and
+ * callers keep using the plain Socket calls.
+ */
+class UringTransport {
+public:
+    struct Completion {
+        Socket sock;
+        int result;             // bytes sent or received, negative errno if it failed. A receive of 0 is a hangup
+        bool receive;
+        uint64_t key;           // given to startReceive()
+        const uint8_t* data;    // received bytes, valid until the next submit()
+    };
+
+    explicit UringTransport(unsigned queueDepth = 1024, int bufferCount = 1024, int bufferSize = 4096,
+                            int receiveCount = 0);
+    ~UringTransport();
+
+    UringTransport(const UringTransport&) = delete;
+    UringTransport& operator=(const UringTransport&) = delete;
+
+    static bool available();
+
+    // Queue
+    uint8_t* prepareSend(Socket sock, int length);
+    bool startReceive(Socket sock, uint64_t key);
+
+    // Batch
+    int submit();
+    int reap(std::vector<Completion>& out);
+    void drainSends();
+    void closeSocket(Socket sock);
+
+    // Getter / Setter
+    bool valid() const {
+        return mRing != nullptr;
+    }
+
+    int bufferSize() const {
+        return mBufferSize;
+    }
+
+    uint64_t submitCalls() const {
+        return mSubmitCalls;
+    }
+
+    // true while sends of this socket are queued or in the kernel
+    bool sending(Socket sock) const;
+
+    // nothing left that needs a reap(), receives that wait for data aside
+    bool idle() const {
+        return mInflightSends == 0 && mClosingSockets == 0;
+    }
+
+private:
+    struct Slot {
+        Socket sock{};
+        uint64_t key{};         // receives only
+        int length{};
+        int offset{};
+        int next = -1;          // send of the same socket queued after this one
+        bool used = false;
+        bool receive = false;
+        bool inKernel = false;
+        bool detached = false;  // cancelled, only waits for its completion to free the buffer
+    };
+
+    // everything of one socket. head is the send in flight or about to be, the others wait behind it
+    struct Stream {
+        int head = -1;
+        int tail = -1;
+        int receive = -1;
+        int detached = 0;       // cancelled requests the kernel has not given back yet
+        bool closing = false;   // the socket is closed once the last of them came back
+    };
+
+    int acquireSlot();
+    void freeSlot(int slot);
+    void finishSend(int slot, bool failed);
+    void releaseDetached(int slot);
+    void cancelSlot(Stream& stream, int slot);
+    void cancelSends(Stream& stream);
+    bool queueSlot(int slot);
+    void queueReady();
+    void collect(std::vector<Completion>& out);
+    void waitOnce(double timeoutMs);
+
+    uint8_t* bufferOf(int slot) {
+        return mBuffers.data() + static_cast<size_t>(slot) * mBufferSize;
+    }
+
+    io_uring* mRing = nullptr;
+
+    std::vector<uint8_t> mBuffers;
+    std::vector<Slot> mSlots;           // sends first, then receives
+    std::vector<int> mFreeSlots;
+    std::vector<int> mFreeReceives;
+    std::vector<int> mReady;            // sends and receives that go to the kernel with the next submit()
+    std::vector<Completion> mDeferred;  // collected while draining, handed out by the next reap()
+
+    // by socket handle, entries stay until the socket is closed so steady traffic does not allocate
+    std::unordered_map<uintptr_t, Stream> mStreams;
+
+    int mBufferSize{};
+    int mPending{};
+    int mInflightSends{};   // send slots in use, waiting ones and detached ones included
+    int mClosingSockets{};
+
+    uint64_t mSubmitCalls{};
+};
+
+#endif //URING_TRANSPORT_H
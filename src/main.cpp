@@ -12,6 +12,7 @@
 #include "manager/console_manager.h"
 #include "manager/server_manager.h"
 #include "input/input.h"
+#include "util/resolver.h"
 #include "util/resource_loader.h"
 #include "sound_manager.h"
 
@@ -37,15 +38,24 @@ int main()
     SoundManager::init();
 
     ScreenManager screenManager{};
+    Player player{};
 
     // Main game loop
     while (!WindowShouldClose()) // Detect window close button or ESC key
     {
         InputManager::get()->process();
 
+        // finished hostname lookups from join_server / start_server
+        Resolver::dispatch();
+
+        // inputs of this frame leave with the client update right after
+        player.update(GetFrameTime());
+
         if (ClientManager::has()) {
             ClientManager::get().update();
-            //TODO call player update func
+
+            // kicked, or the server went away
+            if (ClientManager::get().mState == NetState::CLOSED) ClientManager::leave();
         }
 
         if (InputManager::get()->isPressed("dev_console")) {
@@ -62,7 +72,7 @@ int main()
         SoundManager::update();
 
         screenManager.update();
-        draw(&screenManager);
+        draw(&screenManager, &player);
         //----------------------------------------------------------------------------------
     }
 
@@ -79,7 +89,7 @@ void setup() {
     InputManager::get()->setContext("menu");
 }
 
-void draw(ScreenManager* screenManager) {
+void draw(ScreenManager* screenManager, Player* player) {
     BeginDrawing();
 
     ClearBackground(WHITE);
@@ -89,6 +99,13 @@ void draw(ScreenManager* screenManager) {
         if(ClientManager::get().mState == NetState::IDLE) DrawText("Type ip of server to conenct", 10, 50, 20, GREEN);
         else if(ClientManager::get().mState == NetState::CONNECTING) DrawText("Connecting to server...", 10, 50, 20, GREEN);
         else if(ClientManager::get().mState == NetState::READY) DrawText("Ready to play", 10, 50, 20, GREEN);
+
+        const SnapshotBuffer& remote = ClientManager::get().mRemotePlayers;
+        for (size_t i = 0; i < remote.size(); i++) {
+            DrawCircle(static_cast<int>(remote.renderX(i)), static_cast<int>(remote.renderY(i)), 8, BLUE);
+        }
+
+        player->draw();
     }
 
     if (ConsoleManager::has() && ConsoleManager::get().isOpen()) {
@@ -6,10 +6,10 @@
 
 std::optional<Server> ServerManager::mServer = std::nullopt;
 
-Server& ServerManager::create(const Net::Address& addr, int maxClients)
+Server& ServerManager::create(const Net::Address& addr, int maxClients, Net::Transport transport, int workers)
 {
     if (!mServer.has_value()) {
-        mServer.emplace(addr, maxClients);
+        mServer.emplace(addr, maxClients, transport, workers);
     }
 
     return *mServer;
@@ -0,0 +1,391 @@
+#include "network/channel_endpoint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "network/packets.h"
+#include "network/packet_dispatch.h"
+#include "util/histogram.h"
+
+static_assert(CHANNEL_MAX_MESSAGE_PAYLOAD >= PACKET_MAX_PAYLOAD, "channel messages must fit every packet");
+
+static constexpr int HEADER_SIZE = DATAGRAM_HEADER_SIZE + 8;
+static constexpr int MESSAGE_HEADER_SIZE = 6;
+
+static void writeU16(uint8_t* out, uint16_t v) {
+    out[0] = static_cast<uint8_t>((v >> 8) & 0xFF);
+    out[1] = static_cast<uint8_t>(v & 0xFF);
+}
+
+static uint16_t readU16(const uint8_t* in) {
+    return static_cast<uint16_t>((in[0] << 8) | in[1]);
+}
+
+ChannelEndpoint::ChannelEndpoint() {
+    mDelivered.reserve(64);
+    for (auto& pending : mPending) pending.reserve(64);
+}
+
+/**
+ *
+ * Queue a packet on a channel. Reliable messages stay queued until acked, unreliable ones leave with the next update()
+ *
+ * @param channel
+ * @param packet
+ * @return false if the payload is larger than CHANNEL_MAX_MESSAGE_PAYLOAD
+ */
+bool ChannelEndpoint::send(ChannelType channel, const IPacket& packet) {
+    static_assert(HEADER_SIZE + MESSAGE_HEADER_SIZE + CHANNEL_MAX_MESSAGE_PAYLOAD <= DATAGRAM_MAX_SIZE,
+                  "a channel message must fit into a single datagram");
+
+    mScratch.clear();
+    packet.serialize(mScratch);
+
+    if (mScratch.size() > CHANNEL_MAX_MESSAGE_PAYLOAD) return false;
+
+    const uint8_t ch = static_cast<uint8_t>(channel);
+
+    Pending* pending = mPendingPool.acquire();
+    pending->sequence = mMessageSequence[ch]++;
+    pending->type = packet.type();
+    pending->length = static_cast<uint16_t>(mScratch.size());
+    if (!mScratch.empty()) std::memcpy(pending->payload, mScratch.data(), mScratch.size());
+
+    mPending[ch].push_back(pending);
+    return true;
+}
+
+/**
+ *
+ * @return how long a reliable message waits for its ack before it is sent again
+ */
+double ChannelEndpoint::resendTimeoutMs() const {
+    if (!mHasRtt) return CHANNEL_MAX_RESEND_MS / 4.0;
+
+    const double timeout = mSmoothedRtt + 4.0 * mRttVariance;
+    return std::clamp(timeout, CHANNEL_MIN_RESEND_MS, CHANNEL_MAX_RESEND_MS);
+}
+
+void ChannelEndpoint::beginDatagram(uint8_t* buffer, uint16_t sender, uint32_t token) {
+    PacketIO::writeDatagramHeader(buffer, DatagramKind::DGRAM_CHANNEL, sender, token);
+
+    uint8_t* header = buffer + DATAGRAM_HEADER_SIZE;
+    writeU16(header, mLocalSequence);
+
+    // ack 0 means nothing received yet, sequence 0 is never used
+    writeU16(header + 2, mHasRemote ? mRemoteSequence : 0);
+    header[4] = static_cast<uint8_t>((mAckBits >> 24) & 0xFF);
+    header[5] = static_cast<uint8_t>((mAckBits >> 16) & 0xFF);
+    header[6] = static_cast<uint8_t>((mAckBits >> 8) & 0xFF);
+    header[7] = static_cast<uint8_t>(mAckBits & 0xFF);
+}
+
+/**
+ *
+ * Pack everything that is due into datagrams: new and timed out reliable messages first, then the
+ * unreliable ones. If nothing is due but an ack is owed (or the peer has not heard from us for a while)
+ * an empty datagram carries the acks
+ *
+ * @param nowMs
+ * @param out udp lane the datagrams are staged on
+ * @param to peer address
+ * @param sender our id on the wire
+ * @param token session token of the client end, see DATAGRAM_HEADER_SIZE
+ */
+void ChannelEndpoint::update(double nowMs, DatagramChannel& out, Net::Address to, uint16_t sender, uint32_t token) {
+    uint8_t* buffer = nullptr;
+    int length = 0;
+    int datagrams = 0;
+    SentRecord* record = nullptr;
+
+    auto open = [&]() {
+        if (mLocalSequence == 0) mLocalSequence = 1;
+
+        buffer = out.prepare(to);
+        beginDatagram(buffer, sender, token);
+        length = HEADER_SIZE;
+
+        record = &mSent[mLocalSequence % SENT_WINDOW];
+        record->sequence = mLocalSequence;
+        record->valid = true;
+        record->acked = false;
+        record->sentMs = nowMs;
+        record->messages.clear();
+    };
+
+    auto close = [&]() {
+        out.commit(length);
+        mBytesSent += static_cast<uint64_t>(length);
+        mLocalSequence++;
+        datagrams++;
+        buffer = nullptr;
+        mLastSendMs = nowMs;
+        mAckOwed = false;
+    };
+
+    auto append = [&](uint8_t channel, const Pending& message) -> bool {
+        const int need = MESSAGE_HEADER_SIZE + static_cast<int>(message.length);
+        if (buffer && length + need > DATAGRAM_MAX_SIZE) close();
+        if (!buffer) {
+            if (datagrams >= CHANNEL_MAX_DATAGRAMS_PER_UPDATE) return false;
+            open();
+        }
+
+        uint8_t* m = buffer + length;
+        m[0] = channel;
+        writeU16(m + 1, message.sequence);
+        m[3] = static_cast<uint8_t>(message.type);
+        writeU16(m + 4, message.length);
+        if (message.length > 0) std::memcpy(m + MESSAGE_HEADER_SIZE, message.payload, message.length);
+
+        length += need;
+        return true;
+    };
+
+    const double timeout = resendTimeoutMs();
+    bool full = false;
+
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT && !full; ch++) {
+        if (ch == static_cast<uint8_t>(ChannelType::CH_UNRELIABLE_SEQUENCED)) continue;
+
+        for (Pending* message : mPending[ch]) {
+            if (message->acked) continue;
+            if (message->lastSentMs >= 0.0 && nowMs - message->lastSentMs < timeout) continue;
+
+            if (!append(ch, *message)) {
+                full = true;
+                break;
+            }
+
+            if (message->lastSentMs >= 0.0) mResends++;
+            message->lastSentMs = nowMs;
+            record->messages.emplace_back(ch, message->sequence);
+        }
+    }
+
+    const uint8_t unreliable = static_cast<uint8_t>(ChannelType::CH_UNRELIABLE_SEQUENCED);
+    for (const Pending* message : mPending[unreliable]) {
+        if (full || !append(unreliable, *message)) break;
+    }
+    for (Pending* message : mPending[unreliable]) mPendingPool.release(message);
+    mPending[unreliable].clear();
+
+    if (buffer) {
+        close();
+        return;
+    }
+
+    if (datagrams == 0 && (mAckOwed || mLastSendMs < 0.0 || nowMs - mLastSendMs >= CHANNEL_HEARTBEAT_MS)) {
+        open();
+        close();
+    }
+}
+
+void ChannelEndpoint::markAcked(uint8_t channel, uint16_t messageSequence) {
+    std::vector<Pending*>& pending = mPending[channel];
+
+    for (Pending* message : pending) {
+        if (message->sequence == messageSequence) {
+            message->acked = true;
+            break;
+        }
+    }
+
+    size_t done = 0;
+    while (done < pending.size() && pending[done]->acked) {
+        mPendingPool.release(pending[done]);
+        done++;
+    }
+    if (done > 0) pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(done));
+}
+
+/**
+ *
+ * A datagram we sent was acked: take an rtt sample and release every reliable message it carried
+ *
+ * @param sequence
+ * @param nowMs
+ */
+void ChannelEndpoint::ackRecord(uint16_t sequence, double nowMs) {
+    SentRecord& record = mSent[sequence % SENT_WINDOW];
+    if (!record.valid || record.acked || record.sequence != sequence) return;
+
+    record.acked = true;
+
+    // RFC 6298 smoothing
+    const double sample = nowMs - record.sentMs;
+    if (!mHasRtt) {
+        mSmoothedRtt = sample;
+        mRttVariance = sample / 2.0;
+        mHasRtt = true;
+    } else {
+        mRttVariance = 0.75 * mRttVariance + 0.25 * std::fabs(mSmoothedRtt - sample);
+        mSmoothedRtt = 0.875 * mSmoothedRtt + 0.125 * sample;
+    }
+    if (mRttHistogram) mRttHistogram->record(static_cast<uint64_t>(std::max(sample, 0.0) * 1000.0));
+
+    for (const auto& [channel, messageSequence] : record.messages) {
+        markAcked(channel, messageSequence);
+    }
+}
+
+void ChannelEndpoint::emit(uint8_t channel, PacketType type, const uint8_t* payload, size_t length, Arena& arena) {
+    Delivered& delivered = mDelivered.emplace_back();
+    delivered.channel = static_cast<ChannelType>(channel);
+    delivered.type = type;
+    delivered.length = static_cast<uint16_t>(length);
+    delivered.payload = arena.copy(payload, length);
+}
+
+void ChannelEndpoint::deliver(uint8_t channel, uint16_t messageSequence, PacketType type, const uint8_t* payload, uint16_t length,
+                              Arena& arena) {
+    // no known packet is that long, and it would not fit a pooled buffer
+    if (length > CHANNEL_MAX_MESSAGE_PAYLOAD) return;
+
+    switch (static_cast<ChannelType>(channel)) {
+        case ChannelType::CH_RELIABLE_ORDERED: {
+            if (messageSequence == mNextOrdered) {
+                emit(channel, type, payload, length, arena);
+                mNextOrdered++;
+
+                // anything that was waiting on this one
+                for (Buffered* next = mOrderedBuffer[mNextOrdered % DEDUP_WINDOW];
+                     next && next->sequence == mNextOrdered;
+                     next = mOrderedBuffer[mNextOrdered % DEDUP_WINDOW]) {
+                    emit(channel, next->type, next->payload, next->length, arena);
+                    mOrderedBuffer[mNextOrdered % DEDUP_WINDOW] = nullptr;
+                    mBufferedPool.release(next);
+                    mNextOrdered++;
+                }
+                return;
+            }
+
+            // old duplicates are dropped, early arrivals wait for the gap to fill
+            if (!PacketCodec::sequence_greater(messageSequence, mNextOrdered)) return;
+            if (static_cast<uint16_t>(messageSequence - mNextOrdered) >= DEDUP_WINDOW) return;
+
+            Buffered*& slot = mOrderedBuffer[messageSequence % DEDUP_WINDOW];
+            if (slot) return; // duplicate of an early arrival
+
+            slot = mBufferedPool.acquire();
+            slot->sequence = messageSequence;
+            slot->type = type;
+            slot->length = length;
+            if (length > 0) std::memcpy(slot->payload, payload, length);
+            return;
+        }
+        case ChannelType::CH_RELIABLE_UNORDERED: {
+            int32_t& seen = mUnorderedSeen[messageSequence % DEDUP_WINDOW];
+            if (seen == messageSequence) return;
+
+            seen = messageSequence;
+            emit(channel, type, payload, length, arena);
+            return;
+        }
+        case ChannelType::CH_UNRELIABLE_SEQUENCED: {
+            if (mHasSequenced && !PacketCodec::sequence_greater(messageSequence, mLastSequenced)) return;
+
+            mLastSequenced = messageSequence;
+            mHasSequenced = true;
+            emit(channel, type, payload, length, arena);
+            return;
+        }
+    }
+}
+
+/**
+ *
+ * Handle a channel datagram from the peer: update what we have to ack, process the acks it carries and
+ * deliver its messages according to their channel
+ *
+ * @param data
+ * @param length
+ * @param nowMs
+ * @param arena delivered payloads are copied here, poll() them before it is reset
+ * @return false if this is not a valid channel datagram
+ */
+bool ChannelEndpoint::receive(const uint8_t* data, int length, double nowMs, Arena& arena) {
+    if (length < HEADER_SIZE) return false;
+    if (data[0] != static_cast<uint8_t>(DatagramKind::DGRAM_CHANNEL)) return false;
+
+    const uint8_t* header = data + DATAGRAM_HEADER_SIZE;
+    const uint16_t sequence = readU16(header);
+    const uint16_t ack = readU16(header + 2);
+    const uint32_t ackBits = (static_cast<uint32_t>(header[4]) << 24) |
+                             (static_cast<uint32_t>(header[5]) << 16) |
+                             (static_cast<uint32_t>(header[6]) << 8) |
+                             (static_cast<uint32_t>(header[7]));
+
+    if (sequence == 0) return false;
+
+    // Remote sequence and ack bits
+    if (!mHasRemote) {
+        mRemoteSequence = sequence;
+        mAckBits = 0;
+        mHasRemote = true;
+    } else if (PacketCodec::sequence_greater(sequence, mRemoteSequence)) {
+        const uint16_t distance = static_cast<uint16_t>(sequence - mRemoteSequence);
+        if (distance > 32) mAckBits = 0;
+        else if (distance == 32) mAckBits = 1u << 31;
+        else mAckBits = (mAckBits << distance) | (1u << (distance - 1));
+        mRemoteSequence = sequence;
+    } else {
+        const uint16_t distance = static_cast<uint16_t>(mRemoteSequence - sequence);
+        if (distance == 0 || distance > 32) return true; // duplicate or too old to ack
+        if (mAckBits & (1u << (distance - 1))) return true; // duplicate
+        mAckBits |= 1u << (distance - 1);
+    }
+
+    mAckOwed = true;
+
+    // Acks for what we sent
+    if (ack != 0) {
+        ackRecord(ack, nowMs);
+        for (uint16_t i = 0; i < 32; i++) {
+            if (ackBits & (1u << i)) ackRecord(static_cast<uint16_t>(ack - (i + 1)), nowMs);
+        }
+    }
+
+    // Messages
+    int off = HEADER_SIZE;
+    while (off + MESSAGE_HEADER_SIZE <= length) {
+        const uint8_t channel = data[off];
+        const uint16_t messageSequence = readU16(data + off + 1);
+        const PacketType type = static_cast<PacketType>(data[off + 3]);
+        const uint16_t payloadLen = readU16(data + off + 4);
+
+        if (off + MESSAGE_HEADER_SIZE + payloadLen > length) break; // truncated
+
+        if (channel < CHANNEL_COUNT) {
+            deliver(channel, messageSequence, type, data + off + MESSAGE_HEADER_SIZE, payloadLen, arena);
+        }
+
+        off += MESSAGE_HEADER_SIZE + payloadLen;
+    }
+
+    return true;
+}
+
+/**
+ *
+ * Take the next delivered packet, decoded into out. Messages of unknown types or with a malformed
+ * payload are skipped
+ *
+ * @param out
+ * @param outChannel the channel it arrived on
+ * @return false if nothing is waiting
+ */
+bool ChannelEndpoint::poll(AnyPacket& out, ChannelType& outChannel) {
+    while (mDeliveredHead < mDelivered.size()) {
+        const Delivered& delivered = mDelivered[mDeliveredHead++];
+        if (!PacketDispatch::decode(delivered.type, delivered.payload, delivered.length, out) || out.empty()) continue;
+
+        outChannel = delivered.channel;
+        return true;
+    }
+
+    mDelivered.clear();
+    mDeliveredHead = 0;
+    return false;
+}
@@ -1,9 +1,10 @@
 #include "network/client.h"
 
-#include "manager/client_manager.h"
+#include <chrono>
+
 #include "manager/console_manager.h"
 #include "network/packets.h"
-#include "network/packets/player_disconnect_packet.h"
+#include "network/packet_dispatch.h"
 #include "util/dev/console/console.h"
 
 /**
@@ -13,10 +14,15 @@
  * @param serverAddr
  *
  */
-Client::Client(const Net::Address& serverAddr) {
+Client::Client(const Net::Address& serverAddr) : mRemotePlayers(PLAYER_ID_MAX + 1) {
     mState = NetState::IDLE;
     mServerAddr = serverAddr;
     mServer = Socket::create(Net::Protocol::NET_TCP, false);
+    mChannel.setRttHistogram(&mNetStats.rttUs);
+
+    if (!mDatagram.open(Net::Address{0, 0})) {
+        ConsoleManager::get().log(WARNING, "Client: Failed to open udp socket, state updates are disabled");
+    }
 }
 
 void Client::connect() {
@@ -36,13 +42,182 @@ void Client::disconnect() {
     disconnectedPacket.id = -1;
     disconnectedPacket.announce = false;
 
-    PacketIO::sendPacket(mServer, disconnectedPacket);
+    // nobody is listening once the server closed the connection
+    if (mState != NetState::CLOSED) sendPacket(disconnectedPacket);
 
     Socket::close(mServer);
 }
 
 void Client::update() {
+    const auto start = std::chrono::steady_clock::now();
+    mNowMs = std::chrono::duration<double, std::milli>(start.time_since_epoch()).count();
+
     processNetwork();
+    if (mState == NetState::CLOSED) return;
+
+    processDatagrams();
+    mRemotePlayers.sample(mNowMs);
+
+    if (mState == NetState::READY && mDatagram.isOpen()) {
+        // also the heartbeat that tells the server our udp address
+        const uint64_t sent = mChannel.bytesSent();
+        mChannel.update(mNowMs, mDatagram, mServerAddr, static_cast<uint16_t>(mId), mUdpToken);
+        mNetStats.connection.bytesOut += mChannel.bytesSent() - sent;
+    }
+
+    mDatagram.flush();
+    mFrameArena.reset();
+
+    mNetStats.updateNs.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count()));
+    publishNetStats();
+}
+
+/**
+ *
+ * Refresh the rates every NET_STATS_PUBLISH_MS
+ *
+ */
+void Client::publishNetStats() {
+    if (mNetStatsPublishedMs >= 0.0 && mNowMs - mNetStatsPublishedMs < NET_STATS_PUBLISH_MS) return;
+
+    ConnectionStats& connection = mNetStats.connection;
+    connection.rttMs = mChannel.rttMs();
+
+    if (mNetStatsPublishedMs >= 0.0) {
+        mNetStats.rates = connection.ratesSince(mPublishedStats, (mNowMs - mNetStatsPublishedMs) / 1000.0);
+    }
+    mPublishedStats = connection;
+    mNetStatsPublishedMs = mNowMs;
+}
+
+void Client::resetNetStats() {
+    mNetStats.rttUs.reset();
+    mNetStats.updateNs.reset();
+}
+
+/**
+ *
+ * Frame a packet and send it on the tcp connection right away. Whatever the socket does not take is dropped
+ *
+ * @param packet
+ * @return NET_WOULDBLOCK if the socket only took part of it
+ */
+Net::Result Client::sendPacket(const IPacket& packet) {
+    mOut.clear();
+    if (!PacketIO::writePacket(mOut, packet)) return Net::Result::NET_ERROR;
+
+    const size_t framed = mOut.size();
+    const Net::Result res = PacketIO::flush(mServer, mOut);
+    const size_t sent = framed - mOut.size();
+    mOut.clear();
+
+    if (res == Net::Result::NET_OK) {
+        mNetStats.connection.countOut(packet.type(), sent);
+    } else {
+        mNetStats.connection.bytesOut += sent;
+        if (res == Net::Result::NET_WOULDBLOCK) mNetStats.connection.wouldBlock++;
+    }
+    return res;
+}
+
+/**
+ *
+ * Queue a packet on one of the udp message channels, it leaves with the next update()
+ *
+ * @param channel
+ * @param packet
+ * @return false if the packet is too large for a datagram
+ */
+bool Client::sendChannel(ChannelType channel, const IPacket& packet) {
+    if (!mChannel.send(channel, packet)) return false;
+
+    // the bytes are counted when the channel puts its datagrams out
+    mNetStats.connection.countOut(packet.type(), 0);
+    return true;
+}
+
+/**
+ *
+ * Queue a packet on the udp state lane, it leaves with the next update()
+ *
+ * @param packet
+ */
+void Client::sendDatagram(const IPacket& packet) {
+    if (mState != NetState::READY || !mDatagram.isOpen()) return;
+
+    uint8_t* out = mDatagram.prepare(mServerAddr);
+    int length = PacketIO::writeDatagram(out, DATAGRAM_MAX_SIZE, static_cast<uint16_t>(mId), mUdpToken,
+                                         ++mDatagramSequence, packet);
+    if (length <= 0) return;
+
+    mDatagram.commit(length);
+    mNetStats.connection.countOut(packet.type(), static_cast<size_t>(length));
+}
+
+/**
+ *
+ * Predict one input step and send it to the server together with the few before it
+ *
+ * @param buttons PlayerButton bits
+ */
+void Client::sendInput(uint8_t buttons) {
+    if (mState != NetState::READY) return;
+
+    const double nowMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    PlayerInputPacket input{};
+    input.sequence = mPrediction.apply(buttons, nowMs);
+    input.history = mPrediction.history(PLAYER_INPUT_REDUNDANCY, input.count);
+
+    sendDatagram(input);
+}
+
+/**
+ *
+ * Handle every datagram the server sent since the last frame
+ *
+ */
+void Client::processDatagrams() {
+    for (int count = mDatagram.receive(); count > 0; count = mDatagram.receive()) {
+        for (int i = 0; i < count; i++) {
+            const DatagramChannel::Datagram& d = mDatagram.received(i);
+            if (d.addr.ip != mServerAddr.ip || d.addr.port != mServerAddr.port) continue;
+
+            uint16_t sender{};
+            uint32_t token{};
+            if (!PacketIO::readDatagramHeader(d.data, d.length, sender, token) || token != mUdpToken) continue;
+            mNetStats.connection.bytesIn += static_cast<uint64_t>(d.length);
+
+            if (d.data[0] == static_cast<uint8_t>(DatagramKind::DGRAM_CHANNEL)) {
+                const double nowMs = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+                if (!mChannel.receive(d.data, d.length, nowMs, mFrameArena)) continue;
+
+                AnyPacket packet;
+                ChannelType channel{};
+                while (mChannel.poll(packet, channel)) {
+                    mNetStats.connection.countIn(packet.type(), 0);
+                    PacketDispatch::handleClient(packet, this);
+                    if (mState == NetState::CLOSED) return;
+                }
+                continue;
+            }
+
+            uint16_t sequence{};
+            AnyPacket packet;
+            if (PacketIO::readDatagram(d.data, d.length, sender, sequence, packet) != Net::Result::NET_OK) continue;
+            mNetStats.connection.countIn(packet.type(), 0);
+            if (packet.empty()) continue;
+
+            if (PlayerUpdatePacket* update = packet.get<PlayerUpdatePacket>()) {
+                update->sequence = sequence;
+            }
+
+            PacketDispatch::handleClient(packet, this);
+        }
+    }
 }
 
 /**
@@ -51,7 +226,7 @@ void Client::update() {
  *
  */
 void Client::processNetwork() {
-    if (mState == NetState::IDLE) {
+    if (mState == NetState::IDLE || mState == NetState::CLOSED) {
         return;
     }
 
@@ -62,30 +237,43 @@ void Client::processNetwork() {
         return;
     }
 
-    while (mReadable) {
-        Net::Result res = Socket::poll(&mServer, 1, 0, &mReadable, &mWritable);
+    AnyPacket packet;
+    while (true) {
+        // frames that are already buffered need no syscall
+        res = PacketIO::nextPacket(mIn, packet);
 
-        if (res != Net::Result::NET_OK) {
-                return;
+        if (res == Net::Result::NET_OK) {
+            mNetStats.connection.countIn(packet.type(), packet.wireBytes);
+            PacketDispatch::handleClient(packet, this);
+            if (mState == NetState::CLOSED) return;
+            continue;
+        }
+        if (res == Net::Result::NET_DISCONNECTED) {
+            // the stream can not be trusted past a frame that long
+            mState = NetState::CLOSED;
+            return;
+        }
+        if (res != Net::Result::NET_WOULDBLOCK) {
+            continue;
         }
 
         if (!mReadable) return;
 
-        std::unique_ptr<IPacket> pkt;
-        res = PacketIO::receivePacket(mServer, pkt);
+        // the socket is blocking, so only read once poll said there is something
+        res = PacketIO::fill(mServer, mIn);
 
         if (res == Net::Result::NET_DISCONNECTED) {
-            ClientManager::leave();
-            break;
+            mState = NetState::CLOSED;
+            return;
         }
         if (res != Net::Result::NET_OK) {
-            break;
-        }
-        if (!pkt) {
-            continue;
+            return;
         }
 
-        pkt->handleClient(this);
+        res = Socket::poll(&mServer, 1, 0, &mReadable, &mWritable);
+        if (res != Net::Result::NET_OK) {
+            return;
+        }
     }
 }
 
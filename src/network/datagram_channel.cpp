@@ -0,0 +1,184 @@
+#include "network/datagram_channel.h"
+
+#include <algorithm>
+
+#include "util/net_platform.h"
+#include "util/net_sim.h"
+
+DatagramChannel::DatagramChannel() {
+    mRecv.resize(DATAGRAM_BATCH);
+}
+
+DatagramChannel::~DatagramChannel() {
+    close();
+}
+
+/**
+ *
+ * Create and bind the non-blocking udp socket
+ *
+ * @param bindAddr port 0 lets the system pick one
+ * @return false if the socket could not be bound
+ */
+bool DatagramChannel::open(Net::Address bindAddr) {
+    close();
+
+    mSocket = Socket::create(Net::Protocol::NET_UDP, true);
+    if (mSocket.handle == 0) return false;
+
+    if (Socket::bind(mSocket, bindAddr) != Net::Result::NET_OK) {
+        Socket::close(mSocket);
+        mSocket = {};
+        return false;
+    }
+
+    mOpen = true;
+    return true;
+}
+
+void DatagramChannel::close() {
+    if (!mOpen) return;
+
+    Socket::close(mSocket);
+    mSocket = {};
+    mOpen = false;
+    mSendCount = 0;
+}
+
+/**
+ *
+ * Stage a datagram for this tick. Write at most DATAGRAM_MAX_SIZE bytes and call commit()
+ *
+ * @param to receiver
+ * @return buffer to write the datagram into
+ */
+uint8_t* DatagramChannel::prepare(Net::Address to) {
+    if (mSendCount == static_cast<int>(mSend.size())) {
+        mSend.emplace_back();
+    }
+
+    Datagram& d = mSend[mSendCount];
+    d.addr = to;
+    d.length = 0;
+    return d.data;
+}
+
+void DatagramChannel::commit(int length) {
+    mSend[mSendCount].length = length;
+    mSendCount++;
+}
+
+/**
+ *
+ * Send everything staged this tick. Datagrams the kernel does not take are dropped, this lane is unreliable
+ *
+ * @return number of datagrams sent
+ */
+int DatagramChannel::flush() {
+    if (!mOpen || mSendCount == 0) {
+        mSendCount = 0;
+        return 0;
+    }
+
+    int sent = 0;
+
+    if (NetSim::active()) {
+        // the batched call would go around the simulator
+        for (int i = 0; i < mSendCount; i++) {
+            const Datagram& d = mSend[i];
+            if (Socket::sendTo(mSocket, d.data, d.length, d.addr) != Net::Result::NET_OK) break;
+            sent++;
+        }
+        mSendCount = 0;
+        return sent;
+    }
+
+#if defined(PLATFORM_LINUX)
+    mmsghdr msgs[DATAGRAM_BATCH];
+    iovec iovs[DATAGRAM_BATCH];
+    sockaddr_in addrs[DATAGRAM_BATCH];
+
+    for (int base = 0; base < mSendCount; base += DATAGRAM_BATCH) {
+        const int count = std::min(DATAGRAM_BATCH, mSendCount - base);
+
+        for (int i = 0; i < count; i++) {
+            const Datagram& d = mSend[base + i];
+
+            addrs[i] = {};
+            addrs[i].sin_family = AF_INET;
+            addrs[i].sin_addr.s_addr = d.addr.ip;
+            addrs[i].sin_port = htons(d.addr.port);
+
+            iovs[i].iov_base = const_cast<uint8_t*>(d.data);
+            iovs[i].iov_len = static_cast<size_t>(d.length);
+
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int res = sendmmsg(static_cast<int>(mSocket.handle), msgs, count, MSG_NOSIGNAL);
+        if (res < 0) break;
+
+        sent += res;
+        if (res < count) break; // socket buffer full
+    }
+#else
+    for (int i = 0; i < mSendCount; i++) {
+        const Datagram& d = mSend[i];
+        if (Socket::sendTo(mSocket, d.data, d.length, d.addr) != Net::Result::NET_OK) break;
+        sent++;
+    }
+#endif
+
+    mSendCount = 0;
+    return sent;
+}
+
+/**
+ *
+ * Pull the next batch of waiting datagrams. Call again until it returns 0 to drain the socket
+ *
+ * @return number of datagrams available through received()
+ */
+int DatagramChannel::receive() {
+    if (!mOpen) return 0;
+
+#if defined(PLATFORM_LINUX)
+    mmsghdr msgs[DATAGRAM_BATCH];
+    iovec iovs[DATAGRAM_BATCH];
+    sockaddr_in addrs[DATAGRAM_BATCH];
+
+    for (int i = 0; i < DATAGRAM_BATCH; i++) {
+        iovs[i].iov_base = mRecv[i].data;
+        iovs[i].iov_len = DATAGRAM_MAX_SIZE;
+
+        msgs[i] = {};
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int res = recvmmsg(static_cast<int>(mSocket.handle), msgs, DATAGRAM_BATCH, MSG_DONTWAIT, nullptr);
+    if (res <= 0) return 0;
+
+    for (int i = 0; i < res; i++) {
+        mRecv[i].length = static_cast<int>(msgs[i].msg_len);
+        mRecv[i].addr.ip = addrs[i].sin_addr.s_addr;
+        mRecv[i].addr.port = ntohs(addrs[i].sin_port);
+    }
+
+    return res;
+#else
+    int count = 0;
+    while (count < DATAGRAM_BATCH) {
+        Datagram& d = mRecv[count];
+        if (Socket::readFrom(mSocket, d.data, DATAGRAM_MAX_SIZE, &d.length, &d.addr) != Net::Result::NET_OK) break;
+        count++;
+    }
+    return count;
+#endif
+}
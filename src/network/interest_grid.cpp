@@ -0,0 +1,261 @@
+#include "network/interest_grid.h"
+
+#include <algorithm>
+
+/**
+ *
+ * Make room for ids 0 up to maxEntities - 1. Drops every entity
+ *
+ * @param maxEntities
+ */
+void InterestGrid::resize(int maxEntities) {
+    mEntities.clear();
+    mEntities.resize(std::max(maxEntities, 0));
+    mBuckets.assign(INTEREST_BUCKETS, -1);
+
+    mWords = (mEntities.size() + 63) / 64;
+    mVisibleBits.assign(mEntities.size() * mWords, 0);
+
+    mDirty.clear();
+    mDirty.reserve(mEntities.size());
+    mEvents.clear();
+}
+
+/**
+ *
+ * Change the grid. Every entity is put into its new cell and checked again with the next update
+ *
+ * @param cellSize world units, at least 1
+ * @param range
+ * @param hysteresis
+ */
+void InterestGrid::configure(int32_t cellSize, int32_t range, int32_t hysteresis) {
+    mCellSize = std::max(cellSize, 1);
+    mRange = std::max(range, 0);
+    mHysteresis = std::max(hysteresis, 0);
+
+    std::fill(mBuckets.begin(), mBuckets.end(), -1);
+    for (int id = 0; id < static_cast<int>(mEntities.size()); id++) {
+        Entity& e = mEntities[id];
+        if (!e.active) continue;
+
+        e.bucket = -1;
+        e.cellX = cellOf(e.x);
+        e.cellY = cellOf(e.y);
+        link(id);
+        markDirty(id);
+    }
+}
+
+/**
+ *
+ * Move an entity, adding it the first time. It is checked against its neighbours with the next update
+ *
+ * @param id
+ * @param x
+ * @param y
+ */
+void InterestGrid::setPosition(int id, int32_t x, int32_t y) {
+    if (id < 0 || id >= static_cast<int>(mEntities.size())) return;
+    Entity& e = mEntities[id];
+
+    if (e.active && e.x == x && e.y == y) return;
+
+    e.x = x;
+    e.y = y;
+
+    const int32_t cellX = cellOf(x);
+    const int32_t cellY = cellOf(y);
+
+    if (!e.active) {
+        e.active = true;
+        e.cellX = cellX;
+        e.cellY = cellY;
+        link(id);
+    } else if (cellX != e.cellX || cellY != e.cellY) {
+        unlink(id);
+        e.cellX = cellX;
+        e.cellY = cellY;
+        link(id);
+    }
+
+    markDirty(id);
+}
+
+/**
+ *
+ * Take an entity out of the grid. Nobody gets a leave event for it, the caller announces the removal itself
+ *
+ * @param id
+ */
+void InterestGrid::remove(int id) {
+    if (!has(id)) return;
+    Entity& e = mEntities[id];
+
+    for (int other : e.visible) {
+        dropVisible(other, id);
+    }
+    for (int other : e.visible) {
+        mVisibleBits[static_cast<size_t>(id) * mWords + (other >> 6)] &= ~(uint64_t{1} << (other & 63));
+    }
+    e.visible.clear();
+
+    unlink(id);
+    e.active = false;
+    // a stale entry in mDirty is skipped by update()
+}
+
+/**
+ *
+ * Bring the visibility of every entity that moved up to date
+ *
+ * @return enter and leave events, valid until the next update
+ */
+const std::vector<InterestEvent>& InterestGrid::update() {
+    mEvents.clear();
+    mLastChecks = 0;
+    mLastDirty = 0;
+
+    const int64_t enter = static_cast<int64_t>(mRange) * mRange;
+    const int64_t leave = static_cast<int64_t>(mRange + mHysteresis) * (mRange + mHysteresis);
+    const int32_t reach = (mRange + mCellSize - 1) / mCellSize;
+
+    auto distance = [](const Entity& a, const Entity& b) {
+        const int64_t dx = static_cast<int64_t>(a.x) - b.x;
+        const int64_t dy = static_cast<int64_t>(a.y) - b.y;
+        return dx * dx + dy * dy;
+    };
+
+    for (const int id : mDirty) {
+        Entity& e = mEntities[id];
+        if (!e.dirty) continue;
+        e.dirty = false;
+        if (!e.active) continue;
+        mLastDirty++;
+
+        // whoever drifted too far is dropped
+        for (size_t i = 0; i < e.visible.size();) {
+            const int other = e.visible[i];
+            mLastChecks++;
+
+            if (distance(e, mEntities[other]) <= leave) {
+                i++;
+                continue;
+            }
+
+            setVisible(id, other, false);
+            mEvents.push_back({id, other, false});
+            mEvents.push_back({other, id, false});
+        }
+
+        // neighbours in the surrounding cells that came close enough are added
+        const Entity* entities = mEntities.data();
+        const int* buckets = mBuckets.data();
+        const uint64_t* seen = mVisibleBits.data() + static_cast<size_t>(id) * mWords;
+        uint64_t checks = 0;
+
+        for (int32_t cy = e.cellY - reach; cy <= e.cellY + reach; cy++) {
+            for (int32_t cx = e.cellX - reach; cx <= e.cellX + reach; cx++) {
+                for (int other = buckets[bucketOf(cx, cy)]; other != -1; other = entities[other].next) {
+                    const Entity& o = entities[other];
+                    if (o.cellX != cx || o.cellY != cy || other == id) continue;
+                    if ((seen[other >> 6] >> (other & 63)) & 1) continue;
+                    checks++;
+
+                    if (distance(e, o) > enter) continue;
+
+                    setVisible(id, other, true);
+                    mEvents.push_back({id, other, true});
+                    mEvents.push_back({other, id, true});
+                }
+            }
+        }
+        mLastChecks += checks;
+    }
+    mDirty.clear();
+
+    mLastEnters = 0;
+    for (const InterestEvent& event : mEvents) {
+        if (event.enter) mLastEnters++;
+    }
+    mLastLeaves = mEvents.size() - mLastEnters;
+
+    return mEvents;
+}
+
+InterestStats InterestGrid::stats() const {
+    InterestStats stats{};
+    for (const Entity& e : mEntities) {
+        if (!e.active) continue;
+        stats.entities++;
+        stats.visiblePairs += e.visible.size();
+    }
+
+    stats.dirty = mLastDirty;
+    stats.pairChecks = mLastChecks;
+    stats.enters = mLastEnters;
+    stats.leaves = mLastLeaves;
+    return stats;
+}
+
+int32_t InterestGrid::cellOf(int32_t v) const {
+    // rounds towards negative infinity, so cell 0 is not twice as large as the others
+    return v >= 0 ? v / mCellSize : -((-v + mCellSize - 1) / mCellSize);
+}
+
+size_t InterestGrid::bucketOf(int32_t cellX, int32_t cellY) const {
+    const uint32_t h = static_cast<uint32_t>(cellX) * 73856093u ^ static_cast<uint32_t>(cellY) * 19349663u;
+    return h & (INTEREST_BUCKETS - 1);
+}
+
+void InterestGrid::link(int id) {
+    Entity& e = mEntities[id];
+    e.bucket = static_cast<int>(bucketOf(e.cellX, e.cellY));
+    e.prev = -1;
+    e.next = mBuckets[e.bucket];
+    if (e.next != -1) mEntities[e.next].prev = id;
+    mBuckets[e.bucket] = id;
+}
+
+void InterestGrid::unlink(int id) {
+    Entity& e = mEntities[id];
+    if (e.bucket == -1) return;
+
+    if (e.prev != -1) mEntities[e.prev].next = e.next;
+    else mBuckets[e.bucket] = e.next;
+    if (e.next != -1) mEntities[e.next].prev = e.prev;
+
+    e.bucket = e.prev = e.next = -1;
+}
+
+void InterestGrid::markDirty(int id) {
+    Entity& e = mEntities[id];
+    if (e.dirty) return;
+    e.dirty = true;
+    mDirty.push_back(id);
+}
+
+// visibility is kept symmetric, both sides change together
+void InterestGrid::setVisible(int a, int b, bool visible) {
+    if (visible) {
+        mVisibleBits[static_cast<size_t>(a) * mWords + (b >> 6)] |= uint64_t{1} << (b & 63);
+        mVisibleBits[static_cast<size_t>(b) * mWords + (a >> 6)] |= uint64_t{1} << (a & 63);
+        mEntities[a].visible.push_back(b);
+        mEntities[b].visible.push_back(a);
+        return;
+    }
+
+    dropVisible(a, b);
+    dropVisible(b, a);
+}
+
+void InterestGrid::dropVisible(int viewer, int subject) {
+    mVisibleBits[static_cast<size_t>(viewer) * mWords + (subject >> 6)] &= ~(uint64_t{1} << (subject & 63));
+
+    // order does not matter, swap with the last one
+    std::vector<int>& visible = mEntities[viewer].visible;
+    const auto it = std::find(visible.begin(), visible.end(), subject);
+    if (it == visible.end()) return;
+    *it = visible.back();
+    visible.pop_back();
+}
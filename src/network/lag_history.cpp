@@ -0,0 +1,169 @@
+#include "network/lag_history.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ *
+ * Allocate LAG_HISTORY_MS of frames at a tick rate. Drops everything recorded so far
+ *
+ * @param maxPlayers
+ * @param tickRate
+ */
+void LagHistory::resize(int maxPlayers, double tickRate) {
+    mTickRate = tickRate;
+    mPlayers = static_cast<size_t>(std::max(maxPlayers, 0));
+    mWords = (mPlayers + 63) / 64;
+    mFrames = std::clamp<size_t>(static_cast<size_t>(std::ceil(LAG_HISTORY_MS * tickRate / 1000.0)) + 1,
+                                 2, LAG_HISTORY_MAX_FRAMES);
+
+    mTicks.assign(mFrames, 0);
+    mPresent.assign(mFrames * mWords, 0);
+    mX.assign(mFrames * mPlayers, 0);
+    mY.assign(mFrames * mPlayers, 0);
+
+    mFirst = 0;
+    mNewest = 0;
+    mEmpty = true;
+}
+
+/**
+ *
+ * Start the frame of a tick, replacing the oldest one
+ *
+ * @param tick must be newer than the last one
+ */
+void LagHistory::beginTick(uint64_t tick) {
+    if (mFrames == 0) return;
+
+    if (mEmpty) {
+        mFirst = tick;
+        mEmpty = false;
+    }
+    mNewest = tick;
+
+    const size_t row = rowOf(tick);
+    mTicks[row] = tick;
+    std::fill_n(mPresent.begin() + static_cast<std::ptrdiff_t>(row * mWords), mWords, 0);
+}
+
+void LagHistory::record(int id, int32_t x, int32_t y) {
+    if (mEmpty || id < 0 || static_cast<size_t>(id) >= mPlayers) return;
+
+    const size_t row = rowOf(mNewest);
+    mPresent[row * mWords + (id >> 6)] |= uint64_t{1} << (id & 63);
+    mX[row * mPlayers + id] = x;
+    mY[row * mPlayers + id] = y;
+}
+
+uint64_t LagHistory::getOldestTick() const {
+    if (mEmpty) return 0;
+    return mNewest - mFirst + 1 > mFrames ? mNewest - (mFrames - 1) : mFirst;
+}
+
+bool LagHistory::covers(double tick) const {
+    return !mEmpty && tick >= static_cast<double>(getOldestTick()) && tick <= static_cast<double>(mNewest);
+}
+
+/**
+ *
+ * Where a player was at a tick, interpolated between the frames around it
+ *
+ * @param id
+ * @param tick may be fractional, must be within the history
+ * @param outX
+ * @param outY
+ * @return false if the tick is not kept or the player was not there
+ */
+bool LagHistory::positionAt(int id, double tick, int32_t& outX, int32_t& outY) const {
+    if (!covers(tick) || id < 0 || static_cast<size_t>(id) >= mPlayers) return false;
+
+    const uint64_t base = static_cast<uint64_t>(tick);
+    const size_t row = rowOf(base);
+    if (!present(row, id)) return false;
+
+    lerp(row, tick - static_cast<double>(base), id, outX, outY);
+    return true;
+}
+
+/**
+ *
+ * Every player that was within radius of a point at a tick, the rewound version of a hit test
+ *
+ * @param tick may be fractional, must be within the history
+ * @param x
+ * @param y
+ * @param radius
+ * @param out cleared first
+ * @param exceptId usually the player asking
+ * @return number of players found
+ */
+size_t LagHistory::queryRadius(double tick, int32_t x, int32_t y, int32_t radius, std::vector<int>& out, int exceptId) const {
+    out.clear();
+    if (!covers(tick)) return 0;
+
+    const uint64_t base = static_cast<uint64_t>(tick);
+    const double fraction = tick - static_cast<double>(base);
+    const size_t row = rowOf(base);
+    const int64_t limit = static_cast<int64_t>(radius) * radius;
+
+    // walk the set bits of the frame, players that were not there cost nothing
+    for (size_t w = 0; w < mWords; w++) {
+        uint64_t bits = mPresent[row * mWords + w];
+        while (bits) {
+            const int id = static_cast<int>(w * 64 + static_cast<size_t>(__builtin_ctzll(bits)));
+            bits &= bits - 1;
+            if (id == exceptId) continue;
+
+            int32_t px;
+            int32_t py;
+            lerp(row, fraction, id, px, py);
+
+            const int64_t dx = static_cast<int64_t>(px) - x;
+            const int64_t dy = static_cast<int64_t>(py) - y;
+            if (dx * dx + dy * dy <= limit) out.push_back(id);
+        }
+    }
+    return out.size();
+}
+
+LagHistoryStats LagHistory::stats() const {
+    LagHistoryStats stats{};
+    stats.frames = mFrames;
+    stats.maxPlayers = mPlayers;
+    stats.spanMs = mTickRate > 0 ? (mFrames - 1) * 1000.0 / mTickRate : 0;
+    stats.bytes = mTicks.size() * sizeof(uint64_t) + mPresent.size() * sizeof(uint64_t) +
+                  (mX.size() + mY.size()) * sizeof(int32_t);
+
+    // x and y plus one presence bit for every tick of a second
+    stats.bytesPerPlayerSecond = mTickRate * (2 * sizeof(int32_t) + 1.0 / 8.0);
+
+    stats.oldestTick = getOldestTick();
+    stats.newestTick = mNewest;
+
+    if (!mEmpty) {
+        const size_t row = rowOf(mNewest);
+        for (size_t w = 0; w < mWords; w++) {
+            stats.recorded += static_cast<size_t>(__builtin_popcountll(mPresent[row * mWords + w]));
+        }
+    }
+    return stats;
+}
+
+// position at row's tick + fraction, the next frame only counts if the player is in it
+void LagHistory::lerp(size_t row, double fraction, int id, int32_t& outX, int32_t& outY) const {
+    const int32_t x0 = mX[row * mPlayers + id];
+    const int32_t y0 = mY[row * mPlayers + id];
+
+    const size_t next = rowOf(mTicks[row] + 1);
+    if (fraction <= 0.0 || mTicks[row] == mNewest || !present(next, id)) {
+        outX = x0;
+        outY = y0;
+        return;
+    }
+
+    const int32_t x1 = mX[next * mPlayers + id];
+    const int32_t y1 = mY[next * mPlayers + id];
+    outX = x0 + static_cast<int32_t>(std::lround((x1 - x0) * fraction));
+    outY = y0 + static_cast<int32_t>(std::lround((y1 - y0) * fraction));
+}
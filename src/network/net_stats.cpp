@@ -0,0 +1,70 @@
+#include "network/net_stats.h"
+
+#include "network/packets.h"
+
+static_assert(static_cast<size_t>(PacketType::PCK_PLAYER_INPUT) < NET_STATS_PACKET_TYPES,
+              "NET_STATS_PACKET_TYPES must cover every PacketType");
+
+uint64_t ConnectionStats::totalPacketsIn() const {
+    uint64_t total = 0;
+    for (uint64_t count : packetsIn) total += count;
+    return total;
+}
+
+uint64_t ConnectionStats::totalPacketsOut() const {
+    uint64_t total = 0;
+    for (uint64_t count : packetsOut) total += count;
+    return total;
+}
+
+/**
+ *
+ * Sum up connections. Queue depths add up, the rtt becomes the highest one
+ *
+ * @param other
+ */
+void ConnectionStats::add(const ConnectionStats& other) {
+    bytesIn += other.bytesIn;
+    bytesOut += other.bytesOut;
+    for (size_t i = 0; i < NET_STATS_PACKET_TYPES; i++) {
+        packetsIn[i] += other.packetsIn[i];
+        packetsOut[i] += other.packetsOut[i];
+    }
+    wouldBlock += other.wouldBlock;
+    queueDepth += other.queueDepth;
+    rttMs = std::max(rttMs, other.rttMs);
+}
+
+ConnectionRates ConnectionStats::ratesSince(const ConnectionStats& before, double seconds) const {
+    if (seconds <= 0) return {};
+
+    ConnectionRates rates;
+    rates.bytesIn = static_cast<double>(bytesIn - before.bytesIn) / seconds;
+    rates.bytesOut = static_cast<double>(bytesOut - before.bytesOut) / seconds;
+    rates.packetsIn = static_cast<double>(totalPacketsIn() - before.totalPacketsIn()) / seconds;
+    rates.packetsOut = static_cast<double>(totalPacketsOut() - before.totalPacketsOut()) / seconds;
+    return rates;
+}
+
+const char* packetTypeName(size_t type) {
+    switch (static_cast<PacketType>(type)) {
+        case PacketType::PCK_NOTHING: return "unknown";
+        case PacketType::PCK_CONNECT: return "connect";
+        case PacketType::PCK_JOIN: return "join";
+        case PacketType::PCK_DISCONNECT: return "disconnect";
+        case PacketType::PCK_PLAYER_UPDATE: return "player_update";
+        case PacketType::PCK_PLAYER_INPUT: return "player_input";
+    }
+    return "?";
+}
+
+const char* tickPhaseName(TickPhase phase) {
+    switch (phase) {
+        case TickPhase::PHASE_POLL: return "poll";
+        case TickPhase::PHASE_RECEIVE: return "receive";
+        case TickPhase::PHASE_SIMULATE: return "simulate";
+        case TickPhase::PHASE_FLUSH: return "flush";
+        case TickPhase::PHASE_TICK: return "tick";
+    }
+    return "?";
+}
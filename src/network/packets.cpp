@@ -2,94 +2,279 @@
 
 #include <cstring>
 
-// -------------------- PacketRegistry implementation --------------------
+#include "network/packet_dispatch.h"
 
-static std::unordered_map<PacketType, PacketRegistry::Factory>& getRegistryMap() {
-    static std::unordered_map<PacketType, PacketRegistry::Factory> map;
-    return map;
-}
+// -------------------- PacketIO raw --------------------
 
-void PacketRegistry::registerFactory(PacketType type, Factory factory) {
-    getRegistryMap()[type] = std::move(factory);
+Net::Result PacketIO::send(Socket socket, const void* buffer, int bufferSize, int* outSent) {
+    return Socket::send(socket, buffer, bufferSize, outSent);
 }
 
-std::unique_ptr<IPacket> PacketRegistry::create(PacketType type) {
-    auto& map = getRegistryMap();
-    auto it = map.find(type);
-    if (it == map.end()) return nullptr;
-    return (it->second)();
+Net::Result PacketIO::receive(Socket socket, void* outBuffer, int bufferCapacity, int* outRead) {
+    return Socket::read(socket, outBuffer, bufferCapacity, outRead);
 }
 
-// -------------------- PacketIO raw --------------------
+// -------------------- PacketIO framed --------------------
 
-Net::Result PacketIO::send(Socket socket, const void* buffer, int bufferSize) {
-    return Socket::send(socket, buffer, bufferSize);
-}
+/**
+ *
+ * Append a framed packet to a connection buffer. The header is reserved in place, the payload is
+ * serialized right behind it and the length is patched in afterwards, so nothing is allocated
+ * once the buffer has grown to its working size
+ *
+ * @param out connection buffer, may already hold other frames
+ * @param packet
+ * @return false if the payload does not fit the u16 length, out is left untouched
+ */
+bool PacketIO::writePacket(std::vector<uint8_t>& out, const IPacket& packet) {
+    const size_t start = out.size();
+
+    out.resize(start + 3);
+    out[start] = static_cast<uint8_t>(packet.type());
+
+    packet.serialize(out);
 
-Net::Result PacketIO::receive(Socket socket, void* outBuffer, int bufferCapacity) {
-    return Socket::read(socket, outBuffer, bufferCapacity);
+    const size_t payloadSize = out.size() - start - 3;
+    if (payloadSize > 0xFFFFu) {
+        out.resize(start);
+        return false;
+    }
+
+    // payloadLen u16 big-endian
+    const uint16_t len = static_cast<uint16_t>(payloadSize);
+    out[start + 1] = static_cast<uint8_t>((len >> 8) & 0xFF);
+    out[start + 2] = static_cast<uint8_t>(len & 0xFF);
+
+    return true;
 }
 
-// -------------------- PacketIO framed --------------------
+/**
+ *
+ * Send as much of a connection buffer as the socket takes with one send. Whatever did not fit stays
+ * at the front of the buffer so frames are never split or interleaved
+ *
+ * @param socket
+ * @param out connection buffer
+ * @return NET_WOULDBLOCK if bytes are left over
+ */
+Net::Result PacketIO::flush(Socket socket, std::vector<uint8_t>& out) {
+    if (out.empty()) return Net::Result::NET_OK;
+
+    int sent = 0;
+    Net::Result res = PacketIO::send(socket, out.data(), static_cast<int>(out.size()), &sent);
+
+    if (sent > 0) out.erase(out.begin(), out.begin() + sent);
+    if (res == Net::Result::NET_OK && !out.empty()) return Net::Result::NET_WOULDBLOCK;
 
+    return res;
+}
+
+/**
+ *
+ * Frame and send a single packet with one send. Used where there is no connection buffer
+ *
+ * @param socket
+ * @param packet
+ * @return the NetResult
+ */
 Net::Result PacketIO::sendPacket(Socket socket, const IPacket& packet) {
-    std::vector<uint8_t> payload;
-    payload.reserve(64);
-    packet.serialize(payload);
+    thread_local std::vector<uint8_t> frame;
+    frame.clear();
 
-    if (payload.size() > 0xFFFFu) {
+    if (!writePacket(frame, packet)) {
         return Net::Result::NET_ERROR;
     }
 
-    uint8_t header[3]{};
-    header[0] = static_cast<uint8_t>(packet.type());
+    Net::Result res = PacketIO::flush(socket, frame);
+    frame.clear();
+    return res;
+}
 
-    // payloadLen u16 big-endian
-    const uint16_t len = static_cast<uint16_t>(payload.size());
-    header[1] = static_cast<uint8_t>((len >> 8) & 0xFF);
-    header[2] = static_cast<uint8_t>(len & 0xFF);
+/**
+ *
+ * Read as much as the stream buffer has room for with a single recv
+ *
+ * @param socket
+ * @param in
+ * @return NET_OK if bytes were read, NET_WOULDBLOCK once the socket is drained
+ */
+Net::Result PacketIO::fill(Socket socket, StreamBuffer& in) {
+    if (in.writable() == 0) in.compact();
+    if (in.writable() == 0) in.reserve(in.capacity() * 2);
 
-    Net::Result res = PacketIO::send(socket, header, 3);
+    int read = 0;
+    Net::Result res = PacketIO::receive(socket, in.writePtr(), static_cast<int>(in.writable()), &read);
     if (res != Net::Result::NET_OK) return res;
 
-    if (!payload.empty()) {
-        res = PacketIO::send(socket, payload.data(), static_cast<int>(payload.size()));
-        if (res != Net::Result::NET_OK) return res;
-    }
-
+    in.commit(static_cast<size_t>(read));
     return Net::Result::NET_OK;
 }
 
-Net::Result PacketIO::receivePacket(Socket socket, std::unique_ptr<IPacket>& outPacket) {
+/**
+ *
+ * Cut the next complete frame out of the stream buffer. The payload is decoded in place into outPacket
+ *
+ * @param in
+ * @param outPacket left empty for unknown packet types, they are skipped thanks to the length prefix
+ * @return NET_WOULDBLOCK if no complete frame is buffered, NET_DISCONNECTED for a length over PACKET_MAX_PAYLOAD
+ */
+Net::Result PacketIO::nextPacket(StreamBuffer& in, AnyPacket& outPacket) {
     outPacket.reset();
 
-    uint8_t header[3]{};
-    Net::Result res = PacketIO::receive(socket, header, 3);
-    if (res != Net::Result::NET_OK) return res;
+    if (in.readable() < 3) return Net::Result::NET_WOULDBLOCK;
 
+    const uint8_t* header = in.readPtr();
     const PacketType type = static_cast<PacketType>(header[0]);
     const uint16_t payloadLen = (static_cast<uint16_t>(header[1]) << 8) |
                                 (static_cast<uint16_t>(header[2]));
 
-    std::vector<uint8_t> payload(payloadLen);
-    if (payloadLen > 0) {
-        res = PacketIO::receive(socket, payload.data(), payloadLen);
-        if (res != Net::Result::NET_OK) return res;
+    // no packet is that long, the peer is broken or hostile and must not make us buffer 64 KiB for it
+    if (payloadLen > PACKET_MAX_PAYLOAD) return Net::Result::NET_DISCONNECTED;
+
+    const size_t frameSize = 3 + static_cast<size_t>(payloadLen);
+    if (in.readable() < frameSize) {
+        // half received, make sure the rest will fit
+        in.reserve(frameSize);
+        return Net::Result::NET_WOULDBLOCK;
     }
 
-    std::unique_ptr<IPacket> pkt = PacketRegistry::create(type);
+    const bool ok = PacketDispatch::decode(type, in.readPtr() + 3, payloadLen, outPacket);
+    outPacket.wireBytes = static_cast<uint16_t>(frameSize);
+    in.consume(frameSize);
 
-    if (!pkt) {
-        // Unknown packet type: safely ignored because we had a length prefix.
-        return Net::Result::NET_OK;
-    }
+    return ok ? Net::Result::NET_OK : Net::Result::NET_ERROR;
+}
 
-    if (!pkt->deserialize(payload.data(), payload.size())) {
-        return Net::Result::NET_ERROR;
-    }
+/**
+ *
+ * Get the next packet, reading from the socket only when no complete frame is buffered.
+ * Does at most one recv, so it is safe on a blocking socket that was polled as readable
+ *
+ * @param socket
+ * @param in
+ * @param outPacket stays empty if a read did not complete a frame yet, call again
+ * @return NET_WOULDBLOCK once the socket is drained and nothing complete is buffered, NET_ERROR if a malformed
+ *         frame was skipped, NET_DISCONNECTED if the peer closed or the socket failed
+ */
+Net::Result PacketIO::receivePacket(Socket socket, StreamBuffer& in, AnyPacket& outPacket) {
+    Net::Result res = nextPacket(in, outPacket);
+    if (res != Net::Result::NET_WOULDBLOCK) return res;
 
-    outPacket = std::move(pkt);
-    return Net::Result::NET_OK;
+    res = fill(socket, in);
+    // a socket that fails to read will not recover, callers drop it like a closed one
+    if (res == Net::Result::NET_ERROR) return Net::Result::NET_DISCONNECTED;
+    if (res != Net::Result::NET_OK) return res;
+
+    res = nextPacket(in, outPacket);
+    if (res == Net::Result::NET_WOULDBLOCK) return Net::Result::NET_OK;
+
+    return res;
+}
+
+// -------------------- PacketIO datagrams --------------------
+
+/**
+ *
+ * Write the header every datagram starts with
+ *
+ * @param out at least DATAGRAM_HEADER_SIZE bytes
+ * @param kind
+ * @param sender client id, DATAGRAM_SENDER_SERVER for the server
+ * @param token session token of the client on the other end, or of the sending client
+ */
+void PacketIO::writeDatagramHeader(uint8_t* out, DatagramKind kind, uint16_t sender, uint32_t token) {
+    out[0] = static_cast<uint8_t>(kind);
+    out[1] = static_cast<uint8_t>((sender >> 8) & 0xFF);
+    out[2] = static_cast<uint8_t>(sender & 0xFF);
+    setDatagramToken(out, token);
 }
 
+/**
+ *
+ * @param data
+ * @param length
+ * @param outSender
+ * @param outToken
+ * @return false if the datagram is too short to have a header
+ */
+bool PacketIO::readDatagramHeader(const uint8_t* data, int length, uint16_t& outSender, uint32_t& outToken) {
+    if (length < DATAGRAM_HEADER_SIZE) return false;
+
+    outSender = static_cast<uint16_t>((data[1] << 8) | data[2]);
+    outToken = (static_cast<uint32_t>(data[3]) << 24) |
+               (static_cast<uint32_t>(data[4]) << 16) |
+               (static_cast<uint32_t>(data[5]) << 8) |
+               (static_cast<uint32_t>(data[6]));
+    return true;
+}
+
+// lets a datagram that was encoded once go to several clients
+void PacketIO::setDatagramToken(uint8_t* datagram, uint32_t token) {
+    datagram[3] = static_cast<uint8_t>((token >> 24) & 0xFF);
+    datagram[4] = static_cast<uint8_t>((token >> 16) & 0xFF);
+    datagram[5] = static_cast<uint8_t>((token >> 8) & 0xFF);
+    datagram[6] = static_cast<uint8_t>(token & 0xFF);
+}
+
+/**
+ *
+ * Encode a packet as a state datagram
+ *
+ * @param out datagram buffer
+ * @param capacity
+ * @param sender client id, DATAGRAM_SENDER_SERVER for the server
+ * @param token see writeDatagramHeader()
+ * @param sequence per sender, receivers drop anything older than what they already have
+ * @param packet
+ * @return datagram length, -1 if it does not fit
+ */
+int PacketIO::writeDatagram(uint8_t* out, int capacity, uint16_t sender, uint32_t token, uint16_t sequence,
+                            const IPacket& packet) {
+    thread_local std::vector<uint8_t> payload;
+    payload.clear();
+    packet.serialize(payload);
+
+    const int length = DATAGRAM_HEADER_SIZE + 3 + static_cast<int>(payload.size());
+    if (length > capacity) return -1;
 
+    writeDatagramHeader(out, DatagramKind::DGRAM_STATE, sender, token);
+
+    uint8_t* body = out + DATAGRAM_HEADER_SIZE;
+    body[0] = static_cast<uint8_t>((sequence >> 8) & 0xFF);
+    body[1] = static_cast<uint8_t>(sequence & 0xFF);
+    body[2] = static_cast<uint8_t>(packet.type());
+    if (!payload.empty()) std::memcpy(body + 3, payload.data(), payload.size());
+
+    return length;
+}
+
+/**
+ *
+ * Decode a state datagram. The token is left to the caller, see readDatagramHeader()
+ *
+ * @param data
+ * @param length
+ * @param outSender
+ * @param outSequence
+ * @param outPacket left empty for unknown packet types
+ * @return NET_ERROR for truncated or malformed datagrams
+ */
+Net::Result PacketIO::readDatagram(const uint8_t* data, int length, uint16_t& outSender, uint16_t& outSequence,
+                                   AnyPacket& outPacket) {
+    outPacket.reset();
+
+    if (length < DATAGRAM_HEADER_SIZE + 3) return Net::Result::NET_ERROR;
+    if (data[0] != static_cast<uint8_t>(DatagramKind::DGRAM_STATE)) return Net::Result::NET_ERROR;
+
+    outSender = static_cast<uint16_t>((data[1] << 8) | data[2]);
+
+    const uint8_t* body = data + DATAGRAM_HEADER_SIZE;
+    const int bodyLength = length - DATAGRAM_HEADER_SIZE;
+    outSequence = static_cast<uint16_t>((body[0] << 8) | body[1]);
+
+    if (!PacketDispatch::decode(static_cast<PacketType>(body[2]), body + 3, static_cast<size_t>(bodyLength - 3), outPacket)) {
+        return Net::Result::NET_ERROR;
+    }
+    outPacket.wireBytes = static_cast<uint16_t>(length);
+    return Net::Result::NET_OK;
+}
@@ -0,0 +1,158 @@
+#include "network/prediction.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "network/packets.h"
+#include "player_movement.h"
+
+Prediction::Prediction() {
+    mInputs.resize(PREDICTION_MIN_INPUTS);
+}
+
+/**
+ *
+ * Forget every input and start over at a position
+ *
+ * @param x
+ * @param y
+ */
+void Prediction::reset(int32_t x, int32_t y) {
+    mHead = 0;
+    mCount = 0;
+    mX = mServerX = x;
+    mY = mServerY = y;
+    mHasAck = false;
+}
+
+/**
+ *
+ * Predict one input step
+ *
+ * @param buttons PlayerButton bits
+ * @param nowMs
+ * @return sequence of the input, sent along with it
+ */
+uint16_t Prediction::apply(uint8_t buttons, double nowMs) {
+    if (mCount == mInputs.size()) {
+        // the server is not answering fast enough, the oldest input can no longer be replayed
+        mHead = (mHead + 1) % mInputs.size();
+        mCount--;
+        mStats.dropped++;
+    }
+
+    mSequence++;
+    PlayerMovement::step(mX, mY, buttons);
+
+    mInputs[(mHead + mCount) % mInputs.size()] = Input{mSequence, buttons, mX, mY, nowMs};
+    mCount++;
+
+    return mSequence;
+}
+
+/**
+ *
+ * The server's state after it applied every input up to ackSequence. Acked inputs are dropped, a state that
+ * does not match the prediction moves the player there and replays the rest
+ *
+ * @param ackSequence
+ * @param x
+ * @param y
+ * @param nowMs
+ */
+void Prediction::reconcile(uint16_t ackSequence, int32_t x, int32_t y, double nowMs) {
+    if (mHasAck && !PacketCodec::sequence_greater(ackSequence, mLastAck)) return; // stale
+    mLastAck = ackSequence;
+    mHasAck = true;
+    mServerX = x;
+    mServerY = y;
+    mStats.acks++;
+
+    bool matched = false;
+    while (mCount > 0 && !PacketCodec::sequence_greater(mInputs[mHead].sequence, ackSequence)) {
+        const Input& input = mInputs[mHead];
+        if (input.sequence == ackSequence) {
+            const double sample = nowMs - input.sentMs;
+            mRtt = mRtt == 0 ? sample : mRtt + (sample - mRtt) / 8.0;
+            matched = input.x == x && input.y == y;
+        }
+
+        mHead = (mHead + 1) % mInputs.size();
+        mCount--;
+    }
+
+    if (!matched) {
+        const int32_t predictedX = mX;
+        const int32_t predictedY = mY;
+
+        mX = x;
+        mY = y;
+        for (size_t i = 0; i < mCount; i++) {
+            Input& input = mInputs[(mHead + i) % mInputs.size()];
+            PlayerMovement::step(mX, mY, input.buttons);
+            input.x = mX;
+            input.y = mY;
+        }
+
+        const double correction = std::hypot(static_cast<double>(mX - predictedX), static_cast<double>(mY - predictedY));
+        mStats.corrections++;
+        mStats.lastReplayed = mCount;
+        mStats.lastCorrection = correction;
+        mStats.maxCorrection = std::max(mStats.maxCorrection, correction);
+    }
+
+    fit();
+}
+
+/**
+ *
+ * Buttons of the newest inputs for the input packet, so a lost datagram is covered by the next one
+ *
+ * @param maxCount
+ * @param outCount inputs packed, at least one once anything was applied
+ * @return PLAYER_BUTTON_BITS per input, newest in the lowest bits
+ */
+uint16_t Prediction::history(int maxCount, uint8_t& outCount) const {
+    const size_t count = std::min(mCount, static_cast<size_t>(std::max(maxCount, 0)));
+
+    uint16_t packed = 0;
+    for (size_t age = 0; age < count; age++) {
+        packed |= static_cast<uint16_t>(at(age).buttons << (age * PLAYER_BUTTON_BITS));
+    }
+    outCount = static_cast<uint8_t>(count);
+    return packed;
+}
+
+PredictionStats Prediction::stats() const {
+    PredictionStats stats = mStats;
+    stats.rttMs = mRtt;
+    stats.pending = mCount;
+    stats.capacity = mInputs.size();
+    return stats;
+}
+
+// input `age` steps before the newest one
+const Prediction::Input& Prediction::at(size_t age) const {
+    return mInputs[(mHead + mCount - 1 - age) % mInputs.size()];
+}
+
+/**
+ *
+ * Size the ring for the measured rtt. Only regrows when it is off by more than a quarter, so it settles
+ *
+ */
+void Prediction::fit() {
+    const double stepMs = 1000.0 / PLAYER_INPUT_RATE;
+    const size_t wanted = std::clamp<size_t>(static_cast<size_t>(std::ceil(mRtt * PREDICTION_RTT_MARGIN / stepMs)) + 8,
+                                             std::max<size_t>(PREDICTION_MIN_INPUTS, mCount), PREDICTION_MAX_INPUTS);
+
+    const size_t current = mInputs.size();
+    if (wanted * 4 > current * 3 && wanted * 4 < current * 5) return;
+
+    std::vector<Input> resized(wanted);
+    for (size_t i = 0; i < mCount; i++) {
+        resized[i] = mInputs[(mHead + i) % current];
+    }
+    mInputs = std::move(resized);
+    mHead = 0;
+}
@@ -1,12 +1,16 @@
 #include "network/server.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <iostream>
 #include <thread>
 
 #include "manager/console_manager.h"
 #include "network/packets.h"
-#include "network/packets/player_disconnect_packet.h"
+#include "network/packet_dispatch.h"
+#include "network/server_shard.h"
+#include "player_movement.h"
 #include "util/dev/console/console.h"
 
 /**
@@ -15,10 +19,48 @@
  *
  * @param address
  * @param maxClients
+ * @param transport
+ * @param workers io threads the client sockets are spread over, 0 keeps all socket io on the tick thread
  */
-Server::Server(const Net::Address &address, int maxClients) {
+Server::Server(const Net::Address &address, int maxClients, Net::Transport transport, int workers) {
     mSocket = Socket::create(Net::Protocol::NET_TCP, true);
+
+    // client ids are slot indices and the packets only have room for ids up to PLAYER_ID_MAX
+    if (maxClients > PLAYER_ID_MAX + 1) {
+        ConsoleManager::get().log(WARNING, "Server: max clients is limited to %d", PLAYER_ID_MAX + 1);
+        maxClients = PLAYER_ID_MAX + 1;
+    }
     this->mMaxClients = maxClients;
+
+    // never grows past this, so Client pointers survive accepts
+    mClients.reserve(maxClients);
+    mClientInfo.resize(maxClients);
+    mInterest.resize(maxClients);
+    mLagHistory.resize(maxClients, mTickRate);
+    mLagHistoryStats = mLagHistory.stats();
+
+    if (transport == Net::Transport::NET_URING) {
+        // one receive buffer per client next to the send pool
+        mUring = std::make_unique<UringTransport>(2048, 1024, 4096, maxClients);
+        if (!mUring->valid()) {
+            ConsoleManager::get().log(WARNING, "Server: io_uring is not available, falling back to syscall transport");
+            mUring.reset();
+        }
+    }
+
+    if (workers > 0) {
+        if (mUring) {
+            ConsoleManager::get().log(WARNING, "Server: io_uring is not used with io workers, falling back to syscall transport");
+            mUring.reset();
+        }
+
+        for (int i = 0; i < workers; i++) {
+            mShards.push_back(std::make_unique<ServerShard>(i));
+            mShards.back()->start();
+        }
+        ConsoleManager::get().log(INFO, "Server: Client io runs on %d worker threads", workers);
+    }
+
     if (Socket::bind(mSocket, address) != Net::Result::NET_OK) {
         ConsoleManager::get().log(FATAL, "Server: Failed to bind to socket");
         return;
@@ -28,6 +70,16 @@ Server::Server(const Net::Address &address, int maxClients) {
         ConsoleManager::get().log(FATAL, "Server: Failed to listen on socket");
         return;
     }
+
+    if (mReactor.add(mSocket, LISTENER_KEY) != Net::Result::NET_OK) {
+        ConsoleManager::get().log(FATAL, "Server: Failed to register socket with the reactor");
+        return;
+    }
+    mListening = true;
+
+    if (!mDatagram.open(address)) {
+        ConsoleManager::get().log(WARNING, "Server: Failed to bind udp socket, state updates are disabled");
+    }
 }
 
 /**
@@ -37,22 +89,30 @@ Server::Server(const Net::Address &address, int maxClients) {
  * @param client
  */
 void Server::processPackage(Client* client) {
+    AnyPacket packet;
     while (true) {
-        std::unique_ptr<IPacket> pkt;
-        Net::Result res = PacketIO::receivePacket(client->sock, pkt);
+        Net::Result res = PacketIO::receivePacket(client->sock, client->in, packet);
 
         if (res == Net::Result::NET_DISCONNECTED) {
             removeClient(client->id, DisconnectReason::DIS_LEFT);
             break;
         }
-        if (res != Net::Result::NET_OK) {
+        if (res == Net::Result::NET_WOULDBLOCK) {
+            // drained, the reactor will report the next edge
+            client->readable = false;
             break;
         }
-        if (!pkt) {
+        if (res != Net::Result::NET_OK) {
+            // a malformed frame was skipped, keep going until the socket is drained
+            continue;
+        }
+        if (packet.wireBytes > 0) client->stats.countIn(packet.type(), packet.wireBytes);
+        if (packet.empty()) {
             continue;
         }
 
-        pkt->handleServer(this, client);
+        PacketDispatch::handleServer(packet, this, client);
+        if (!client->connected) break;
     }
 }
 
@@ -64,31 +124,32 @@ void Server::processPackage(Client* client) {
 void Server::acceptClients()
 {
 
-    for (int i = 0; i < mMaxClients - mClients.size(); i++)
+    if (!mAcceptPending) return;
+
+    while (static_cast<int>(mClients.size()) < mMaxClients)
     {
         Socket sock{};
         Net::Address addr{};
         Net::Result result = Socket::accept(mSocket, &sock, &addr);
         if (result != Net::Result::NET_OK) {
+            // backlog drained
+            mAcceptPending = false;
             break;
         }
 
-        int id = 0;
+        const int id = static_cast<int>(mClients.nextIndex());
+        ServerShard* shard = shardOf(id);
 
-        while (true)
-        {
-            bool found = false;
-            for (const auto& client : mClients)
-            {
-                if (client.id == id)
-                {
-                    found = true;
-                    break;
-                }
-            }
-
-            if (!found) break;
-            id++;
+        // with io_uring the ring reads the socket, the reactor never sees it
+        if (mUring && !mUring->startReceive(sock, static_cast<uint64_t>(id))) {
+            ConsoleManager::get().log(WARNING, "Server: No io_uring receive buffer left for client %d", id);
+            Socket::close(sock);
+            continue;
+        }
+        if (!shard && !mUring && mReactor.add(sock, static_cast<uint64_t>(id)) != Net::Result::NET_OK) {
+            ConsoleManager::get().log(WARNING, "Server: Failed to register client %d with the reactor", id);
+            Socket::close(sock);
+            continue;
         }
 
         Client client;
@@ -96,9 +157,24 @@ void Server::acceptClients()
         client.connected = true;
         client.accepted = true;
         client.sock = sock;
-        client.addr = addr;
 
-        mClients.push_back(client);
+        // 0 is what a client sends before it got its token
+        do client.udpToken = mTokenSource(); while (client.udpToken == 0);
+
+        // data may already be waiting, the edge for it happened before we registered
+        client.readable = !shard && !mUring;
+
+        const ClientHandle handle = mClients.insert(std::move(client));
+        mClients.get(handle)->generation = handle.generation;
+        mClientInfo[id] = ClientInfo{};
+        mClientInfo[id].addr = addr;
+
+        if (shard) {
+            // the worker owns the socket from here on
+            shard->addClient(id, handle.generation, sock);
+        } else if (client.readable) {
+            mReadyClients.push_back(id);
+        }
     }
 }
 
@@ -111,6 +187,9 @@ void Server::acceptClients()
  * @param announce
  */
 void Server::removeClient(const int id, const DisconnectReason reason, bool announce) {
+    Client* client = getClient(id);
+    if (!client || !client->connected) return;
+
     ConsoleManager::get().log(INFO, "Server: Removing client %d", id);
 
     PlayerDisconnectPacket disconnectedPacket{};
@@ -118,11 +197,42 @@ void Server::removeClient(const int id, const DisconnectReason reason, bool anno
     disconnectedPacket.id = -1;
     disconnectedPacket.announce = false;
 
-    PacketIO::sendPacket(mClients[id].sock, disconnectedPacket);
+    // best effort, whatever is still queued for this client goes out in front of it
+    sendPacket(client, disconnectedPacket);
 
-    mClients[id].accepted = false;
-    mClients[id].connected = false;
-    Socket::close(mClients[id].sock);
+    ServerShard* shard = shardOf(id);
+    if (shard) {
+        // the worker sends the rest and closes the socket
+        shard->send(id, client->out);
+        shard->removeClient(id);
+    } else if (!mUring) {
+        flushClient(*client);
+    } else if (!mUring->sending(client->sock)) {
+        // nothing of this client is in the ring, so one direct send can not overtake what was queued before.
+        // A client that still has sends in there is usually one that stopped reading, it goes without the packet
+        PacketIO::flush(client->sock, client->out);
+    }
+
+    client->accepted = false;
+    client->connected = false;
+    client->readable = false;
+    client->out.clear();
+    client->in.clear();
+    client->hasUdp = false;
+    client->hasUpdateSequence = false;
+    client->hasInput = false;
+    client->channel.reset();
+    mInterest.remove(id);
+    if (mUring && !shard) {
+        // cancels what the ring still has, the socket is closed once the kernel let go of it
+        mUring->closeSocket(client->sock);
+    } else if (!shard) {
+        mReactor.remove(client->sock);
+        Socket::close(client->sock);
+    }
+
+    // the slot is freed at the end of the tick, callers may still hold this client
+    mRetired.push_back(ClientHandle{static_cast<uint32_t>(id), client->generation});
 
     disconnectedPacket.id = id;
     disconnectedPacket.announce = announce;
@@ -130,89 +240,479 @@ void Server::removeClient(const int id, const DisconnectReason reason, bool anno
     broadcastPacket(disconnectedPacket, true);
 }
 
+/**
+ *
+ * Free the slots of every client removed this tick, their ids can be handed out again
+ *
+ */
+void Server::retireClients() {
+    for (const ClientHandle& handle : mRetired) {
+        mClients.erase(handle);
+    }
+    mRetired.clear();
+}
+
 bool Server::isRunning() const {
     return mRunning;
 }
 
 /**
  *
- * Loop through clients and remove dead clients.
- * Starts Client_ProcessPackage for each client
+ * Wait once on the reactor and collect every socket that became ready since last tick
+ *
+ * @param timeoutMs 0 during ticks, only the idle loop blocks
+ */
+void Server::pollEvents(int timeoutMs) {
+    int count = 0;
+    if (mReactor.wait(timeoutMs, &count) != Net::Result::NET_OK) {
+        ConsoleManager::get().log(FATAL, "Server: Failed to poll the reactor");
+        return;
+    }
+
+    const NetReactor::Event* events = mReactor.events();
+    for (int i = 0; i < count; i++) {
+        const NetReactor::Event& ev = events[i];
+
+        if (ev.key == LISTENER_KEY) {
+            if (ev.readable) mAcceptPending = true;
+            continue;
+        }
+
+        const int id = static_cast<int>(ev.key);
+        Client* client = getClient(id);
+        if (!client || !client->connected) continue;
+
+        if (ev.writable) client->writable = true;
+        if (ev.readable && !client->readable) {
+            client->readable = true;
+            mReadyClients.push_back(id);
+        }
+    }
+}
+
+/**
+ *
+ * Handle everything the io workers decoded since last tick. Events of a connection that was already
+ * removed, or whose id has been taken by a newer one, are dropped
+ *
+ */
+void Server::processShards() {
+    ServerShard::Event event;
+
+    for (auto& shard : mShards) {
+        while (shard->poll(event)) {
+            const int id = event.clientId;
+            Client* client = mClients.get(ClientHandle{static_cast<uint32_t>(id), event.generation});
+            if (!client || !client->connected) continue;
+
+            switch (event.kind) {
+                case ServerShard::Event::Kind::PACKET:
+                    client->stats.countIn(event.packet.type(), event.packet.wireBytes);
+                    PacketDispatch::handleServer(event.packet, this, client);
+                    break;
+                case ServerShard::Event::Kind::DISCONNECTED:
+                    removeClient(id, DisconnectReason::DIS_LEFT);
+                    break;
+                case ServerShard::Event::Kind::SLOW:
+                    ConsoleManager::get().log(WARNING, "Server: Client %d is not keeping up", id);
+                    removeClient(id, DisconnectReason::DIS_TIMEOUT);
+                    break;
+            }
+        }
+    }
+}
+
+/**
+ *
+ * Drain the udp socket and handle every datagram. Only datagrams with the sender's session token count,
+ * its udp address is bound to the first one of them and anything from another address is dropped after that
+ *
+ */
+void Server::processDatagrams() {
+    const double nowMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    for (int count = mDatagram.receive(); count > 0; count = mDatagram.receive()) {
+        for (int i = 0; i < count; i++) {
+            const DatagramChannel::Datagram& d = mDatagram.received(i);
+
+            uint16_t sender{};
+            uint32_t token{};
+            if (!PacketIO::readDatagramHeader(d.data, d.length, sender, token)) continue;
+
+            Client* found = getClient(sender);
+            if (!found || !found->connected || !found->accepted) continue;
+            if (token != found->udpToken) continue;
+
+            Client& client = *found;
+
+            if (!client.hasUdp) {
+                client.udpAddr = d.addr;
+                client.hasUdp = true;
+            } else if (client.udpAddr.ip != d.addr.ip || client.udpAddr.port != d.addr.port) {
+                continue;
+            }
+            client.stats.bytesIn += static_cast<uint64_t>(d.length);
+
+            if (d.data[0] == static_cast<uint8_t>(DatagramKind::DGRAM_CHANNEL)) {
+                if (!channelOf(client).receive(d.data, d.length, nowMs, mTickArena)) continue;
+
+                AnyPacket packet;
+                ChannelType channel{};
+                while (client.connected && client.channel && client.channel->poll(packet, channel)) {
+                    client.stats.countIn(packet.type(), 0);
+                    PacketDispatch::handleServer(packet, this, &client);
+                }
+                continue;
+            }
+
+            uint16_t datagramSender{};
+            uint16_t sequence{};
+            AnyPacket packet;
+            if (PacketIO::readDatagram(d.data, d.length, datagramSender, sequence, packet) != Net::Result::NET_OK) continue;
+            client.stats.countIn(packet.type(), 0);
+            if (packet.empty()) continue;
+
+            if (PlayerUpdatePacket* update = packet.get<PlayerUpdatePacket>()) {
+                update->sequence = sequence;
+            }
+
+            PacketDispatch::handleServer(packet, this, &client);
+        }
+    }
+}
+
+/**
+ *
+ * Process packages for the clients the reactor reported as readable.
+ * Clients that were not fully drained stay in the ready list for the next tick
  *
  */
 void Server::processClients() {
-    for (int i = 0; i < mClients.size(); i++) {
-        if (!mClients[i].connected) continue;
-        if (Socket::poll(&mClients[i].sock, 1, 0, &mClients[i].readable, &mClients[i].writable) != Net::Result::NET_OK) {
-            ConsoleManager::get().log(FATAL, "Server: Failed to poll client %d", i);
+    mProcessing.swap(mReadyClients);
+    mReadyClients.clear();
+
+    for (int id : mProcessing) {
+        Client* client = getClient(id);
+        if (!client || !client->connected || !client->readable) continue;
+
+        processPackage(client);
+
+        if (client->connected && client->readable) {
+            mReadyClients.push_back(id);
         }
     }
+}
 
-    for (int i = 0; i < mClients.size(); i++) {
-        if (!mClients[i].connected) continue;
+/**
+ *
+ * Handle what the io_uring transport completed since the last tick. Received bytes are cut into packets
+ * right away, the read that got them goes back to the kernel with this tick's submit
+ *
+ */
+void Server::processRing() {
+    if (!mUring) return;
 
+    mCompletions.clear();
+    mUring->reap(mCompletions);
+
+    AnyPacket packet;
+    for (const UringTransport::Completion& c : mCompletions) {
+        if (!c.receive) {
+            if (c.result < 0) ConsoleManager::get().log(WARNING, "Server: Queued send failed (%d)", c.result);
+            continue;
+        }
+
+        Client* client = getClient(static_cast<int>(c.key));
+        if (!client || !client->connected) continue;
+
+        if (c.result <= 0) {
+            removeClient(client->id, DisconnectReason::DIS_LEFT);
+            continue;
+        }
 
-        processPackage(&mClients[i]);
+        const size_t length = static_cast<size_t>(c.result);
+        StreamBuffer& in = client->in;
+        if (in.writable() < length) in.compact();
+        if (in.writable() < length) in.reserve(in.readable() + length);
+        std::memcpy(in.writePtr(), c.data, length);
+        in.commit(length);
+
+        while (client->connected) {
+            Net::Result res = PacketIO::nextPacket(in, packet);
+            if (res == Net::Result::NET_WOULDBLOCK) break;
+            if (res == Net::Result::NET_DISCONNECTED) {
+                removeClient(client->id, DisconnectReason::DIS_LEFT);
+                break;
+            }
+            if (res != Net::Result::NET_OK) continue; // a malformed frame was skipped
+
+            if (packet.wireBytes > 0) client->stats.countIn(packet.type(), packet.wireBytes);
+            if (packet.empty()) continue;
+
+            PacketDispatch::handleServer(packet, this, client);
+        }
     }
 }
 
 /**
  *
- * Sleep for the reaming time of this tick and warns if tick have been skipped
+ * One simulation step: collect network input, run the game logic and send everything that was queued
  *
- * @return the number of tick that was skipped because of stress
  */
-void Server::sleep(const double tickStartTimeMs) {
-    constexpr double tickMs = 33.333;
+void Server::tick() {
+    using Clock = std::chrono::steady_clock;
 
-    const double nowMs =
-        std::chrono::duration<double, std::milli>(
-            std::chrono::steady_clock::now().time_since_epoch()
-        ).count();
+    if (mNetStatsReset.exchange(false)) {
+        mRttHistogram.reset();
+        for (Histogram& phase : mPhaseHistograms) phase.reset();
+    }
 
-    const double elapsed = nowMs - tickStartTimeMs;
+    const auto start = Clock::now();
 
-    if (elapsed < tickMs) {
-        std::this_thread::sleep_for(
-            std::chrono::milliseconds(
-                static_cast<long long>(tickMs - elapsed)
-            )
-        );
-        return;
+    // for client shit (important)
+    pollEvents(0);
+    acceptClients();
+    const auto polled = Clock::now();
+
+    processClients();
+    processRing();
+    processShards();
+    processDatagrams();
+    const auto received = Clock::now();
+
+    // Tick logic goes here
+
+    updateInterest();
+    recordHistory();
+    const auto simulated = Clock::now();
+
+    flushClients();
+    retireClients();
+    const auto flushed = Clock::now();
+
+    auto phaseNs = [](Clock::time_point from, Clock::time_point to) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    };
+    mPhaseHistograms[static_cast<int>(TickPhase::PHASE_POLL)].record(phaseNs(start, polled));
+    mPhaseHistograms[static_cast<int>(TickPhase::PHASE_RECEIVE)].record(phaseNs(polled, received));
+    mPhaseHistograms[static_cast<int>(TickPhase::PHASE_SIMULATE)].record(phaseNs(received, simulated));
+    mPhaseHistograms[static_cast<int>(TickPhase::PHASE_FLUSH)].record(phaseNs(simulated, flushed));
+    mPhaseHistograms[static_cast<int>(TickPhase::PHASE_TICK)].record(phaseNs(start, flushed));
+
+    mLastBroadcastStats = mBroadcastStats;
+    mBroadcastStats = {};
+
+    mTickArena.reset();
+
+    PoolStats pendingMessages{};
+    PoolStats bufferedMessages{};
+    for (const Client& c : mClients) {
+        if (!c.channel) continue;
+        pendingMessages += c.channel->pendingPoolStats();
+        bufferedMessages += c.channel->bufferedPoolStats();
     }
 
-    int skippedTicks = static_cast<int>(elapsed / tickMs) - 1;
-    if (skippedTicks < 0) skippedTicks = 0;
-    ConsoleManager::get().log(SUCCESS, "Server is running behind! Skipped %d ticks", skippedTicks);
+    AllocatorStats allocatorStats{};
+    allocatorStats.tickArena = mTickArena.stats();
+    allocatorStats.pendingMessages = pendingMessages;
+    allocatorStats.bufferedMessages = bufferedMessages;
+    {
+        std::lock_guard lock(mStatsMutex);
+        mAllocatorStats = allocatorStats;
+    }
 
-    mTick++;
+    publishNetStats();
+}
+
+Server::AllocatorStats Server::getAllocatorStats() const {
+    std::lock_guard lock(mStatsMutex);
+    return mAllocatorStats;
 }
 
 /**
  *
- * Start the server. This will start the ticking process and begin accepting clients
+ * Turn the counters into rates and copy them out together with the histograms, at most every
+ * NET_STATS_PUBLISH_MS. Clients removed since the last publish are left out
+ *
+ */
+void Server::publishNetStats() {
+    const double nowMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (mNetStatsPublishedMs >= 0.0 && nowMs - mNetStatsPublishedMs < NET_STATS_PUBLISH_MS) return;
+
+    const double intervalMs = mNetStatsPublishedMs >= 0.0 ? nowMs - mNetStatsPublishedMs : 0.0;
+    mNetStatsPublishedMs = nowMs;
+
+    std::lock_guard lock(mNetStatsMutex);
+
+    mNetStats.intervalMs = intervalMs;
+    mNetStats.connections.clear();
+    mNetStats.total = ConnectionStats{};
+    mNetStats.totalRates = ConnectionRates{};
+
+    for (Client& c : mClients) {
+        if (!c.connected) continue;
+        c.stats.rttMs = c.channel ? c.channel->rttMs() : 0.0;
+
+        ConnectionStats& published = mClientInfo[c.id].publishedStats;
+        ConnectionSample sample{c.id, c.stats, c.stats.ratesSince(published, intervalMs / 1000.0)};
+        published = c.stats;
+
+        mNetStats.total.add(sample.stats);
+        mNetStats.totalRates.bytesIn += sample.rates.bytesIn;
+        mNetStats.totalRates.bytesOut += sample.rates.bytesOut;
+        mNetStats.totalRates.packetsIn += sample.rates.packetsIn;
+        mNetStats.totalRates.packetsOut += sample.rates.packetsOut;
+        mNetStats.connections.push_back(sample);
+    }
+
+    mNetStats.broadcast = mLastBroadcastStats;
+    mNetStats.rttUs = mRttHistogram;
+    for (int i = 0; i < TICK_PHASE_COUNT; i++) {
+        mNetStats.phaseNs[i] = mPhaseHistograms[i];
+    }
+}
+
+Server::NetStats Server::getNetStats() const {
+    std::lock_guard lock(mNetStatsMutex);
+    return mNetStats;
+}
+
+void Server::resetNetStats() {
+    mNetStatsReset = true;
+}
+
+bool Server::hasConnectedClients() const {
+    for (const auto& c : mClients) {
+        if (c.connected) return true;
+    }
+    return false;
+}
+
+/**
+ *
+ * Keep where every player is at the end of this tick, so hits can be checked against what a client saw.
+ * The history is only reallocated when the tick rate changed
+ *
+ */
+void Server::recordHistory() {
+    if (mLagHistory.getTickRate() != mScheduler.getRate()) {
+        mLagHistory.resize(mMaxClients, mScheduler.getRate());
+    }
+
+    mLagHistory.beginTick(mTick);
+    for (const Client& c : mClients) {
+        if (!c.accepted || !(c.hasInput || c.hasUpdateSequence)) continue;
+        mLagHistory.record(c.id, c.posX, c.posY);
+    }
+
+    const LagHistoryStats stats = mLagHistory.stats();
+
+    std::lock_guard lock(mStatsMutex);
+    mLagHistoryStats = stats;
+}
+
+LagHistoryStats Server::getLagHistoryStats() const {
+    std::lock_guard lock(mStatsMutex);
+    return mLagHistoryStats;
+}
+
+/**
+ *
+ * The tick a client was looking at when it sent what arrives now. Its input took half a round trip to get
+ * here, the state it was reacting to took the other half to get there and was drawn renderDelayMs late
+ *
+ * @param client
+ * @param renderDelayMs interpolation delay of the client
+ * @return fractional tick for LagHistory, clamped to what the history keeps
+ */
+double Server::viewTick(const Client* client, double renderDelayMs) const {
+    const double rttMs = client->channel ? client->channel->rttMs() : 0.0;
+    const double rate = mLagHistory.getTickRate();
+
+    const double tick = static_cast<double>(mTick) - (rttMs + renderDelayMs) * rate / 1000.0;
+    return std::clamp(tick, static_cast<double>(mLagHistory.getOldestTick()), static_cast<double>(mTick));
+}
+
+/**
+ *
+ * Start the server. This will start the ticking process and begin accepting clients.
+ * Ticks run at a fixed rate from the tick scheduler. While nobody is connected the thread blocks on the
+ * listener instead, so an empty server does not use any cpu
  *
  */
 void Server::run() {
-    std::thread([&] {
+    if (mRunning) return;
+    mRunning = true;
+
+    mThread = std::thread([this] {
         ConsoleManager::get().log(SUCCESS, "Successfully started server");
-        mRunning = true;
+        mScheduler.reset();
+
+        uint64_t reportedDrops = 0;
         while (mRunning) {
-            auto tickStart = std::chrono::steady_clock::now();
+            mScheduler.setRate(mTickRate);
+            mScheduler.setPolicy(mTickPolicy);
+
+            if (!mAcceptPending && !hasConnectedClients() && (!mUring || mUring->idle())) {
+                pollEvents(SERVER_IDLE_WAIT_MS);
+
+                // idle time is not owed as ticks
+                mScheduler.reset();
+                if (!mAcceptPending) continue;
+            }
+
+            mScheduler.wait();
 
-            // for client shit (important)
-            acceptClients();
-            processClients();
+            const int due = mScheduler.collect();
+            const uint64_t first = mScheduler.getTick() - due;
+            for (int i = 0; i < due && mRunning; i++) {
+                // number of the tick being simulated, the lag history is keyed by it
+                mTick = first + i + 1;
 
-            // Tick logic goes here
+                const auto start = std::chrono::steady_clock::now();
+                tick();
+                const uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
 
-            double tickStartMs = std::chrono::duration<double, std::milli>(
-                    tickStart.time_since_epoch()
-                ).count();
+                // only this thread writes them
+                mTicksRun.store(mTicksRun.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                mTickTotalNs.store(mTickTotalNs.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+                if (ns > mTickMaxNs.load(std::memory_order_relaxed)) mTickMaxNs.store(ns, std::memory_order_relaxed);
+            }
 
-            sleep(tickStartMs);
+            if (mScheduler.getDropped() != reportedDrops) {
+                ConsoleManager::get().log(WARNING, "Server is running behind! Dropped %llu ticks",
+                    static_cast<unsigned long long>(mScheduler.getDropped() - reportedDrops));
+                reportedDrops = mScheduler.getDropped();
+                mDroppedTicks = reportedDrops;
+            }
         }
-    }).detach();
+    });
+}
+
+void Server::setTickRate(double rate) {
+    mTickRate = std::clamp(rate, TICK_MIN_RATE, TICK_MAX_RATE);
+}
+
+void Server::setTickPolicy(TickPolicy policy) {
+    mTickPolicy = policy;
+}
+
+/**
+ *
+ * Change the area of interest. Applied at the start of the next tick, which checks every player again
+ *
+ * @param cellSize
+ * @param range 0 turns filtering off
+ * @param hysteresis
+ */
+void Server::setInterest(int32_t cellSize, int32_t range, int32_t hysteresis) {
+    mInterestCellSize = std::max(cellSize, 1);
+    mInterestRange = std::max(range, 0);
+    mInterestHysteresis = std::max(hysteresis, 0);
+    mInterestChanged = true;
 }
 
 /**
@@ -222,10 +722,15 @@ void Server::run() {
  */
 Server::~Server() {
     mRunning = false;
-    for (int i = 0; i < mClients.size(); i++) {
-        if (!mClients[i].accepted) continue;
-        removeClient(i, DisconnectReason::DIS_CLOSE, false);
+    if (mThread.joinable()) mThread.join();
+
+    for (auto& c : mClients) {
+        if (!c.accepted) continue;
+        removeClient(c.id, DisconnectReason::DIS_CLOSE, false);
     }
+
+    // workers finish the removes queued above before they exit
+    mShards.clear();
     Socket::close(mSocket);
 }
 
@@ -238,9 +743,399 @@ void Server::stop() {
     mRunning = false;
 }
 
+/**
+ *
+ * Send a packet to every client. The frame is encoded once and then only copied into each
+ * client's output queue, so a broadcast to N clients is one serialize and N memcpy
+ *
+ * @param packet
+ * @param acceptedOnly skip clients that have not finished connecting
+ */
 void Server::broadcastPacket(const IPacket& packet, bool acceptedOnly) {
+    const auto encodeStart = std::chrono::steady_clock::now();
+
+    mBroadcastFrame.clear();
+    if (!PacketIO::writePacket(mBroadcastFrame, packet)) return;
+
+    const uint64_t encodeNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - encodeStart).count());
+
+    uint64_t recipients = 0;
     for (auto& c : mClients) {
         if (acceptedOnly && !c.accepted) continue;
-        PacketIO::sendPacket(c.sock, packet);
+        if (!c.connected) continue;
+        if (c.out.size() > SERVER_OUT_HIGH_WATER) {
+            c.stats.wouldBlock++;
+            continue;
+        }
+
+        c.out.insert(c.out.end(), mBroadcastFrame.begin(), mBroadcastFrame.end());
+        c.stats.countOut(packet.type(), mBroadcastFrame.size());
+        recipients++;
+    }
+
+    mBroadcastStats.broadcasts++;
+    mBroadcastStats.encodes++;
+    mBroadcastStats.encodeNs += encodeNs;
+    mBroadcastStats.bytesFannedOut += recipients * mBroadcastFrame.size();
+
+    if (recipients > 1) {
+        mBroadcastStats.encodesSaved += recipients - 1;
+        mBroadcastStats.encodeNsSaved += encodeNs * (recipients - 1);
+    }
+}
+
+/**
+ *
+ * Queue a packet for a client. The frame is serialized straight into the client's output queue,
+ * everything queued during a tick leaves together in flushClients()
+ *
+ * @param client
+ * @param packet
+ * @return the NetResult
+ */
+Net::Result Server::sendPacket(Client* client, const IPacket& packet) {
+    if (!client->connected) return Net::Result::NET_ERROR;
+
+    // the client is already over its limit and gets dropped at the end of the tick
+    if (client->out.size() > SERVER_OUT_HIGH_WATER) {
+        client->stats.wouldBlock++;
+        return Net::Result::NET_WOULDBLOCK;
+    }
+
+    const size_t queued = client->out.size();
+    if (!PacketIO::writePacket(client->out, packet)) return Net::Result::NET_ERROR;
+
+    client->stats.countOut(packet.type(), client->out.size() - queued);
+    return Net::Result::NET_OK;
+}
+
+/**
+ *
+ * Hand a client's output queue to the socket. With io_uring the queue is copied into registered buffers
+ * and goes out with the batched submit, one buffer per socket at a time, otherwise it is one send
+ *
+ * @param client
+ * @return NET_WOULDBLOCK if bytes are still queued afterwards
+ */
+Net::Result Server::flushClient(Client& client) {
+    if (client.out.empty()) return Net::Result::NET_OK;
+
+    if (!mUring) return PacketIO::flush(client.sock, client.out);
+
+    size_t offset = 0;
+    while (offset < client.out.size()) {
+        const int chunk = static_cast<int>(std::min<size_t>(client.out.size() - offset, mUring->bufferSize()));
+
+        uint8_t* buffer = mUring->prepareSend(client.sock, chunk);
+        if (!buffer) break; // pool exhausted, the rest waits for the next tick
+
+        std::memcpy(buffer, client.out.data() + offset, chunk);
+        offset += chunk;
     }
-}
\ No newline at end of file
+
+    client.out.erase(client.out.begin(), client.out.begin() + static_cast<std::ptrdiff_t>(offset));
+    return client.out.empty() ? Net::Result::NET_OK : Net::Result::NET_WOULDBLOCK;
+}
+
+/**
+ *
+ * End of tick: flush every client's output queue once. Clients that can not keep up, either because their
+ * queue is over the high-water mark or because it has not drained for too many ticks, are disconnected
+ * with DIS_TIMEOUT instead of stalling the tick
+ *
+ */
+void Server::flushClients() {
+    mSlowClients.clear();
+
+    for (auto& c : mClients) {
+        if (!c.connected) continue;
+
+        if (ServerShard* shard = shardOf(c.id)) {
+            // the worker reports SLOW itself once its copy of the queue is over the high-water mark
+            shard->send(c.id, c.out);
+            continue;
+        }
+
+        Net::Result res = flushClient(c);
+        c.stats.queueDepth = c.out.size();
+
+        if (res == Net::Result::NET_OK) {
+            c.stalledTicks = 0;
+            continue;
+        }
+        if (res != Net::Result::NET_WOULDBLOCK) {
+            mSlowClients.push_back(c.id);
+            continue;
+        }
+
+        c.writable = false;
+        c.stalledTicks++;
+        c.stats.wouldBlock++;
+
+        if (c.out.size() > SERVER_OUT_HIGH_WATER || c.stalledTicks > SERVER_OUT_MAX_STALL_TICKS) {
+            ConsoleManager::get().log(WARNING, "Server: Client %d is not keeping up (%zu bytes queued)", c.id, c.out.size());
+            mSlowClients.push_back(c.id);
+        }
+    }
+
+    for (int id : mSlowClients) {
+        removeClient(id, DisconnectReason::DIS_TIMEOUT);
+    }
+
+    const double nowMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    for (auto& c : mClients) {
+        if (!c.connected || !c.hasUdp || !c.channel) continue;
+
+        const uint64_t sent = c.channel->bytesSent();
+        c.channel->update(nowMs, mDatagram, c.udpAddr, DATAGRAM_SENDER_SERVER, c.udpToken);
+        c.stats.bytesOut += c.channel->bytesSent() - sent;
+    }
+
+    mDatagram.flush();
+
+    // the queued sends, the receives handed out this tick and the cancels of removed clients
+    if (mUring) mUring->submit();
+}
+
+/**
+ *
+ * Send a packet on the udp state lane to every accepted client that has a known udp address.
+ * The datagram is encoded once and copied for each receiver, only the token is patched in
+ *
+ * @param packet
+ * @param sequence sequence of the entity this state belongs to
+ * @param exceptId client that should not receive it, usually the one it came from
+ */
+void Server::broadcastDatagram(const IPacket& packet, uint16_t sequence, int exceptId) {
+    uint8_t frame[DATAGRAM_MAX_SIZE];
+    const int length = PacketIO::writeDatagram(frame, DATAGRAM_MAX_SIZE, DATAGRAM_SENDER_SERVER, 0, sequence, packet);
+    if (length < 0) return;
+
+    for (auto& c : mClients) {
+        if (c.id == exceptId) continue;
+        if (!c.accepted || !c.hasUdp) continue;
+
+        uint8_t* out = mDatagram.prepare(c.udpAddr);
+        std::memcpy(out, frame, length);
+        PacketIO::setDatagramToken(out, c.udpToken);
+        mDatagram.commit(length);
+        c.stats.countOut(packet.type(), static_cast<size_t>(length));
+    }
+}
+
+/**
+ *
+ * Send a packet on the udp state lane to one client
+ *
+ * @param client
+ * @param packet
+ * @param sequence sequence of the entity this state belongs to
+ */
+void Server::sendDatagram(Client* client, const IPacket& packet, uint16_t sequence) {
+    if (!client->accepted || !client->hasUdp) return;
+
+    uint8_t* out = mDatagram.prepare(client->udpAddr);
+    const int length = PacketIO::writeDatagram(out, DATAGRAM_MAX_SIZE, DATAGRAM_SENDER_SERVER, client->udpToken,
+                                               sequence, packet);
+    if (length <= 0) return;
+
+    mDatagram.commit(length);
+    client->stats.countOut(packet.type(), static_cast<size_t>(length));
+}
+
+/**
+ *
+ * Send a state update on the udp lane to every client that currently sees the sender
+ *
+ * @param packet
+ * @param sequence
+ * @param senderId
+ */
+void Server::relayDatagram(const IPacket& packet, uint16_t sequence, int senderId) {
+    if (!isInterestEnabled()) {
+        broadcastDatagram(packet, sequence, senderId);
+        return;
+    }
+    if (!mInterest.has(senderId)) return;
+
+    uint8_t frame[DATAGRAM_MAX_SIZE];
+    const int length = PacketIO::writeDatagram(frame, DATAGRAM_MAX_SIZE, DATAGRAM_SENDER_SERVER, 0, sequence, packet);
+    if (length < 0) return;
+
+    for (const int id : mInterest.visibleTo(senderId)) {
+        Client* c = getClient(id);
+        if (!c || !c->accepted || !c->hasUdp) continue;
+
+        uint8_t* out = mDatagram.prepare(c->udpAddr);
+        std::memcpy(out, frame, length);
+        PacketIO::setDatagramToken(out, c->udpToken);
+        mDatagram.commit(length);
+        c->stats.countOut(packet.type(), static_cast<size_t>(length));
+    }
+}
+
+/**
+ *
+ * Tell the area of interest where a client is. Visibility changes go out at the end of the tick
+ *
+ * @param client
+ * @param x
+ * @param y
+ */
+void Server::moveClient(Client* client, int32_t x, int32_t y) {
+    if (!client->accepted) return;
+    client->posX = x;
+    client->posY = y;
+    mInterest.setPosition(client->id, x, y);
+}
+
+/**
+ *
+ * Simulate the inputs of a client the server has not seen yet and send out the resulting state. The owner
+ * gets it too, tagged with the newest input sequence, so its prediction knows which inputs are settled.
+ * Steps are paid from a budget refilled at PLAYER_INPUT_RATE, so sending inputs faster or skipping sequences
+ * does not move a player faster. Steps over the budget are dropped, the oldest first
+ *
+ * @param client
+ * @param input
+ */
+void Server::applyInput(Client* client, const PlayerInputPacket& input) {
+    if (!client->accepted) return;
+
+    const uint16_t fresh = client->hasInput ? static_cast<uint16_t>(input.sequence - client->inputSequence) : input.count;
+    if (fresh == 0 || fresh > 32768) return; // stale or duplicate
+
+    const double nowMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (client->inputRefillMs >= 0.0) {
+        client->inputBudget = std::min<double>(SERVER_INPUT_BURST,
+            client->inputBudget + (nowMs - client->inputRefillMs) * PLAYER_INPUT_RATE / 1000.0);
+    }
+    client->inputRefillMs = nowMs;
+
+    // inputs older than the packet's history were lost with every datagram that carried them
+    const int available = std::min<int>(fresh, input.count);
+    const int allowed = std::min(available, static_cast<int>(client->inputBudget));
+    client->inputBudget -= allowed;
+
+    for (int age = allowed - 1; age >= 0; age--) {
+        PlayerMovement::step(client->posX, client->posY, input.buttons(age));
+    }
+
+    client->inputSequence = input.sequence;
+    client->hasInput = true;
+
+    PlayerUpdatePacket state{};
+    state.id = client->id;
+    state.posX = client->posX;
+    state.posY = client->posY;
+
+    moveClient(client, client->posX, client->posY);
+    relayDatagram(state, input.sequence, client->id);
+    sendDatagram(client, state, input.sequence);
+}
+
+/**
+ *
+ * Apply interest settings and turn this tick's visibility changes into packets. A player coming into range
+ * is introduced like a join, with its last position right behind it. One going out of range is removed
+ * like a disconnect with DIS_OUT_OF_RANGE, so clients drop it without treating it as a leave
+ *
+ */
+void Server::updateInterest() {
+    if (mInterestChanged.exchange(false)) {
+        mInterest.configure(mInterestCellSize, mInterestRange, mInterestHysteresis);
+    }
+
+    if (!isInterestEnabled()) {
+        std::lock_guard lock(mStatsMutex);
+        mInterestStats = InterestStats{};
+        return;
+    }
+
+    for (const InterestEvent& event : mInterest.update()) {
+        Client* viewer = getClient(event.viewer);
+        if (!viewer || !viewer->accepted) continue;
+
+        if (!event.enter) {
+            PlayerDisconnectPacket leave{};
+            leave.id = event.subject;
+            leave.announce = 0;
+            leave.reason = DisconnectReason::DIS_OUT_OF_RANGE;
+            sendPacket(viewer, leave);
+            continue;
+        }
+
+        PlayerJoinPacket join{};
+        join.id = event.subject;
+        join.announce = 0;
+        join.reason = DisconnectReason::DIS_LEFT;
+        std::memcpy(join.name, getClientInfo(event.subject).name, 25);
+        sendPacket(viewer, join);
+
+        // the subject may stand still for a while, the viewer needs to know where it is now
+        if (!viewer->hasUdp) continue;
+
+        const Client* subject = getClient(event.subject);
+        PlayerUpdatePacket position{};
+        position.id = event.subject;
+        position.posX = mInterest.getX(event.subject);
+        position.posY = mInterest.getY(event.subject);
+
+        const uint16_t sequence = subject ? subject->updateSequence : 0;
+        uint8_t* out = mDatagram.prepare(viewer->udpAddr);
+        const int length = PacketIO::writeDatagram(out, DATAGRAM_MAX_SIZE, DATAGRAM_SENDER_SERVER, viewer->udpToken,
+                                                   sequence, position);
+        if (length <= 0) continue;
+
+        mDatagram.commit(length);
+        viewer->stats.countOut(position.type(), static_cast<size_t>(length));
+    }
+
+    const InterestStats stats = mInterest.stats();
+
+    std::lock_guard lock(mStatsMutex);
+    mInterestStats = stats;
+}
+
+InterestStats Server::getInterestStats() const {
+    std::lock_guard lock(mStatsMutex);
+    return mInterestStats;
+}
+
+/**
+ *
+ * Queue a packet on one of the client's udp message channels. It goes out with the end of tick flush,
+ * reliable channels keep resending until the client acked it
+ *
+ * @param client
+ * @param channel
+ * @param packet
+ * @return false if the packet is too large for a datagram
+ */
+bool Server::sendChannel(Client* client, ChannelType channel, const IPacket& packet) {
+    if (!client->connected) return false;
+    if (!channelOf(*client).send(channel, packet)) return false;
+
+    // the bytes are counted when the channel puts its datagrams out
+    client->stats.countOut(packet.type(), 0);
+    return true;
+}
+
+/**
+ *
+ * The message channels of a client, created on first use
+ *
+ * @param client
+ * @return
+ */
+ChannelEndpoint& Server::channelOf(Client& client) {
+    if (!client.channel) {
+        client.channel = std::make_unique<ChannelEndpoint>();
+        client.channel->setRttHistogram(&mRttHistogram);
+    }
+    return *client.channel;
+}
@@ -0,0 +1,290 @@
+#include "network/server_shard.h"
+
+#include "network/packets.h"
+
+ServerShard::ServerShard(int index)
+    : mCommands(4096), mEvents(8192), mRecycled(1024) {
+    mIndex = index;
+    mReadable.reserve(64);
+}
+
+ServerShard::~ServerShard() {
+    stop();
+
+    for (auto& [id, conn] : mConnections) {
+        closeConnection(conn);
+    }
+    mConnections.clear();
+}
+
+void ServerShard::start() {
+    if (mRunning) return;
+
+    mRunning = true;
+    mThread = std::thread(&ServerShard::run, this);
+}
+
+/**
+ *
+ * Stop the worker. Commands that were queued before this call are still handled, so a REMOVE
+ * right before stop() still gets its last bytes out
+ *
+ */
+void ServerShard::stop() {
+    mRunning = false;
+    if (mThread.joinable()) mThread.join();
+}
+
+/**
+ *
+ * Wait until the worker took the command. The queues are sized so this only spins under extreme load
+ *
+ * @param command
+ */
+void ServerShard::pushCommand(Command&& command) {
+    while (!mCommands.push(std::move(command))) {
+        std::this_thread::yield();
+    }
+}
+
+/**
+ *
+ * Hand an accepted socket to this worker. From now on only the worker reads, writes or closes it
+ *
+ * @param id
+ * @param generation reported back with every event of this connection
+ * @param sock
+ */
+void ServerShard::addClient(int id, uint32_t generation, Socket sock) {
+    Command command{};
+    command.kind = Command::Kind::ADD;
+    command.clientId = id;
+    command.generation = generation;
+    command.sock = sock;
+    pushCommand(std::move(command));
+}
+
+/**
+ *
+ * Move a client's framed output to the worker. bytes is swapped for an empty buffer the worker
+ * already sent and handed back, so the queue does not allocate once it is warm
+ *
+ * @param id
+ * @param bytes output queue of the client, empty afterwards
+ */
+void ServerShard::send(int id, std::vector<uint8_t>& bytes) {
+    if (bytes.empty()) return;
+
+    Command command{};
+    command.kind = Command::Kind::SEND;
+    command.clientId = id;
+    command.bytes = std::move(bytes);
+    pushCommand(std::move(command));
+
+    bytes.clear();
+    if (mRecycled.pop(bytes)) bytes.clear();
+}
+
+/**
+ *
+ * Flush whatever the worker still has for this client, then close the socket
+ *
+ * @param id
+ */
+void ServerShard::removeClient(int id) {
+    Command command{};
+    command.kind = Command::Kind::REMOVE;
+    command.clientId = id;
+    pushCommand(std::move(command));
+}
+
+bool ServerShard::poll(Event& out) {
+    return mEvents.pop(out);
+}
+
+void ServerShard::handleCommand(Command& command) {
+    switch (command.kind) {
+        case Command::Kind::ADD: {
+            Connection& conn = mConnections[command.clientId];
+            conn.id = command.clientId;
+            conn.generation = command.generation;
+            conn.sock = command.sock;
+
+            if (mReactor.add(conn.sock, static_cast<uint64_t>(conn.id)) != Net::Result::NET_OK) {
+                conn.closed = true;
+                mUnreported.emplace_back(conn.id, conn.generation);
+                break;
+            }
+
+            // data may already be waiting, the edge for it happened before we registered
+            conn.readable = true;
+            mReadable.push_back(conn.id);
+            break;
+        }
+        case Command::Kind::SEND: {
+            auto it = mConnections.find(command.clientId);
+            if (it == mConnections.end() || it->second.closed) break;
+
+            Connection& conn = it->second;
+            if (conn.out.empty()) {
+                conn.out.swap(command.bytes);
+            } else {
+                conn.out.insert(conn.out.end(), command.bytes.begin(), command.bytes.end());
+            }
+
+            flushConnection(conn);
+            break;
+        }
+        case Command::Kind::REMOVE: {
+            auto it = mConnections.find(command.clientId);
+            if (it == mConnections.end()) break;
+
+            closeConnection(it->second);
+            mConnections.erase(it);
+            break;
+        }
+    }
+
+    // give the buffer back to the simulation thread, if its queue is full the buffer is simply freed
+    if (command.bytes.capacity() > 0) {
+        command.bytes.clear();
+        mRecycled.push(std::move(command.bytes));
+    }
+}
+
+/**
+ *
+ * Decode packets until the socket is drained or the event queue is full
+ *
+ * @param conn
+ */
+void ServerShard::readConnection(Connection& conn) {
+    if (!conn.stalled.empty()) {
+        Event event{Event::Kind::PACKET, conn.id, conn.generation, conn.stalled};
+        if (!mEvents.push(std::move(event))) return;
+        conn.stalled.reset();
+    }
+
+    AnyPacket packet;
+    while (conn.readable && !conn.closed) {
+        Net::Result res = PacketIO::receivePacket(conn.sock, conn.in, packet);
+
+        if (res == Net::Result::NET_DISCONNECTED) {
+            conn.closed = true;
+            mReactor.remove(conn.sock);
+            mUnreported.emplace_back(conn.id, conn.generation);
+            return;
+        }
+        if (res == Net::Result::NET_WOULDBLOCK) {
+            // drained, the reactor will report the next edge
+            conn.readable = false;
+            return;
+        }
+        if (res != Net::Result::NET_OK) {
+            // a malformed frame was skipped, keep going until the socket is drained
+            continue;
+        }
+        if (packet.empty()) {
+            continue;
+        }
+
+        mPacketsDecoded.fetch_add(1, std::memory_order_relaxed);
+
+        Event event{Event::Kind::PACKET, conn.id, conn.generation, packet};
+        if (!mEvents.push(std::move(event))) {
+            // simulation is behind, keep the packet and stop reading until it caught up
+            conn.stalled = packet;
+            return;
+        }
+    }
+}
+
+void ServerShard::flushConnection(Connection& conn) {
+    if (conn.out.empty() || conn.closed) return;
+
+    Net::Result res = PacketIO::flush(conn.sock, conn.out);
+    if (res != Net::Result::NET_OK && res != Net::Result::NET_WOULDBLOCK) {
+        conn.out.clear();
+        return;
+    }
+
+    if (conn.out.size() > SERVER_OUT_HIGH_WATER && !conn.slowReported) {
+        Event event{Event::Kind::SLOW, conn.id, conn.generation, {}};
+        if (mEvents.push(std::move(event))) conn.slowReported = true;
+    }
+}
+
+void ServerShard::closeConnection(Connection& conn) {
+    if (!conn.closed) {
+        // best effort, the disconnect packet is usually the last thing queued
+        PacketIO::flush(conn.sock, conn.out);
+        mReactor.remove(conn.sock);
+        conn.closed = true;
+    }
+
+    Socket::close(conn.sock);
+    conn.out.clear();
+    conn.in.clear();
+    conn.stalled.reset();
+}
+
+/**
+ *
+ * Worker loop: take commands from the simulation thread, wait on the reactor for at most a millisecond,
+ * then read every ready socket and flush the ones that became writable
+ *
+ */
+void ServerShard::run() {
+    Command command;
+    std::vector<int> pending;
+
+    while (true) {
+        const bool running = mRunning;
+
+        while (mCommands.pop(command)) {
+            handleCommand(command);
+        }
+
+        if (!running) break;
+
+        // disconnects must reach the simulation thread, keep trying until there is room
+        for (size_t i = 0; i < mUnreported.size();) {
+            Event event{Event::Kind::DISCONNECTED, mUnreported[i].first, mUnreported[i].second, {}};
+            if (!mEvents.push(std::move(event))) break;
+            mUnreported[i] = mUnreported.back();
+            mUnreported.pop_back();
+        }
+
+        int count = 0;
+        if (mReactor.wait(mReadable.empty() ? 1 : 0, &count) != Net::Result::NET_OK) count = 0;
+
+        const NetReactor::Event* events = mReactor.events();
+        for (int i = 0; i < count; i++) {
+            const NetReactor::Event& ev = events[i];
+
+            auto it = mConnections.find(static_cast<int>(ev.key));
+            if (it == mConnections.end() || it->second.closed) continue;
+
+            Connection& conn = it->second;
+            if (ev.writable) flushConnection(conn);
+            if ((ev.readable || ev.hangup) && !conn.readable) {
+                conn.readable = true;
+                mReadable.push_back(conn.id);
+            }
+        }
+
+        pending.swap(mReadable);
+        mReadable.clear();
+
+        for (int id : pending) {
+            auto it = mConnections.find(id);
+            if (it == mConnections.end() || it->second.closed) continue;
+
+            Connection& conn = it->second;
+            readConnection(conn);
+
+            if (!conn.closed && (conn.readable || !conn.stalled.empty())) mReadable.push_back(id);
+        }
+        pending.clear();
+    }
+}
@@ -0,0 +1,211 @@
+#include "network/snapshot_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+SnapshotBuffer::SnapshotBuffer(int maxPlayers) {
+    mIndexOf.assign(std::max(maxPlayers, 0), -1);
+}
+
+/**
+ *
+ * Add the newest known state of a player, adding the player the first time
+ *
+ * @param id
+ * @param sequence sender sequence from the datagram
+ * @param x
+ * @param y
+ * @param arrivalMs local clock
+ * @return false if the snapshot is stale or the id out of range
+ */
+bool SnapshotBuffer::push(int id, uint16_t sequence, int32_t x, int32_t y, double arrivalMs) {
+    if (id < 0 || id >= static_cast<int>(mIndexOf.size())) return false;
+
+    int index = mIndexOf[id];
+    if (index == -1) {
+        index = static_cast<int>(mIds.size());
+        mIndexOf[id] = index;
+        mIds.push_back(id);
+        mRings.emplace_back();
+        mTimelines.push_back(Timeline{arrivalMs, mInterval, sequence, arrivalMs, 0});
+        mRenderX.push_back(static_cast<float>(x));
+        mRenderY.push_back(static_cast<float>(y));
+    } else {
+        Timeline& timeline = mTimelines[index];
+
+        const uint16_t steps = static_cast<uint16_t>(sequence - timeline.lastSequence);
+        if (steps == 0 || steps > 32768) {
+            mStale++;
+            return false;
+        }
+
+        const double predicted = timeline.lastTime + steps * timeline.interval;
+        const double deviation = arrivalMs - predicted;
+
+        if (std::fabs(deviation) > SNAPSHOT_RESYNC_MS) {
+            timeline.lastTime = arrivalMs;
+            timeline.baseArrival = arrivalMs;
+            timeline.stepsSinceBase = 0;
+            mResyncs++;
+        } else {
+            // lost updates show up as sequence steps, not as a longer interval
+            timeline.stepsSinceBase += steps;
+            if (timeline.stepsSinceBase >= 8) {
+                const double measured = (arrivalMs - timeline.baseArrival) / timeline.stepsSinceBase;
+                timeline.interval = std::clamp(measured, 1.0, SNAPSHOT_RESYNC_MS);
+            }
+            if (timeline.stepsSinceBase >= SNAPSHOT_INTERVAL_WINDOW) {
+                // start over from where the timeline is, so the sender may change its rate
+                timeline.baseArrival = predicted;
+                timeline.stepsSinceBase = 0;
+            }
+
+            mInterval += (timeline.interval - mInterval) / 16.0;
+            mJitter += (std::fabs(deviation) - mJitter) / 16.0;
+
+            // the timeline follows arrivals slowly, so clock drift between the peers does not pile up
+            timeline.lastTime = std::max(predicted + deviation / 10.0, timeline.lastTime + 0.001);
+        }
+
+        timeline.lastSequence = sequence;
+    }
+
+    Ring& ring = mRings[index];
+    const uint32_t slot = ring.head & (SNAPSHOT_RING - 1);
+    ring.time[slot] = mTimelines[index].lastTime;
+    ring.x[slot] = static_cast<float>(x);
+    ring.y[slot] = static_cast<float>(y);
+    ring.head++;
+    ring.count = std::min<uint32_t>(ring.count + 1, SNAPSHOT_RING);
+
+    mReceived++;
+    return true;
+}
+
+/**
+ *
+ * Forget a player, it left or went out of range
+ *
+ * @param id
+ */
+void SnapshotBuffer::remove(int id) {
+    if (!has(id)) return;
+
+    const int index = mIndexOf[id];
+    const int last = static_cast<int>(mIds.size()) - 1;
+
+    // keep the arrays dense, the last player takes the free index
+    if (index != last) {
+        mIds[index] = mIds[last];
+        mRings[index] = mRings[last];
+        mTimelines[index] = mTimelines[last];
+        mRenderX[index] = mRenderX[last];
+        mRenderY[index] = mRenderY[last];
+        mIndexOf[mIds[index]] = index;
+    }
+
+    mIds.pop_back();
+    mRings.pop_back();
+    mTimelines.pop_back();
+    mRenderX.pop_back();
+    mRenderY.pop_back();
+    mIndexOf[id] = -1;
+}
+
+void SnapshotBuffer::clear() {
+    for (const int id : mIds) mIndexOf[id] = -1;
+    mIds.clear();
+    mRings.clear();
+    mTimelines.clear();
+    mRenderX.clear();
+    mRenderY.clear();
+}
+
+/**
+ *
+ * Move the playback delay towards its target and compute where every remote player is drawn this frame
+ *
+ * @param nowMs local clock, same one the snapshots were pushed with
+ */
+void SnapshotBuffer::sample(double nowMs) {
+    const double elapsed = mLastSampleMs < 0 ? 0 : std::max(nowMs - mLastSampleMs, 0.0);
+    mLastSampleMs = nowMs;
+
+    const double maxStep = elapsed * 0.1;
+    mDelay += std::clamp(targetDelay() - mDelay, -maxStep, maxStep);
+
+    const double renderTime = nowMs - mDelay;
+    mExtrapolated = 0;
+    mStarved = 0;
+
+    for (size_t i = 0; i < mIds.size(); i++) {
+        const Ring& ring = mRings[i];
+        const uint32_t newest = (ring.head - 1) & (SNAPSHOT_RING - 1);
+
+        if (renderTime >= ring.time[newest]) {
+            if (ring.count < 2) {
+                mRenderX[i] = ring.x[newest];
+                mRenderY[i] = ring.y[newest];
+                continue;
+            }
+
+            const uint32_t previous = (ring.head - 2) & (SNAPSHOT_RING - 1);
+            const double span = ring.time[newest] - ring.time[previous];
+            double ahead = renderTime - ring.time[newest];
+
+            mExtrapolated++;
+            if (ahead > SNAPSHOT_MAX_EXTRAPOLATION_MS) {
+                ahead = SNAPSHOT_MAX_EXTRAPOLATION_MS;
+                mStarved++;
+            }
+
+            // a burst can leave two snapshots almost on the same time, so the step is capped at what the
+            // measured interval allows and a timeline that jumped back on a resync is not extrapolated at all
+            const double limit = SNAPSHOT_MAX_EXTRAPOLATION_MS / mTimelines[i].interval;
+            const float t = static_cast<float>(span > 0 ? std::min(ahead / span, limit) : 0.0);
+            mRenderX[i] = ring.x[newest] + (ring.x[newest] - ring.x[previous]) * t;
+            mRenderY[i] = ring.y[newest] + (ring.y[newest] - ring.y[previous]) * t;
+            continue;
+        }
+
+        // walk back from the newest one, the render time is usually one or two snapshots behind
+        uint32_t later = newest;
+        bool found = false;
+        for (uint32_t k = 1; k < ring.count; k++) {
+            const uint32_t earlier = (ring.head - 1 - k) & (SNAPSHOT_RING - 1);
+            if (ring.time[earlier] <= renderTime) {
+                const float t = static_cast<float>((renderTime - ring.time[earlier]) / (ring.time[later] - ring.time[earlier]));
+                mRenderX[i] = ring.x[earlier] + (ring.x[later] - ring.x[earlier]) * t;
+                mRenderY[i] = ring.y[earlier] + (ring.y[later] - ring.y[earlier]) * t;
+                found = true;
+                break;
+            }
+            later = earlier;
+        }
+
+        // older than anything kept, the player just appeared
+        if (!found) {
+            mRenderX[i] = ring.x[later];
+            mRenderY[i] = ring.y[later];
+        }
+    }
+}
+
+SnapshotStats SnapshotBuffer::stats() const {
+    SnapshotStats stats{};
+    stats.players = mIds.size();
+    stats.extrapolated = mExtrapolated;
+    stats.starved = mStarved;
+    stats.received = mReceived;
+    stats.stale = mStale;
+    stats.resyncs = mResyncs;
+    stats.intervalMs = mInterval;
+    stats.jitterMs = mJitter;
+    stats.delayMs = mDelay;
+    stats.targetDelayMs = targetDelay();
+    return stats;
+}
+
+double SnapshotBuffer::targetDelay() const {
+    return std::clamp(mInterval + SNAPSHOT_JITTER_FACTOR * mJitter, SNAPSHOT_MIN_DELAY_MS, SNAPSHOT_MAX_DELAY_MS);
+}
@@ -0,0 +1,51 @@
+#include "network/stream_buffer.h"
+
+#include <cstring>
+
+StreamBuffer::StreamBuffer(size_t capacity) {
+    mData.resize(capacity);
+}
+
+void StreamBuffer::consume(size_t n) {
+    mBegin += n;
+
+    // empty again, start over at the front for free
+    if (mBegin >= mEnd) {
+        mBegin = 0;
+        mEnd = 0;
+    }
+}
+
+/**
+ *
+ * Make sure a frame of the given size fits once the buffer is compacted. Only grows for frames
+ * larger than anything seen so far
+ *
+ * @param frameSize header + payload
+ */
+void StreamBuffer::reserve(size_t frameSize) {
+    if (frameSize > mData.size()) {
+        compact();
+        mData.resize(frameSize);
+    }
+}
+
+/**
+ *
+ * Move the unread bytes to the front so the back has room for the next read
+ *
+ */
+void StreamBuffer::compact() {
+    if (mBegin == 0) return;
+
+    const size_t n = readable();
+    if (n > 0) std::memmove(mData.data(), mData.data() + mBegin, n);
+
+    mBegin = 0;
+    mEnd = n;
+}
+
+void StreamBuffer::clear() {
+    mBegin = 0;
+    mEnd = 0;
+}
@@ -1,5 +1,80 @@
 #include "player.h"
 
-Player::Player() {
+#include "raylib.h"
+#include "manager/client_manager.h"
+#include "manager/console_manager.h"
+#include "player_movement.h"
 
-}
\ No newline at end of file
+Player::Player() : mPosX(0), mPozY(0) {
+
+}
+
+/**
+ *
+ * Turn the held move actions into fixed input steps, the client predicts and sends each of them
+ *
+ * @param frameTime seconds since the last frame
+ */
+void Player::update(float frameTime) {
+    if (!ClientManager::has() || ClientManager::get().mState != NetState::READY) {
+        mInputTime = 0;
+        return;
+    }
+
+    Client& client = ClientManager::get();
+    InputManager* input = InputManager::get();
+
+    // keys typed into the console are not meant for the player
+    const bool typing = ConsoleManager::has() && ConsoleManager::get().isOpen();
+
+    if (!typing && input->isPressed("net_overlay")) mShowOverlay = !mShowOverlay;
+
+    uint8_t buttons = 0;
+    if (!typing) {
+        if (input->isHeld("move_up")) buttons |= static_cast<uint8_t>(PlayerButton::BTN_UP);
+        if (input->isHeld("move_down")) buttons |= static_cast<uint8_t>(PlayerButton::BTN_DOWN);
+        if (input->isHeld("move_left")) buttons |= static_cast<uint8_t>(PlayerButton::BTN_LEFT);
+        if (input->isHeld("move_right")) buttons |= static_cast<uint8_t>(PlayerButton::BTN_RIGHT);
+    }
+
+    const double step = 1.0 / PLAYER_INPUT_RATE;
+    mInputTime += frameTime;
+
+    int steps = 0;
+    while (mInputTime >= step && steps < PLAYER_MAX_STEPS_PER_FRAME) {
+        client.sendInput(buttons);
+        mInputTime -= step;
+        steps++;
+    }
+    if (steps == PLAYER_MAX_STEPS_PER_FRAME) mInputTime = 0;
+
+    mPosX = client.mPrediction.getX();
+    mPozY = client.mPrediction.getY();
+}
+
+/**
+ *
+ * Draw the local player at its predicted position, with the prediction overlay if toggled
+ *
+ */
+void Player::draw() {
+    if (!ClientManager::has() || ClientManager::get().mState != NetState::READY) return;
+
+    DrawRectangle(mPosX - 8, mPozY - 8, 16, 16, RED);
+
+    if (!mShowOverlay) return;
+
+    const Prediction& prediction = ClientManager::get().mPrediction;
+    const PredictionStats stats = prediction.stats();
+
+    // where the server last had us, the gap to the red one is what is still unconfirmed
+    DrawRectangleLines(prediction.getServerX() - 8, prediction.getServerY() - 8, 16, 16, DARKGRAY);
+
+    DrawText(TextFormat("rtt %.0f ms, %d / %d inputs pending, %d dropped", stats.rttMs,
+        static_cast<int>(stats.pending), static_cast<int>(stats.capacity), static_cast<int>(stats.dropped)),
+        10, 80, 20, DARKGRAY);
+    DrawText(TextFormat("correction %.1f (max %.1f), %d replayed, %d of %d acks corrected", stats.lastCorrection,
+        stats.maxCorrection, static_cast<int>(stats.lastReplayed), static_cast<int>(stats.corrections),
+        static_cast<int>(stats.acks)),
+        10, 105, 20, stats.lastCorrection > 0 ? ORANGE : DARKGRAY);
+}
@@ -0,0 +1,197 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "manager/console_manager.h"
+#include "manager/server_manager.h"
+#include "network/packets.h"
+#include "util/net.h"
+#include "util/resolver.h"
+
+// Players a dedicated server takes unless --max-clients says otherwise
+#define SERVER_DEFAULT_MAX_CLIENTS 64
+// How often the main thread looks at stdin commands, resolver callbacks and signals
+#define SERVER_MAIN_WAIT_MS 50
+
+static std::atomic<bool> gQuit{false};
+
+// stdin lines waiting for the main thread, commands touch the managers and must not run on the reader
+static std::mutex gLinesMutex;
+static std::condition_variable gLinesReady;
+static std::deque<std::string> gLines;
+
+static void onSignal(int) {
+    gQuit = true;
+}
+
+static void printUsage(const char* program) {
+    std::fprintf(stderr,
+        "Usage: %s <ip> <port> [options]\n"
+        "  --max-clients <n>        players at most (default %d, up to %d)\n"
+        "  --transport <name>       syscall (default) or uring\n"
+        "  --workers <n>            io worker threads, 0 keeps client io on the tick thread\n"
+        "  --tick-rate <hz>         simulation rate (default %.0f)\n"
+        "  --log <file>             also append the log to a file\n"
+        "Console commands are read from stdin, `quit` or SIGINT / SIGTERM stops the server.\n",
+        program, SERVER_DEFAULT_MAX_CLIENTS, PLAYER_ID_MAX + 1, TICK_DEFAULT_RATE);
+}
+
+/**
+ *
+ * Read console commands from stdin until it closes. A server started without a terminal keeps running
+ *
+ */
+static void readCommands() {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        {
+            std::lock_guard lock(gLinesMutex);
+            gLines.push_back(std::move(line));
+        }
+        gLinesReady.notify_one();
+    }
+}
+
+//------------------------------------------------------------------------------------
+// Dedicated server entry point, no window, audio or input
+//------------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const char* host = argv[1];
+    uint16_t port = 0;
+    if (!Net::parsePort(argv[2], port)) {
+        std::fprintf(stderr, "Invalid port: %s\n", argv[2]);
+        return 1;
+    }
+
+    int maxClients = SERVER_DEFAULT_MAX_CLIENTS;
+    int workers = 0;
+    double tickRate = TICK_DEFAULT_RATE;
+    Net::Transport transport = Net::Transport::NET_SYSCALL;
+    const char* logPath = nullptr;
+
+    for (int i = 3; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+
+        if (std::strcmp(argv[i], "--max-clients") == 0 && hasValue) {
+            maxClients = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--workers") == 0 && hasValue) {
+            workers = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--tick-rate") == 0 && hasValue) {
+            tickRate = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--log") == 0 && hasValue) {
+            logPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--transport") == 0 && hasValue) {
+            const char* name = argv[++i];
+            if (std::strcmp(name, "uring") == 0) {
+                transport = Net::Transport::NET_URING;
+            } else if (std::strcmp(name, "syscall") != 0) {
+                std::fprintf(stderr, "Unknown transport: %s\n", name);
+                return 1;
+            }
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (maxClients < 1 || workers < 0 || workers > 64) {
+        std::fprintf(stderr, "Max clients must be at least 1, workers between 0 and 64\n");
+        return 1;
+    }
+
+    // Initialization
+    //--------------------------------------------------------------------------------------
+    Net::init();
+    Console& console = ConsoleManager::create();
+
+    if (logPath && !console.openLogFile(logPath)) {
+        console.log(WARNING, "Could not open log file %s, logging to stdout only", logPath);
+    }
+
+    console.getRegistry()->registerCommand({
+        "quit",
+        "Stop the server and exit",
+
+        {},
+
+        [](const ParsedArgs&) {
+            gQuit = true;
+        }
+    });
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    Net::Address address{};
+    if (Net::resolve(host, port, address) != Net::Result::NET_OK) {
+        console.log(FATAL, "Could not resolve %s", host);
+        return 1;
+    }
+
+    Server& server = ServerManager::create(address, maxClients, transport, workers);
+    if (!server.isListening()) {
+        ServerManager::stop();
+        return 1;
+    }
+
+    server.setTickRate(tickRate);
+    server.run();
+    console.log(INFO, "Listening on %s:%u, %d players, %.0f Hz", host, port, maxClients, server.getTickRate());
+
+    // the reader may be blocked in getline at exit, nothing waits for it
+    std::thread(readCommands).detach();
+    //--------------------------------------------------------------------------------------
+
+    // Main loop, the server ticks on its own thread
+    while (!gQuit) {
+        std::deque<std::string> lines;
+        {
+            std::unique_lock lock(gLinesMutex);
+            gLinesReady.wait_for(lock, std::chrono::milliseconds(SERVER_MAIN_WAIT_MS), [] { return !gLines.empty(); });
+            lines.swap(gLines);
+        }
+
+        for (const std::string& line : lines) {
+            console.execute(line);
+        }
+
+        // finished hostname lookups from console commands
+        Resolver::dispatch();
+
+        if (!ServerManager::has()) {
+            console.log(INFO, "The server was stopped, exiting");
+            break;
+        }
+    }
+
+    // De-Initialization
+    //--------------------------------------------------------------------------------------
+    if (ServerManager::has()) {
+        ServerManager::stop();
+    }
+    console.log(INFO, "Server shut down");
+
+    ConsoleManager::destroy();
+    Net::shutdown();
+    //--------------------------------------------------------------------------------------
+
+    return 0;
+}
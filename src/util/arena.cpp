@@ -0,0 +1,107 @@
+#include "util/arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+Arena::Arena(size_t blockSize) {
+    mBlockSize = std::max<size_t>(blockSize, 256);
+    mBlocks.reserve(8);
+}
+
+Arena::~Arena() {
+    reset();
+}
+
+void Arena::addBlock(size_t minimum) {
+    const size_t last = mBlocks.empty() ? mBlockSize / 2 : mBlocks.back().size;
+    const size_t size = std::max(minimum, last * 2);
+
+    mBlocks.push_back(Block{std::make_unique<uint8_t[]>(size), size});
+    mCurrent = mBlocks.size() - 1;
+    mOffset = 0;
+
+    mStats.capacity += size;
+    mStats.blockAllocations++;
+    mTickAllocations++;
+}
+
+/**
+ *
+ * Carve memory out of the arena. It stays valid until the next reset()
+ *
+ * @param size
+ * @param align power of two
+ * @return never null
+ */
+void* Arena::allocate(size_t size, size_t align) {
+    while (true) {
+        if (mCurrent < mBlocks.size()) {
+            Block& block = mBlocks[mCurrent];
+            const uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+            const uintptr_t aligned = (base + mOffset + (align - 1)) & ~(static_cast<uintptr_t>(align) - 1);
+            const size_t end = static_cast<size_t>(aligned - base) + size;
+
+            if (end <= block.size) {
+                mStats.used += end - mOffset;
+                mOffset = end;
+                return reinterpret_cast<void*>(aligned);
+            }
+
+            // a later block that is already there, left over from a reset
+            if (mCurrent + 1 < mBlocks.size()) {
+                mCurrent++;
+                mOffset = 0;
+                continue;
+            }
+        }
+
+        addBlock(size + align);
+    }
+}
+
+/**
+ *
+ * Copy a payload into the arena
+ *
+ * @param data
+ * @param size
+ * @return the copy, valid until the next reset()
+ */
+uint8_t* Arena::copy(const void* data, size_t size) {
+    uint8_t* out = static_cast<uint8_t*>(allocate(size, 1));
+    if (size > 0) std::memcpy(out, data, size);
+    return out;
+}
+
+/**
+ *
+ * Release everything handed out since the last reset. Called once at the end of every tick
+ *
+ */
+void Arena::reset() {
+    for (Destructor* d = mDestructors; d; d = d->next) {
+        d->destroy(d->object);
+    }
+    mDestructors = nullptr;
+
+    mStats.peak = std::max(mStats.peak, mStats.used);
+
+    // the tick did not fit one block, next time it will
+    if (mBlocks.size() > 1) {
+        size_t total = 0;
+        for (const Block& block : mBlocks) total += block.size;
+
+        mBlocks.clear();
+        mStats.capacity = 0;
+        addBlock(total);
+    }
+
+    mCurrent = 0;
+    mOffset = 0;
+
+    mStats.used = 0;
+    mStats.objects = 0;
+    mStats.resets++;
+    mStats.lastTickAllocations = mTickAllocations;
+    mTickAllocations = 0;
+}
@@ -32,3 +32,33 @@ std::vector<std::string> CompleteReloadNames(std::string_view prefix) {
 
     return out;
 }
+
+std::vector<std::string> CompleteTransportNames(std::string_view prefix) {
+    std::vector<std::string> out;
+
+    std::vector<std::string> registry = {
+        "syscall",
+        "uring"
+    };
+
+    for (const auto& name : registry) {
+        if (name.starts_with(prefix)) out.push_back(name);
+    }
+
+    return out;
+}
+
+std::vector<std::string> CompleteTickPolicies(std::string_view prefix) {
+    std::vector<std::string> out;
+
+    std::vector<std::string> registry = {
+        "catchup",
+        "drop"
+    };
+
+    for (const auto& name : registry) {
+        if (name.starts_with(prefix)) out.push_back(name);
+    }
+
+    return out;
+}
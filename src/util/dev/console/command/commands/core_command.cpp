@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstdio>
 #include <thread>
 
 #include "manager/client_manager.h"
@@ -7,9 +9,50 @@
 #include "network/packets.h"
 #include "network/server.h"
 #include "network/packets/connect_packet.h"
+#include "network/packets/player_join_packet.h"
+#include "network/packets/player_update_packet.h"
 #include "util/dev/console/console.h"
 #include "util/dev/console/command/auto_completion.h"
 #include "util/dev/console/command/registry.h"
+#include "util/net_sim.h"
+#include "util/resolver.h"
+
+// Clients netstat lists, the ones sending the most first
+static constexpr size_t NETSTAT_TOP_CLIENTS = 8;
+
+// Network condition arguments shared by the netsim commands, missing ones keep their value from base
+static const std::vector<CommandArg> NETSIM_ARGS = {
+    {"latency", ArgType::FLOAT, true},
+    {"jitter", ArgType::FLOAT, true},
+    {"loss", ArgType::FLOAT, true},
+    {"duplicate", ArgType::FLOAT, true},
+    {"reorder", ArgType::FLOAT, true},
+    {"bandwidth", ArgType::INT, true}
+};
+
+static bool ReadNetSimProfile(const ParsedArgs& args, NetSimProfile& profile) {
+    if (args.values.contains("latency")) profile.latencyMs = std::get<float>(args.values.at("latency"));
+    if (args.values.contains("jitter")) profile.jitterMs = std::get<float>(args.values.at("jitter"));
+    if (args.values.contains("loss")) profile.lossPercent = std::get<float>(args.values.at("loss"));
+    if (args.values.contains("duplicate")) profile.duplicatePercent = std::get<float>(args.values.at("duplicate"));
+    if (args.values.contains("reorder")) profile.reorderPercent = std::get<float>(args.values.at("reorder"));
+    if (args.values.contains("bandwidth")) {
+        const int kbps = std::get<int>(args.values.at("bandwidth"));
+        if (kbps < 0) return false;
+        profile.bandwidthKbps = static_cast<uint32_t>(kbps);
+    }
+
+    return profile.latencyMs >= 0 && profile.jitterMs >= 0 &&
+           profile.lossPercent >= 0 && profile.lossPercent <= 100 &&
+           profile.duplicatePercent >= 0 && profile.duplicatePercent <= 100 &&
+           profile.reorderPercent >= 0 && profile.reorderPercent <= 100;
+}
+
+static void LogNetSimProfile(const char* name, const NetSimProfile& profile) {
+    ConsoleManager::get().log(INFO, "%s: latency %.1f ms, jitter %.1f ms, loss %.2f%%, duplicate %.2f%%, reorder %.2f%%, bandwidth %s",
+        name, profile.latencyMs, profile.jitterMs, profile.lossPercent, profile.duplicatePercent, profile.reorderPercent,
+        profile.bandwidthKbps == 0 ? "unlimited" : (std::to_string(profile.bandwidthKbps) + " kbit/s").c_str());
+}
 
 void RegisterCoreCommands(CommandRegistry& registry) {
 
@@ -19,7 +62,9 @@ void RegisterCoreCommands(CommandRegistry& registry) {
 
         {
             {"ip", ArgType::STRING, false},
-            {"port", ArgType::UINT16_T, false}
+            {"port", ArgType::UINT16_T, false},
+            {"transport", ArgType::STRING, true, CompleteTransportNames},
+            {"workers", ArgType::INT, true}
         },
 
         [](const ParsedArgs& args) {
@@ -31,10 +76,90 @@ void RegisterCoreCommands(CommandRegistry& registry) {
             std::string ip = std::get<std::string>(args.values.at("ip"));
             uint16_t port = std::get<uint16_t>(args.values.at("port"));
 
-            const Net::Address addressServer = Net::resolveAddress(ip.c_str(), port);
+            Net::Transport transport = Net::Transport::NET_SYSCALL;
+            if (args.values.contains("transport")) {
+                const std::string& name = std::get<std::string>(args.values.at("transport"));
+                if (name == "uring") {
+                    transport = Net::Transport::NET_URING;
+                } else if (name != "syscall") {
+                    ConsoleManager::get().log(FATAL, "Unknown transport: %s", name.c_str());
+                    return;
+                }
+            }
+
+            int workers = 0;
+            if (args.values.contains("workers")) {
+                workers = std::get<int>(args.values.at("workers"));
+                if (workers < 0 || workers > 64) {
+                    ConsoleManager::get().log(FATAL, "Workers must be between 0 and 64");
+                    return;
+                }
+            }
+
+            Resolver::resolve(ip, port, [ip, transport, workers](Net::Result result, Net::Address addressServer) {
+                if (result != Net::Result::NET_OK) {
+                    ConsoleManager::get().log(FATAL, "Could not resolve %s", ip.c_str());
+                    return;
+                }
+                if (ServerManager::has()) {
+                    ConsoleManager::get().log(WARNING, "A server is already active. Please shutdown that server to make a new one");
+                    return;
+                }
+
+                ServerManager::create(addressServer, 4, transport, workers);
+                ServerManager::get().run();
+            });
+        }
+    });
+
+    registry.registerCommand({
+        "tick_rate",
+        "Set the tick rate of the active server and what happens to ticks it can not run in time",
+
+        {
+            {"rate", ArgType::FLOAT, false},
+            {"policy", ArgType::STRING, true, CompleteTickPolicies}
+        },
+
+        [](const ParsedArgs& args) {
+            if (!ServerManager::has()) {
+                ConsoleManager::get().log(WARNING, "There is no active server");
+                return;
+            }
+
+            const float rate = std::get<float>(args.values.at("rate"));
+            if (rate < TICK_MIN_RATE || rate > TICK_MAX_RATE) {
+                ConsoleManager::get().log(FATAL, "Tick rate must be between %.0f and %.0f", TICK_MIN_RATE, TICK_MAX_RATE);
+                return;
+            }
+
+            Server& server = ServerManager::get();
+
+            if (args.values.contains("policy")) {
+                const std::string& name = std::get<std::string>(args.values.at("policy"));
+                if (name == "catchup") {
+                    server.setTickPolicy(TickPolicy::TICK_CATCH_UP);
+                } else if (name == "drop") {
+                    server.setTickPolicy(TickPolicy::TICK_DROP);
+                } else {
+                    ConsoleManager::get().log(FATAL, "Unknown tick policy: %s", name.c_str());
+                    return;
+                }
+            }
 
-            ServerManager::create(addressServer, 4);
-            ServerManager::get().run();
+            server.setTickRate(rate);
+
+            ConsoleManager::get().log(INFO, "Server ticks at %.1f Hz (%s), tick %llu, %llu dropped", server.getTickRate(),
+                server.getTickPolicy() == TickPolicy::TICK_DROP ? "drop" : "catchup",
+                static_cast<unsigned long long>(server.getTick()),
+                static_cast<unsigned long long>(server.getDroppedTicks()));
+
+            const Server::TickTimeStats time = server.getTickTimeStats();
+            if (time.ticks > 0) {
+                ConsoleManager::get().log(INFO, "Tick time avg %.3f ms, max %.3f ms over %llu ticks",
+                    time.totalNs / 1e6 / static_cast<double>(time.ticks), time.maxNs / 1e6,
+                    static_cast<unsigned long long>(time.ticks));
+            }
         }
     });
 
@@ -56,6 +181,234 @@ void RegisterCoreCommands(CommandRegistry& registry) {
         }
     });
 
+    registry.registerCommand({
+        "interest",
+        "Set the area of interest of the active server, a range of 0 sends every update to everybody",
+
+        {
+            {"range", ArgType::INT, true},
+            {"cell", ArgType::INT, true},
+            {"hysteresis", ArgType::INT, true}
+        },
+
+        [](const ParsedArgs& args) {
+            if (!ServerManager::has()) {
+                ConsoleManager::get().log(WARNING, "There is no active server");
+                return;
+            }
+
+            Server& server = ServerManager::get();
+
+            if (!args.values.empty()) {
+                int32_t range = server.getInterestRange();
+                int32_t cell = server.getInterestCellSize();
+                int32_t hysteresis = server.getInterestHysteresis();
+
+                if (args.values.contains("range")) range = std::get<int>(args.values.at("range"));
+                if (args.values.contains("cell")) cell = std::get<int>(args.values.at("cell"));
+                if (args.values.contains("hysteresis")) hysteresis = std::get<int>(args.values.at("hysteresis"));
+
+                if (range < 0 || cell < 1 || hysteresis < 0) {
+                    ConsoleManager::get().log(FATAL, "Range and hysteresis can not be negative, cells are at least 1 unit");
+                    return;
+                }
+
+                server.setInterest(cell, range, hysteresis);
+            }
+
+            const InterestStats stats = server.getInterestStats();
+            ConsoleManager::get().log(INFO, "Interest range %d, cell %d, hysteresis %d%s", server.getInterestRange(),
+                server.getInterestCellSize(), server.getInterestHysteresis(),
+                server.getInterestRange() == 0 ? " (off)" : "");
+            ConsoleManager::get().log(INFO, "  %zu players, %zu visible pairs, last tick %llu moved, %llu checks, %llu enters, %llu leaves",
+                stats.entities, stats.visiblePairs / 2,
+                static_cast<unsigned long long>(stats.dirty),
+                static_cast<unsigned long long>(stats.pairChecks),
+                static_cast<unsigned long long>(stats.enters),
+                static_cast<unsigned long long>(stats.leaves));
+        }
+    });
+
+    registry.registerCommand({
+        "lag_history",
+        "Show how much player history the server keeps for lag compensation and what it costs",
+
+        {},
+
+        [](const ParsedArgs&) {
+            if (!ServerManager::has()) {
+                ConsoleManager::get().log(WARNING, "There is no active server");
+                return;
+            }
+
+            const LagHistoryStats stats = ServerManager::get().getLagHistoryStats();
+            ConsoleManager::get().log(INFO, "%zu frames over %.0f ms, ticks %llu to %llu, %zu players in the last one",
+                stats.frames, stats.spanMs,
+                static_cast<unsigned long long>(stats.oldestTick),
+                static_cast<unsigned long long>(stats.newestTick), stats.recorded);
+            ConsoleManager::get().log(INFO, "  %.0f bytes per player per second of history, %.1f KiB for %zu players",
+                stats.bytesPerPlayerSecond, stats.bytes / 1024.0, stats.maxPlayers);
+        }
+    });
+
+    registry.registerCommand({
+        "netsim",
+        "Simulate a bad network on everything this process sends: latency (ms, one way), jitter (ms), loss, duplicate and reorder (%), bandwidth (kbit/s)",
+
+        NETSIM_ARGS,
+
+        [](const ParsedArgs& args) {
+            NetSim& sim = NetSim::get();
+
+            if (!args.values.empty()) {
+                NetSimProfile profile = sim.isEnabled() ? sim.getProfile() : NetSimProfile{};
+                if (!ReadNetSimProfile(args, profile)) {
+                    ConsoleManager::get().log(FATAL, "Times and bandwidth can not be negative, percentages are 0 to 100");
+                    return;
+                }
+                sim.enable(profile);
+            }
+
+            if (!sim.isEnabled()) {
+                ConsoleManager::get().log(INFO, "Network simulation is off");
+                return;
+            }
+
+            LogNetSimProfile("Network simulation", sim.getProfile());
+            ConsoleManager::get().log(INFO, "  seed %llu", static_cast<unsigned long long>(sim.getSeed()));
+
+            for (const NetSimLinkStats& link : sim.links()) {
+                char peer[32] = "stream";
+                if (!link.stream) {
+                    const uint8_t* ip = reinterpret_cast<const uint8_t*>(&link.peer.ip);
+                    snprintf(peer, sizeof(peer), "udp %u.%u.%u.%u:%u", ip[0], ip[1], ip[2], ip[3], link.peer.port);
+                }
+
+                ConsoleManager::get().log(INFO, "  link %u %s%s: %llu bytes sent, %zu queued, %llu lost, %llu duplicated, %llu reordered, %llu over bandwidth",
+                    link.id, peer, link.overridden ? " (own profile)" : "",
+                    static_cast<unsigned long long>(link.sentBytes), link.queuedBytes,
+                    static_cast<unsigned long long>(link.dropped),
+                    static_cast<unsigned long long>(link.duplicated),
+                    static_cast<unsigned long long>(link.reordered),
+                    static_cast<unsigned long long>(link.overflowed));
+            }
+        }
+    });
+
+    registry.registerCommand({
+        "netsim_link",
+        "Give one link from netsim its own conditions, with only the link it follows the global ones again",
+
+        [] {
+            std::vector<CommandArg> args{{"link", ArgType::INT, false}};
+            args.insert(args.end(), NETSIM_ARGS.begin(), NETSIM_ARGS.end());
+            return args;
+        }(),
+
+        [](const ParsedArgs& args) {
+            NetSim& sim = NetSim::get();
+            if (!sim.isEnabled()) {
+                ConsoleManager::get().log(WARNING, "Network simulation is off, turn it on with netsim first");
+                return;
+            }
+
+            const int link = std::get<int>(args.values.at("link"));
+            if (args.values.size() == 1) {
+                if (link < 0 || !sim.clearLinkProfile(static_cast<uint32_t>(link))) {
+                    ConsoleManager::get().log(FATAL, "There is no link %d", link);
+                    return;
+                }
+                ConsoleManager::get().log(INFO, "Link %d follows the global conditions again", link);
+                return;
+            }
+
+            NetSimProfile profile = sim.getProfile();
+            if (!ReadNetSimProfile(args, profile)) {
+                ConsoleManager::get().log(FATAL, "Times and bandwidth can not be negative, percentages are 0 to 100");
+                return;
+            }
+            if (link < 0 || !sim.setLinkProfile(static_cast<uint32_t>(link), profile)) {
+                ConsoleManager::get().log(FATAL, "There is no link %d", link);
+                return;
+            }
+
+            LogNetSimProfile(("Link " + std::to_string(link)).c_str(), profile);
+        }
+    });
+
+    registry.registerCommand({
+        "netsim_seed",
+        "Restart the random decisions of the network simulation from a seed, so a run can be repeated",
+
+        {
+            {"seed", ArgType::INT, false}
+        },
+
+        [](const ParsedArgs& args) {
+            const int seed = std::get<int>(args.values.at("seed"));
+            NetSim::get().setSeed(static_cast<uint64_t>(static_cast<uint32_t>(seed)));
+            ConsoleManager::get().log(INFO, "Network simulation seed is %u", static_cast<uint32_t>(seed));
+        }
+    });
+
+    registry.registerCommand({
+        "netsim_off",
+        "Stop simulating network conditions, data already delayed still arrives",
+
+        {},
+
+        [](const ParsedArgs&) {
+            NetSim::get().disable();
+            ConsoleManager::get().log(INFO, "Network simulation is off");
+        }
+    });
+
+    registry.registerCommand({
+        "interpolation",
+        "Show the playback delay and jitter of the remote player interpolation",
+
+        {},
+
+        [](const ParsedArgs&) {
+            if (!ClientManager::has()) {
+                ConsoleManager::get().log(WARNING, "You are not in a server");
+                return;
+            }
+
+            const SnapshotStats stats = ClientManager::get().mRemotePlayers.stats();
+            ConsoleManager::get().log(INFO, "Delay %.1f ms (target %.1f), interval %.1f ms, jitter %.1f ms",
+                stats.delayMs, stats.targetDelayMs, stats.intervalMs, stats.jitterMs);
+            ConsoleManager::get().log(INFO, "  %zu players, %zu extrapolated, %zu starved last frame",
+                stats.players, stats.extrapolated, stats.starved);
+            ConsoleManager::get().log(INFO, "  %llu snapshots, %llu stale, %llu resyncs",
+                static_cast<unsigned long long>(stats.received),
+                static_cast<unsigned long long>(stats.stale),
+                static_cast<unsigned long long>(stats.resyncs));
+        }
+    });
+
+    registry.registerCommand({
+        "prediction",
+        "Show how often the server corrected the predicted local player, F3 shows it on screen",
+
+        {},
+
+        [](const ParsedArgs&) {
+            if (!ClientManager::has()) {
+                ConsoleManager::get().log(WARNING, "You are not in a server");
+                return;
+            }
+
+            const PredictionStats stats = ClientManager::get().mPrediction.stats();
+            ConsoleManager::get().log(INFO, "Input rtt %.1f ms, %zu / %zu inputs pending, %llu dropped",
+                stats.rttMs, stats.pending, stats.capacity, static_cast<unsigned long long>(stats.dropped));
+            ConsoleManager::get().log(INFO, "  %llu acks, %llu corrected, last %.1f units with %zu replayed, max %.1f units",
+                static_cast<unsigned long long>(stats.acks),
+                static_cast<unsigned long long>(stats.corrections),
+                stats.lastCorrection, stats.lastReplayed, stats.maxCorrection);
+        }
+    });
+
     registry.registerCommand({
         "join_server",
         "Join a active server",
@@ -75,18 +428,27 @@ void RegisterCoreCommands(CommandRegistry& registry) {
             std::string ip = std::get<std::string>(args.values.at("ip"));
             uint16_t port = std::get<uint16_t>(args.values.at("port"));
 
-            const Net::Address addressClient = Net::resolveAddress(ip.c_str(), port);
+            std::string name = std::get<std::string>(args.values.at("name"));
 
-            ClientManager::create(addressClient);
-            ClientManager::get().connect();
+            Resolver::resolve(ip, port, [ip, name](Net::Result result, Net::Address addressClient) {
+                if (result != Net::Result::NET_OK) {
+                    ConsoleManager::get().log(FATAL, "Could not resolve %s", ip.c_str());
+                    return;
+                }
+                if (ClientManager::has()) {
+                    ConsoleManager::get().log(WARNING, "You are already in a server. Please leave your current server before joining a new one");
+                    return;
+                }
 
-            std::string name = std::get<std::string>(args.values.at("name"));
+                ClientManager::create(addressClient);
+                ClientManager::get().connect();
 
-            ConnectPacket connectPacket{};
-            connectPacket.id = -1;
-            memcpy(&connectPacket.name, name.c_str(), 25);
+                ConnectPacket connectPacket{};
+                connectPacket.id = -1;
+                memcpy(&connectPacket.name, name.c_str(), 25);
 
-            PacketIO::sendPacket(ClientManager::get().getServer(), connectPacket);
+                ClientManager::get().sendPacket(connectPacket);
+            });
         }
     });
 
@@ -175,6 +537,196 @@ void RegisterCoreCommands(CommandRegistry& registry) {
         }
     });
 
+    registry.registerCommand({
+        "packet_sizes",
+        "Compare the payload size of the bit packed packets with their old byte encoding",
+
+        {},
+
+        [](const ParsedArgs&) {
+            std::vector<uint8_t> payload;
+
+            PlayerUpdatePacket update{};
+            update.id = 3;
+            update.posX = 1250;
+            update.posY = -340;
+            update.serialize(payload);
+            const size_t updateSize = payload.size();
+
+            payload.clear();
+            PlayerJoinPacket join{};
+            std::memcpy(join.name, "player", 7);
+            join.id = 3;
+            join.announce = 1;
+            join.serialize(payload);
+            const size_t joinSize = payload.size();
+
+            ConsoleManager::get().log(INFO, "  %-14s %6s %6s %6s", "packet", "old", "new", "saved");
+            ConsoleManager::get().log(INFO, "  %-14s %6zu %6zu %5.0f%%", "player_update", PlayerUpdatePacket::BYTE_ENCODED_SIZE,
+                updateSize, 100.0 - 100.0 * static_cast<double>(updateSize) / PlayerUpdatePacket::BYTE_ENCODED_SIZE);
+            ConsoleManager::get().log(INFO, "  %-14s %6zu %6zu %5.0f%%", "player_join", PlayerJoinPacket::BYTE_ENCODED_SIZE,
+                joinSize, 100.0 - 100.0 * static_cast<double>(joinSize) / PlayerJoinPacket::BYTE_ENCODED_SIZE);
+            ConsoleManager::get().log(INFO, "  payload bytes only, tcp frames add 3 and state datagrams 6");
+        }
+    });
+
+    registry.registerCommand({
+        "alloc_stats",
+        "Show the per tick arena and the message pools of the active server and client",
+
+        {},
+
+        [](const ParsedArgs&) {
+            if (!ServerManager::has() && !ClientManager::has()) {
+                ConsoleManager::get().log(WARNING, "There is no active server or client");
+                return;
+            }
+
+            auto logArena = [](const char* name, const ArenaStats& arena) {
+                ConsoleManager::get().log(INFO, "  %-16s %8zu KiB owned, peak %zu B, %llu heap allocs last tick, %llu total",
+                    name, arena.capacity / 1024, arena.peak,
+                    static_cast<unsigned long long>(arena.lastTickAllocations),
+                    static_cast<unsigned long long>(arena.blockAllocations));
+            };
+            auto logPool = [](const char* name, const PoolStats& pool) {
+                ConsoleManager::get().log(INFO, "  %-16s %8zu live, %zu peak, %zu slots, %llu chunk allocs",
+                    name, pool.live, pool.peak, pool.capacity,
+                    static_cast<unsigned long long>(pool.chunkAllocations));
+            };
+
+            if (ServerManager::has()) {
+                const Server::AllocatorStats stats = ServerManager::get().getAllocatorStats();
+                ConsoleManager::get().log(INFO, "Server:");
+                logArena("tick arena", stats.tickArena);
+                logPool("pending msgs", stats.pendingMessages);
+                logPool("buffered msgs", stats.bufferedMessages);
+            }
+
+            if (ClientManager::has()) {
+                Client& client = ClientManager::get();
+                ConsoleManager::get().log(INFO, "Client:");
+                logArena("frame arena", client.getFrameArenaStats());
+                logPool("pending msgs", client.getChannel().pendingPoolStats());
+                logPool("buffered msgs", client.getChannel().bufferedPoolStats());
+            }
+        }
+    });
+
+    registry.registerCommand({
+        "netstat",
+        "Show traffic rates, rtt and tick phase percentiles of the active server and client, with an id the packets of one client",
+
+        {
+            {"id", ArgType::INT, true}
+        },
+
+        [](const ParsedArgs& args) {
+            if (!ServerManager::has() && !ClientManager::has()) {
+                ConsoleManager::get().log(WARNING, "There is no active server or client");
+                return;
+            }
+
+            auto logRates = [](const ConnectionStats& stats, const ConnectionRates& rates) {
+                ConsoleManager::get().log(INFO, "  in  %9.1f KiB/s %8.0f pkt/s   %llu B, %llu packets",
+                    rates.bytesIn / 1024.0, rates.packetsIn,
+                    static_cast<unsigned long long>(stats.bytesIn), static_cast<unsigned long long>(stats.totalPacketsIn()));
+                ConsoleManager::get().log(INFO, "  out %9.1f KiB/s %8.0f pkt/s   %llu B, %llu packets",
+                    rates.bytesOut / 1024.0, rates.packetsOut,
+                    static_cast<unsigned long long>(stats.bytesOut), static_cast<unsigned long long>(stats.totalPacketsOut()));
+                ConsoleManager::get().log(INFO, "  would block %llu, queued %zu B, rtt %.1f ms",
+                    static_cast<unsigned long long>(stats.wouldBlock), stats.queueDepth, stats.rttMs);
+            };
+            auto logHistogram = [](const char* name, const Histogram& histogram, double scale) {
+                if (histogram.count() == 0) {
+                    ConsoleManager::get().log(INFO, "  %-14s no samples", name);
+                    return;
+                }
+                ConsoleManager::get().log(INFO, "  %-14s p50 %9.3f  p99 %9.3f  p999 %9.3f  max %9.3f  (%llu)", name,
+                    histogram.percentile(50) * scale, histogram.percentile(99) * scale,
+                    histogram.percentile(99.9) * scale, histogram.max() * scale,
+                    static_cast<unsigned long long>(histogram.count()));
+            };
+            auto logPackets = [](const ConnectionStats& stats) {
+                ConsoleManager::get().log(INFO, "  %-14s %10s %10s", "packet", "in", "out");
+                for (size_t type = 0; type < NET_STATS_PACKET_TYPES; type++) {
+                    if (stats.packetsIn[type] == 0 && stats.packetsOut[type] == 0) continue;
+                    ConsoleManager::get().log(INFO, "  %-14s %10llu %10llu", packetTypeName(type),
+                        static_cast<unsigned long long>(stats.packetsIn[type]),
+                        static_cast<unsigned long long>(stats.packetsOut[type]));
+                }
+            };
+
+            if (ServerManager::has()) {
+                const Server::NetStats stats = ServerManager::get().getNetStats();
+
+                if (args.values.contains("id")) {
+                    const int id = std::get<int>(args.values.at("id"));
+                    const auto it = std::find_if(stats.connections.begin(), stats.connections.end(),
+                        [id](const ConnectionSample& sample) { return sample.id == id; });
+                    if (it == stats.connections.end()) {
+                        ConsoleManager::get().log(WARNING, "Client %d is not connected", id);
+                        return;
+                    }
+
+                    ConsoleManager::get().log(INFO, "Server client %d, rates over %.0f ms:", id, stats.intervalMs);
+                    logRates(it->stats, it->rates);
+                    logPackets(it->stats);
+                    return;
+                }
+
+                ConsoleManager::get().log(INFO, "Server: %zu clients, rates over %.0f ms:", stats.connections.size(), stats.intervalMs);
+                logRates(stats.total, stats.totalRates);
+                logHistogram("rtt ms", stats.rttUs, 1e-3);
+                for (int phase = 0; phase < TICK_PHASE_COUNT; phase++) {
+                    const std::string name = std::string(tickPhaseName(static_cast<TickPhase>(phase))) + " us";
+                    logHistogram(name.c_str(), stats.phaseNs[phase], 1e-3);
+                }
+
+                const Server::BroadcastStats& broadcast = stats.broadcast;
+                ConsoleManager::get().log(INFO, "  broadcast last tick: %llu sent, %llu encodes (%llu saved), %llu B fanned out",
+                    static_cast<unsigned long long>(broadcast.broadcasts), static_cast<unsigned long long>(broadcast.encodes),
+                    static_cast<unsigned long long>(broadcast.encodesSaved),
+                    static_cast<unsigned long long>(broadcast.bytesFannedOut));
+
+                std::vector<ConnectionSample> top = stats.connections;
+                const size_t shown = std::min<size_t>(top.size(), NETSTAT_TOP_CLIENTS);
+                std::partial_sort(top.begin(), top.begin() + static_cast<std::ptrdiff_t>(shown), top.end(),
+                    [](const ConnectionSample& a, const ConnectionSample& b) { return a.rates.bytesOut > b.rates.bytesOut; });
+
+                if (shown > 0) {
+                    ConsoleManager::get().log(INFO, "  %5s %10s %10s %8s %9s %8s", "id", "in B/s", "out B/s", "rtt ms", "queued B", "blocked");
+                }
+                for (size_t i = 0; i < shown; i++) {
+                    const ConnectionSample& sample = top[i];
+                    ConsoleManager::get().log(INFO, "  %5d %10.0f %10.0f %8.1f %9zu %8llu", sample.id,
+                        sample.rates.bytesIn, sample.rates.bytesOut, sample.stats.rttMs, sample.stats.queueDepth,
+                        static_cast<unsigned long long>(sample.stats.wouldBlock));
+                }
+            }
+
+            if (ClientManager::has()) {
+                const Client::NetStats& stats = ClientManager::get().getNetStats();
+                ConsoleManager::get().log(INFO, "Client:");
+                logRates(stats.connection, stats.rates);
+                logHistogram("rtt ms", stats.rttUs, 1e-3);
+                logHistogram("update us", stats.updateNs, 1e-3);
+                logPackets(stats.connection);
+            }
+        }
+    });
+
+    registry.registerCommand({
+        "netstat_reset",
+        "Clear the rtt and timing histograms netstat reports, the traffic counters keep running",
+
+        {},
+
+        [](const ParsedArgs&) {
+            if (ServerManager::has()) ServerManager::get().resetNetStats();
+            if (ClientManager::has()) ClientManager::get().resetNetStats();
+        }
+    });
+
     registry.registerCommand({
         "clear",
         "Clears the console",
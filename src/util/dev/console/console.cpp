@@ -1,15 +1,22 @@
 #include "util/dev/console/console.h"
 
+#include <cstdarg>
+#include <cstdio>
 #include <cstring>
+#include <ctime>
 
+#if !defined(MP_HEADLESS)
 #include "raylib.h"
+#endif
 #include "util/dev/console/command/registry.h"
 #include "util/dev/console/command/commands/core_command.h"
 
 Console::Console() {
     RegisterCoreCommands(mRegistry);
 
+#if !defined(MP_HEADLESS)
     mFont = LoadFontEx(ASSETS_PATH "pixel_game/fonts/VictorMono-Medium.ttf", 14, nullptr, 0);
+#endif
 }
 
 void Console::setOpen(bool open) {
@@ -20,6 +27,7 @@ bool Console::isOpen() const {
     return mOpen;
 }
 
+#if !defined(MP_HEADLESS)
 void Console::draw()
 {
     const int padding = 8;
@@ -133,6 +141,8 @@ void Console::draw()
     }
 }
 
+#endif
+
 void Console::log(LogLevel level, const char* format, ...)
 {
     char buffer[512];
@@ -142,6 +152,10 @@ void Console::log(LogLevel level, const char* format, ...)
     vsnprintf(buffer, sizeof(buffer), format, args);
     va_end(args);
 
+    // the server thread logs too
+    std::lock_guard lock(mOutputMutex);
+    writeLine(level, buffer);
+
     if (mLogs.size() >= CONSOLE_MAX_LOG) {
         mLogs.pop_front();
     }
@@ -152,6 +166,7 @@ void Console::log(LogLevel level, const char* format, ...)
     });
 }
 
+#if !defined(MP_HEADLESS)
 void Console::autoComplete() {
     if (mInput.empty()) return;
 
@@ -488,8 +503,10 @@ void Console::handleInput()
         --mScrollOffset;
 }
 
+#endif
 
 Console::~Console() {
+    if (mLogFile) std::fclose(mLogFile);
 }
 
 void Console::executeCommand()
@@ -500,19 +517,33 @@ void Console::executeCommand()
     // Reset cursor
     mCursorPos = 0;
 
-    size_t spacePos = mInput.find(' ');
+    execute(mInput);
+}
+
+/**
+ *
+ * Run one command line, the same way as typing it into the console
+ *
+ * @param line command name followed by its arguments
+ */
+void Console::execute(std::string_view line)
+{
+    if (line.empty())
+        return;
+
+    size_t spacePos = line.find(' ');
 
     std::string commandName;
     std::string argString;
 
-    if (spacePos != std::string::npos)
+    if (spacePos != std::string_view::npos)
     {
-        commandName = mInput.substr(0, spacePos);
-        argString   = mInput.substr(spacePos + 1);
+        commandName = line.substr(0, spacePos);
+        argString   = line.substr(spacePos + 1);
     }
     else
     {
-        commandName = mInput;
+        commandName = line;
         argString.clear();
     }
 
@@ -544,7 +575,49 @@ void Console::executeCommand()
 
 
 void Console::clearLogs() {
+    std::lock_guard lock(mOutputMutex);
     mLogs.clear();
     mScrollOffset = 0;
 }
 
+/**
+ *
+ * Also write every log line to a file, appending to it
+ *
+ * @param path
+ * @return false if the file could not be opened
+ */
+bool Console::openLogFile(const char* path) {
+    std::FILE* file = std::fopen(path, "a");
+    if (!file) return false;
+
+    std::lock_guard lock(mOutputMutex);
+    if (mLogFile) std::fclose(mLogFile);
+    mLogFile = file;
+    return true;
+}
+
+// log lines leave the process here, called with mOutputMutex held since the server and its io workers log from their own threads
+void Console::writeLine(LogLevel level, const char* text) {
+#if defined(MP_HEADLESS)
+    const bool toStdout = true;
+#else
+    const bool toStdout = false;
+#endif
+    if ((!toStdout && !mLogFile) || level > mOutputLevel) return;
+
+    static const char* const LEVELS[] = {"FATAL", "WARNING", "INFO", "SUCCESS"};
+
+    char stamp[16];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(stamp, sizeof(stamp), "%H:%M:%S", std::localtime(&now));
+
+    if (toStdout) {
+        std::fprintf(level == FATAL ? stderr : stdout, "%s [%s] %s\n", stamp, LEVELS[level], text);
+        std::fflush(level == FATAL ? stderr : stdout);
+    }
+    if (mLogFile) {
+        std::fprintf(mLogFile, "%s [%s] %s\n", stamp, LEVELS[level], text);
+        std::fflush(mLogFile);
+    }
+}
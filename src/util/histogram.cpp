@@ -0,0 +1,76 @@
+#include "util/histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+void Histogram::record(uint64_t value) {
+    mCounts[indexOf(value)]++;
+    mCount++;
+    mSum += value;
+    mMin = std::min(mMin, value);
+    mMax = std::max(mMax, value);
+}
+
+void Histogram::merge(const Histogram& other) {
+    for (size_t i = 0; i < BUCKETS; i++) {
+        mCounts[i] += other.mCounts[i];
+    }
+    mCount += other.mCount;
+    mSum += other.mSum;
+    mMin = std::min(mMin, other.mMin);
+    mMax = std::max(mMax, other.mMax);
+}
+
+void Histogram::reset() {
+    mCounts.fill(0);
+    mCount = 0;
+    mSum = 0;
+    mMin = UINT64_MAX;
+    mMax = 0;
+}
+
+/**
+ *
+ * Smallest value that at least percent of the recorded values are not above, at bucket precision
+ *
+ * @param percent 0..100, 50 is the median
+ * @return 0 if nothing was recorded
+ */
+uint64_t Histogram::percentile(double percent) const {
+    if (mCount == 0) return 0;
+
+    const double wanted = std::ceil(std::clamp(percent, 0.0, 100.0) / 100.0 * static_cast<double>(mCount));
+    const uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(wanted), 1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += mCounts[i];
+        if (seen < rank) continue;
+
+        // the last bucket also holds everything too large for the others
+        return i == BUCKETS - 1 ? mMax : std::clamp(highestOf(i), mMin, mMax);
+    }
+    return mMax;
+}
+
+// bucket of a value: exact below LINEAR, then SUB_BUCKETS per power of two
+size_t Histogram::indexOf(uint64_t value) {
+    if (value < LINEAR) return static_cast<size_t>(value);
+
+    const int exponent = 63 - std::countl_zero(value);
+    if (exponent >= HISTOGRAM_MAX_BITS) return BUCKETS - 1;
+
+    const int shift = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+    const size_t sub = static_cast<size_t>(value >> shift) - SUB_BUCKETS;
+    return LINEAR + static_cast<size_t>(shift - 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t Histogram::highestOf(size_t index) {
+    if (index < LINEAR) return index;
+
+    const size_t k = index - LINEAR;
+    const int shift = static_cast<int>(k / SUB_BUCKETS) + 1;
+    const uint64_t lowest = static_cast<uint64_t>(SUB_BUCKETS + k % SUB_BUCKETS) << shift;
+    return lowest + (uint64_t{1} << shift) - 1;
+}
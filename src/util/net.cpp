@@ -2,20 +2,34 @@
 
 #include <charconv>
 #include <iostream>
-#include <ws2tcpip.h>
-#include <winsock2.h>
 
 #include "network/packets.h"
+#include "util/net_platform.h"
+#include "util/net_sim.h"
+
+static void setNonBlocking(SOCKET handle) {
+#if defined(PLATFORM_WINDOWS)
+    u_long mode = 1;
+    ioctlsocket(handle, FIONBIO, &mode);
+#else
+    int flags = fcntl(handle, F_GETFL, 0);
+    fcntl(handle, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
 
 void Net::init() {
+#if defined(PLATFORM_WINDOWS)
     WSADATA wsa;
     if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
         std::cout << "Failed to init net\n";
     }
+#endif
 }
 
 void Net::shutdown() {
+#if defined(PLATFORM_WINDOWS)
     WSACleanup();
+#endif
 }
 
 bool Net::parsePort(std::string_view str, uint16_t& out) {
@@ -35,34 +49,63 @@ bool Net::parsePort(std::string_view str, uint16_t& out) {
 
 /**
  *
- * Resolves an address
+ * Parse a dotted ipv4 address without touching the resolver
  *
- * @param hostname
+ * @param str
  * @param port
- * @return the NetAddress
+ * @param out
+ * @return false if str is not a numeric address
  */
-Net::Address Net::resolveAddress(const char* hostname, uint16_t port) {
-    Net::Address addr{};
-    addr.port = port;
+bool Net::parseAddress(const char* str, uint16_t port, Net::Address& out) {
+    in_addr parsed{};
+    if (inet_pton(AF_INET, str, &parsed) != 1) return false;
 
-    int code = inet_pton(AF_INET, hostname, &addr.ip);
-    if (code != 1 && code != 0) {
-        std::cout << "inet_pton failed\n";
-    }
+    out.ip = parsed.s_addr;
+    out.port = port;
+    return true;
+}
+
+/**
+ *
+ * Resolves an address. Numeric addresses are parsed directly, everything else goes through getaddrinfo
+ * and may block for as long as the system resolver takes
+ *
+ * @param hostname
+ * @param port
+ * @param out
+ * @return NET_ERROR if the name could not be resolved
+ */
+Net::Result Net::resolve(const char* hostname, uint16_t port, Net::Address& out) {
+    if (parseAddress(hostname, port, out)) return Net::Result::NET_OK;
 
     addrinfo hints{};
     hints.ai_family = AF_INET;
     hints.ai_socktype = SOCK_STREAM;
 
     addrinfo* result = nullptr;
-    if (getaddrinfo(hostname, nullptr, &hints, &result) != 0) {
-        return {};
+    if (getaddrinfo(hostname, nullptr, &hints, &result) != 0 || !result) {
+        return Net::Result::NET_ERROR;
     }
 
     sockaddr_in* ipv4 = reinterpret_cast<sockaddr_in*>(result->ai_addr);
-    addr.ip = ipv4->sin_addr.s_addr;
+    out.ip = ipv4->sin_addr.s_addr;
+    out.port = port;
 
     freeaddrinfo(result);
+    return Net::Result::NET_OK;
+}
+
+/**
+ *
+ * Resolves an address
+ *
+ * @param hostname
+ * @param port
+ * @return the NetAddress, all zero if it could not be resolved
+ */
+Net::Address Net::resolveAddress(const char* hostname, uint16_t port) {
+    Net::Address addr{};
+    if (resolve(hostname, port, addr) != Net::Result::NET_OK) return {};
     return addr;
 }
 
@@ -86,8 +129,7 @@ Socket Socket::create(Net::Protocol protocol, bool nonblocking){
     }
 
     if (nonblocking) {
-        u_long mode = 1;
-        ioctlsocket(handle, FIONBIO, &mode);
+        setNonBlocking(handle);
     }
 
     sock.handle = handle;
@@ -131,8 +173,8 @@ Net::Result Socket::connect(Socket sock, Net::Address addr){
     sa.sin_port = htons(addr.port); // make sure its network byte order
 
     if (::connect(sock.handle, reinterpret_cast<SOCKADDR*>(&sa), sizeof(sa)) == SOCKET_ERROR) {
-        int err = WSAGetLastError();
-        if (err == WSAEWOULDBLOCK) return Net::Result::NET_WOULDBLOCK;
+        int err = NetLastError();
+        if (NetIsWouldBlock(err)) return Net::Result::NET_WOULDBLOCK;
         return Net::Result::NET_ERROR;
     }
 
@@ -140,6 +182,7 @@ Net::Result Socket::connect(Socket sock, Net::Address addr){
 }
 
 Net::Result Socket::close(Socket sock) {
+    if (NetSim::active()) NetSim::get().forget(sock);
     return closesocket(sock.handle) == 0 ? Net::Result::NET_OK : Net::Result::NET_ERROR;
 }
 
@@ -166,13 +209,18 @@ Net::Result Socket::listen(Socket sock, int backlog){
  */
 Net::Result Socket::accept(Socket sock, Socket* outSocket, Net::Address* outAddr){
     SOCKADDR_IN sa;
-    int len = sizeof(sa);
+    NetSockLen len = sizeof(sa);
     SOCKET client = ::accept(sock.handle, reinterpret_cast<SOCKADDR*>(&sa), &len);
 
     if(client == INVALID_SOCKET) {
         return Net::Result::NET_ERROR;
     }
 
+#if !defined(PLATFORM_WINDOWS)
+    // WinSock sockets inherit non-blocking mode from the listener, POSIX ones do not
+    setNonBlocking(client);
+#endif
+
     if(outSocket != nullptr) outSocket->handle = client;
     if(outAddr != nullptr) {
         outAddr->ip = sa.sin_addr.s_addr;
@@ -189,18 +237,22 @@ Net::Result Socket::accept(Socket sock, Socket* outSocket, Net::Address* outAddr
  * @param sock
  * @param buffer buffer to write to
  * @param length
+ * @param outRead number of bytes actually read, may be less than length
  * @return the NetResult
  */
-Net::Result Socket::read(Socket sock, void* buffer, int length){
+Net::Result Socket::read(Socket sock, void* buffer, int length, int* outRead){
+    if (outRead != nullptr) *outRead = 0;
+
     int res = recv(sock.handle, static_cast<char*>(buffer), length, 0);
 
     if (res == 0) return Net::Result::NET_DISCONNECTED;
     if(res == SOCKET_ERROR) {
-        int err = WSAGetLastError();
-        if (err == WSAEWOULDBLOCK) return Net::Result::NET_WOULDBLOCK;
+        int err = NetLastError();
+        if (NetIsWouldBlock(err)) return Net::Result::NET_WOULDBLOCK;
         return Net::Result::NET_ERROR;
     }
 
+    if (outRead != nullptr) *outRead = res;
     return Net::Result::NET_OK;
 }
 
@@ -211,15 +263,83 @@ Net::Result Socket::read(Socket sock, void* buffer, int length){
  * @param sock
  * @param data
  * @param length length of data
+ * @param outSent number of bytes actually sent, may be less than length on a non-blocking socket
+ * @return the NetResult
+ */
+Net::Result Socket::send(Socket sock, const void* data, int length, int* outSent){
+    Net::Result simulated;
+    if (NetSim::active() && NetSim::get().send(sock, data, length, outSent, &simulated)) return simulated;
+    if (outSent != nullptr) *outSent = 0;
+
+    int res = ::send(sock.handle, static_cast<const char*>(data), length, NET_SEND_FLAGS);
+    if(res == SOCKET_ERROR) {
+        int err = NetLastError();
+        if (NetIsWouldBlock(err)) return Net::Result::NET_WOULDBLOCK;
+        return Net::Result::NET_ERROR;
+    }
+
+    if (outSent != nullptr) *outSent = res;
+    return Net::Result::NET_OK;
+}
+
+/**
+ *
+ * Send one datagram
+ *
+ * @param sock udp socket
+ * @param data
+ * @param length
+ * @param addr receiver
+ * @return the NetResult
+ */
+Net::Result Socket::sendTo(Socket sock, const void* data, int length, Net::Address addr) {
+    if (NetSim::active() && NetSim::get().sendTo(sock, data, length, addr)) return Net::Result::NET_OK;
+
+    SOCKADDR_IN sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = addr.ip;
+    sa.sin_port = htons(addr.port);
+
+    int res = ::sendto(sock.handle, static_cast<const char*>(data), length, NET_SEND_FLAGS,
+                       reinterpret_cast<SOCKADDR*>(&sa), sizeof(sa));
+    if (res == SOCKET_ERROR) {
+        int err = NetLastError();
+        if (NetIsWouldBlock(err)) return Net::Result::NET_WOULDBLOCK;
+        return Net::Result::NET_ERROR;
+    }
+
+    return Net::Result::NET_OK;
+}
+
+/**
+ *
+ * Read one datagram
+ *
+ * @param sock udp socket
+ * @param buffer
+ * @param length
+ * @param outRead size of the datagram
+ * @param outAddr sender
  * @return the NetResult
  */
-Net::Result Socket::send(Socket sock, const void* data, int length){
-    if(::send(sock.handle, static_cast<const char*>(data), length, 0) == SOCKET_ERROR) {
-        int err = WSAGetLastError();
-        if (err == WSAEWOULDBLOCK) return Net::Result::NET_WOULDBLOCK;
+Net::Result Socket::readFrom(Socket sock, void* buffer, int length, int* outRead, Net::Address* outAddr) {
+    SOCKADDR_IN sa{};
+    NetSockLen len = sizeof(sa);
+
+    int res = ::recvfrom(sock.handle, static_cast<char*>(buffer), length, 0,
+                         reinterpret_cast<SOCKADDR*>(&sa), &len);
+    if (res == SOCKET_ERROR) {
+        int err = NetLastError();
+        if (NetIsWouldBlock(err)) return Net::Result::NET_WOULDBLOCK;
         return Net::Result::NET_ERROR;
     }
 
+    if (outRead != nullptr) *outRead = res;
+    if (outAddr != nullptr) {
+        outAddr->ip = sa.sin_addr.s_addr;
+        outAddr->port = ntohs(sa.sin_port);
+    }
+
     return Net::Result::NET_OK;
 }
 
@@ -0,0 +1,152 @@
+#include "util/net_reactor.h"
+
+#include <algorithm>
+
+#include "util/net_platform.h"
+
+#if defined(PLATFORM_LINUX)
+#include <sys/epoll.h>
+#endif
+
+/**
+ *
+ * Creates the reactor
+ *
+ * @param maxEvents max number of events reported by a single wait
+ */
+NetReactor::NetReactor(int maxEvents) {
+    mEvents.resize(maxEvents > 0 ? maxEvents : 1);
+#if defined(PLATFORM_LINUX)
+    mHandle = epoll_create1(EPOLL_CLOEXEC);
+#endif
+}
+
+NetReactor::~NetReactor() {
+#if defined(PLATFORM_LINUX)
+    if (mHandle >= 0) ::close(static_cast<int>(mHandle));
+#endif
+}
+
+/**
+ *
+ * Register a socket, the key is handed back in every event for that socket
+ *
+ * @param sock
+ * @param key
+ * @return the NetResult
+ */
+Net::Result NetReactor::add(Socket sock, uint64_t key) {
+#if defined(PLATFORM_LINUX)
+    if (mHandle < 0) return Net::Result::NET_ERROR;
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.u64 = key;
+
+    if (epoll_ctl(static_cast<int>(mHandle), EPOLL_CTL_ADD, static_cast<int>(sock.handle), &ev) != 0) {
+        return Net::Result::NET_ERROR;
+    }
+#else
+    if (mSockets.size() >= FD_SETSIZE) return Net::Result::NET_ERROR;
+#endif
+
+    mSockets.push_back(Entry{sock, key});
+    return Net::Result::NET_OK;
+}
+
+/**
+ *
+ * Unregister a socket. Must be called before the socket is closed
+ *
+ * @param sock
+ * @return the NetResult
+ */
+Net::Result NetReactor::remove(Socket sock) {
+    auto it = std::find_if(mSockets.begin(), mSockets.end(), [&](const Entry& e) {
+        return e.sock.handle == sock.handle;
+    });
+
+    if (it == mSockets.end()) return Net::Result::NET_ERROR;
+
+    // swap remove, order does not matter
+    *it = mSockets.back();
+    mSockets.pop_back();
+
+#if defined(PLATFORM_LINUX)
+    epoll_event ev{};
+    epoll_ctl(static_cast<int>(mHandle), EPOLL_CTL_DEL, static_cast<int>(sock.handle), &ev);
+#endif
+
+    return Net::Result::NET_OK;
+}
+
+/**
+ *
+ * Wait for readiness on the registered sockets. This is one syscall no matter how many sockets are registered
+ *
+ * @param timeoutMs 0 returns immediately, -1 blocks until something is ready
+ * @param outCount number of events written to events()
+ * @return the NetResult
+ */
+Net::Result NetReactor::wait(int timeoutMs, int* outCount) {
+    *outCount = 0;
+
+#if defined(PLATFORM_LINUX)
+    epoll_event raw[256];
+    const int maxEvents = std::min(static_cast<int>(mEvents.size()), 256);
+
+    int res = epoll_wait(static_cast<int>(mHandle), raw, maxEvents, timeoutMs);
+    if (res < 0) {
+        return errno == EINTR ? Net::Result::NET_OK : Net::Result::NET_ERROR;
+    }
+
+    for (int i = 0; i < res; i++) {
+        Event& ev = mEvents[i];
+        ev.key = raw[i].data.u64;
+        ev.readable = (raw[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0;
+        ev.writable = (raw[i].events & EPOLLOUT) != 0;
+        ev.hangup = (raw[i].events & (EPOLLHUP | EPOLLERR)) != 0;
+    }
+
+    *outCount = res;
+#else
+    if (mSockets.empty()) return Net::Result::NET_OK;
+
+    fd_set readfds;
+    fd_set writefds;
+
+    FD_ZERO(&readfds);
+    FD_ZERO(&writefds);
+
+    SOCKET maxfd = 0;
+    for (const Entry& e : mSockets) {
+        SOCKET s = e.sock.handle;
+        FD_SET(s, &readfds);
+        FD_SET(s, &writefds);
+        if (s > maxfd) maxfd = s;
+    }
+
+    TIMEVAL tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+
+    int res = select(static_cast<int>(maxfd) + 1, &readfds, &writefds, NULL, timeoutMs < 0 ? NULL : &tv);
+    if (res == SOCKET_ERROR) return Net::Result::NET_ERROR;
+
+    int count = 0;
+    for (const Entry& e : mSockets) {
+        if (count >= static_cast<int>(mEvents.size())) break;
+
+        SOCKET s = e.sock.handle;
+        bool readable = FD_ISSET(s, &readfds);
+        bool writable = FD_ISSET(s, &writefds);
+        if (!readable && !writable) continue;
+
+        mEvents[count++] = Event{e.key, readable, writable, false};
+    }
+
+    *outCount = count;
+#endif
+
+    return Net::Result::NET_OK;
+}
@@ -0,0 +1,482 @@
+#include "util/net_sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "util/net_platform.h"
+
+#if defined(MSG_DONTWAIT)
+// the pump never waits on a full socket, the client's stream socket is blocking
+#define NETSIM_SEND_FLAGS (NET_SEND_FLAGS | MSG_DONTWAIT)
+#else
+#define NETSIM_SEND_FLAGS NET_SEND_FLAGS
+#endif
+
+std::atomic<bool> NetSim::sActive{false};
+
+static constexpr double NETSIM_IDLE = std::numeric_limits<double>::infinity();
+
+/**
+ *
+ * Hand bytes of a stream to the kernel
+ *
+ * @return bytes taken, 0 if the socket buffer is full, -1 if the connection is gone
+ */
+static int sendStream(Socket sock, const uint8_t* data, int length) {
+    int res = ::send(sock.handle, reinterpret_cast<const char*>(data), length, NETSIM_SEND_FLAGS);
+    if (res == SOCKET_ERROR) return NetIsWouldBlock(NetLastError()) ? 0 : -1;
+    return res;
+}
+
+static void sendDatagram(Socket sock, const uint8_t* data, int length, Net::Address addr) {
+    SOCKADDR_IN sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = addr.ip;
+    sa.sin_port = htons(addr.port);
+
+    // a full socket buffer loses it, same as a real network would
+    ::sendto(sock.handle, reinterpret_cast<const char*>(data), length, NETSIM_SEND_FLAGS,
+             reinterpret_cast<SOCKADDR*>(&sa), sizeof(sa));
+}
+
+NetSim& NetSim::get() {
+    static NetSim instance;
+    return instance;
+}
+
+NetSim::~NetSim() {
+    {
+        std::lock_guard lock(mMutex);
+        mStopping = true;
+    }
+    mWake.notify_all();
+    if (mPump.joinable()) mPump.join();
+    sActive = false;
+}
+
+/**
+ *
+ * Start simulating, or change the conditions of every link without its own profile
+ *
+ * @param profile
+ */
+void NetSim::enable(const NetSimProfile& profile) {
+    {
+        std::lock_guard lock(mMutex);
+        mEnabled = true;
+        mProfile = profile;
+        sActive = true;
+        startPump();
+    }
+    mWake.notify_all();
+}
+
+/**
+ *
+ * Stop simulating. What is queued still goes out at its release time, new data joins the queue of its link
+ * until that drained, so nothing overtakes it. Drained links are dropped one by one, their sockets go to the
+ * kernel directly from then on
+ *
+ */
+void NetSim::disable() {
+    {
+        std::lock_guard lock(mMutex);
+        mEnabled = false;
+        for (auto& [key, link] : mLinks) {
+            link.overridden = false;
+            link.stats.overridden = false;
+        }
+    }
+    mWake.notify_all();
+}
+
+/**
+ *
+ * Restart the random streams from a seed. The n-th link since then, counting the existing ones by id,
+ * always gets the same stream
+ *
+ * @param seed
+ */
+void NetSim::setSeed(uint64_t seed) {
+    std::lock_guard lock(mMutex);
+    mSeed = seed;
+    mSeededLinks = 0;
+
+    std::vector<Link*> ordered;
+    for (auto& [key, link] : mLinks) ordered.push_back(&link);
+    std::sort(ordered.begin(), ordered.end(), [](const Link* a, const Link* b) { return a->id < b->id; });
+
+    for (Link* link : ordered) {
+        link->rng = seedFor(seed, ++mSeededLinks);
+    }
+}
+
+/**
+ *
+ * Give one link its own conditions
+ *
+ * @param link id from links()
+ * @param profile
+ * @return false if there is no such link
+ */
+bool NetSim::setLinkProfile(uint32_t link, const NetSimProfile& profile) {
+    std::lock_guard lock(mMutex);
+    for (auto& [key, l] : mLinks) {
+        if (l.id != link) continue;
+        l.overridden = true;
+        l.stats.overridden = true;
+        l.profile = profile;
+        return true;
+    }
+    return false;
+}
+
+bool NetSim::clearLinkProfile(uint32_t link) {
+    std::lock_guard lock(mMutex);
+    for (auto& [key, l] : mLinks) {
+        if (l.id != link) continue;
+        l.overridden = false;
+        l.stats.overridden = false;
+        return true;
+    }
+    return false;
+}
+
+/**
+ *
+ * Socket::send while active. Takes what fits into the link's queue, the pump sends it later in order
+ *
+ * @param sock
+ * @param data
+ * @param length
+ * @param outSent bytes taken
+ * @param outResult NET_WOULDBLOCK once NETSIM_STREAM_QUEUE_BYTES are queued, like a full socket buffer
+ * @return false if the simulator is off and nothing of this socket is queued any more
+ */
+bool NetSim::send(Socket sock, const void* data, int length, int* outSent, Net::Result* outResult) {
+    if (outSent != nullptr) *outSent = 0;
+    *outResult = Net::Result::NET_OK;
+
+    {
+        std::lock_guard lock(mMutex);
+        Link* taking = takingLink(sock, true, Net::Address{});
+        if (taking == nullptr) return false;
+        if (length <= 0) return true;
+        Link& link = *taking;
+
+        const size_t queued = link.stats.queuedBytes;
+        if (queued >= NETSIM_STREAM_QUEUE_BYTES) {
+            *outResult = Net::Result::NET_WOULDBLOCK;
+            return true;
+        }
+
+        const size_t taken = std::min<size_t>(static_cast<size_t>(length), NETSIM_STREAM_QUEUE_BYTES - queued);
+        const double now = nowMs();
+
+        double release = releaseTime(link, now, taken);
+        if (chance(link, profileOf(link).lossPercent)) {
+            // the segment is resent after a timeout, everything behind it waits
+            release += std::max(NETSIM_STREAM_RTO_MS, 2 * profileOf(link).latencyMs);
+            link.stats.dropped++;
+        }
+        release = std::max(release, link.lastReleaseMs);
+        link.lastReleaseMs = release;
+
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        link.queue.push_back(Packet{release, std::vector<uint8_t>(bytes, bytes + taken)});
+        link.stats.queuedBytes += taken;
+        link.stats.sentBytes += taken;
+
+        if (outSent != nullptr) *outSent = static_cast<int>(taken);
+    }
+
+    mWake.notify_all();
+    return true;
+}
+
+/**
+ *
+ * Socket::sendTo while active. Lost datagrams still count as sent, the sender can not tell either
+ *
+ * @param sock
+ * @param data
+ * @param length
+ * @param addr
+ * @return false if the simulator is off and nothing for this peer is queued any more
+ */
+bool NetSim::sendTo(Socket sock, const void* data, int length, Net::Address addr) {
+    {
+        std::lock_guard lock(mMutex);
+        Link* taking = takingLink(sock, false, addr);
+        if (taking == nullptr) return false;
+        if (length <= 0) return true;
+        Link& link = *taking;
+        const NetSimProfile& profile = profileOf(link);
+        const double now = nowMs();
+
+        link.stats.sentBytes += static_cast<uint64_t>(length);
+
+        if (chance(link, profile.lossPercent)) {
+            link.stats.dropped++;
+            return true;
+        }
+        if (profile.bandwidthKbps > 0 && link.busyUntilMs - now > NETSIM_MAX_QUEUE_MS) {
+            link.stats.overflowed++;
+            return true;
+        }
+
+        const int copies = chance(link, profile.duplicatePercent) ? 2 : 1;
+        if (copies > 1) link.stats.duplicated++;
+
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (int i = 0; i < copies; i++) {
+            double release = releaseTime(link, now, static_cast<size_t>(length));
+            if (chance(link, profile.reorderPercent)) {
+                release += NETSIM_REORDER_MIN_MS + nextUniform(link) * (NETSIM_REORDER_MAX_MS - NETSIM_REORDER_MIN_MS);
+                link.stats.reordered++;
+            }
+
+            // datagram queues stay sorted by release time, jitter and reordering let later ones overtake
+            auto at = std::upper_bound(link.queue.begin(), link.queue.end(), release,
+                                       [](double time, const Packet& p) { return time < p.releaseMs; });
+            link.queue.insert(at, Packet{release, std::vector<uint8_t>(bytes, bytes + length)});
+            link.stats.queuedBytes += static_cast<size_t>(length);
+        }
+    }
+
+    mWake.notify_all();
+    return true;
+}
+
+/**
+ *
+ * The socket is being closed. Queued stream bytes go out right away, datagrams are dropped
+ *
+ * @param sock
+ */
+void NetSim::forget(Socket sock) {
+    std::lock_guard lock(mMutex);
+
+    auto it = mLinks.lower_bound(LinkKey{sock.handle, 0});
+    while (it != mLinks.end() && it->first.first == sock.handle) {
+        Link& link = it->second;
+        if (link.stream) {
+            for (const Packet& p : link.queue) {
+                const int offset = &p == &link.queue.front() ? static_cast<int>(link.sentOffset) : 0;
+                if (sendStream(sock, p.data.data() + offset, static_cast<int>(p.data.size()) - offset) < 0) break;
+            }
+        }
+        it = mLinks.erase(it);
+    }
+}
+
+bool NetSim::isEnabled() const {
+    std::lock_guard lock(mMutex);
+    return mEnabled;
+}
+
+NetSimProfile NetSim::getProfile() const {
+    std::lock_guard lock(mMutex);
+    return mProfile;
+}
+
+uint64_t NetSim::getSeed() const {
+    std::lock_guard lock(mMutex);
+    return mSeed;
+}
+
+std::vector<NetSimLinkStats> NetSim::links() const {
+    std::lock_guard lock(mMutex);
+
+    std::vector<NetSimLinkStats> out;
+    out.reserve(mLinks.size());
+    for (const auto& [key, link] : mLinks) {
+        out.push_back(link.stats);
+    }
+    std::sort(out.begin(), out.end(), [](const NetSimLinkStats& a, const NetSimLinkStats& b) { return a.id < b.id; });
+    return out;
+}
+
+NetSim::LinkKey NetSim::keyOf(Socket sock, bool stream, Net::Address peer) {
+    const uint64_t address = stream ? 0 : (static_cast<uint64_t>(peer.ip) << 16 | peer.port) + 1;
+    return LinkKey{sock.handle, address};
+}
+
+NetSim::Link& NetSim::linkFor(Socket sock, bool stream, Net::Address peer) {
+    auto [it, inserted] = mLinks.try_emplace(keyOf(sock, stream, peer));
+
+    Link& link = it->second;
+    if (inserted) {
+        link.id = mNextLink++;
+        link.sock = sock;
+        link.stream = stream;
+        link.peer = peer;
+        link.rng = seedFor(mSeed, ++mSeededLinks);
+        link.stats.id = link.id;
+        link.stats.stream = stream;
+        link.stats.peer = peer;
+    }
+    return link;
+}
+
+/**
+ *
+ * The link new data has to go through. Called with mMutex held, so the pump can not drop the link in between
+ *
+ * @param sock
+ * @param stream
+ * @param peer
+ * @return nullptr once disabled and the link drained, the data may go to the kernel directly then
+ */
+NetSim::Link* NetSim::takingLink(Socket sock, bool stream, Net::Address peer) {
+    if (mEnabled) return &linkFor(sock, stream, peer);
+
+    auto it = mLinks.find(keyOf(sock, stream, peer));
+    if (it == mLinks.end() || it->second.queue.empty()) return nullptr;
+    return &it->second;
+}
+
+// while draining after disable() every link sends as soon as it can
+const NetSimProfile& NetSim::profileOf(const Link& link) const {
+    static const NetSimProfile clean{};
+    if (!mEnabled) return clean;
+    return link.overridden ? link.profile : mProfile;
+}
+
+// splitmix64, small and the same on every platform
+double NetSim::nextUniform(Link& link) {
+    uint64_t z = (link.rng += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return static_cast<double>(z >> 11) * 0x1.0p-53;
+}
+
+bool NetSim::chance(Link& link, double percent) {
+    return percent > 0 && nextUniform(link) * 100.0 < percent;
+}
+
+/**
+ *
+ * When data sent now arrives at the peer: after it and whatever is ahead of it on the link have been
+ * serialized, plus latency and jitter
+ *
+ * @param link
+ * @param nowMs
+ * @param bytes
+ * @return release time on the nowMs() clock
+ */
+double NetSim::releaseTime(Link& link, double nowMs, size_t bytes) {
+    const NetSimProfile& profile = profileOf(link);
+
+    // the last bit leaves once everything queued before it and the data itself went through the link
+    double sentMs = nowMs;
+    if (profile.bandwidthKbps > 0) {
+        sentMs = std::max(nowMs, link.busyUntilMs) + static_cast<double>(bytes) * 8.0 / profile.bandwidthKbps;
+        link.busyUntilMs = sentMs;
+    }
+
+    double delay = profile.latencyMs;
+    if (profile.jitterMs > 0) delay += (nextUniform(link) * 2.0 - 1.0) * profile.jitterMs;
+
+    return sentMs + std::max(delay, 0.0);
+}
+
+// call with mMutex held
+void NetSim::startPump() {
+    if (mPump.joinable()) return;
+    mPump = std::thread([this] { pump(); });
+}
+
+void NetSim::pump() {
+    std::unique_lock lock(mMutex);
+
+    while (!mStopping) {
+        const double now = nowMs();
+        const double next = deliver(now);
+
+        // every link drained, no socket has anything queued here, so the socket calls stop coming
+        if (!mEnabled && mLinks.empty()) sActive = false;
+
+        if (next == NETSIM_IDLE) {
+            mWake.wait(lock);
+            continue;
+        }
+
+        mWake.wait_for(lock, std::chrono::duration<double, std::milli>(next - now));
+    }
+}
+
+/**
+ *
+ * Send everything whose release time has come. Called with mMutex held. After disable() drained links are
+ * dropped, new data of their sockets goes to the kernel and can not overtake anything
+ *
+ * @param nowMs
+ * @return release time of the next queued data, NETSIM_IDLE if nothing is queued
+ */
+double NetSim::deliver(double nowMs) {
+    double next = NETSIM_IDLE;
+
+    for (auto it = mLinks.begin(); it != mLinks.end();) {
+        Link& link = it->second;
+        bool blocked = false;
+        while (!link.queue.empty() && link.queue.front().releaseMs <= nowMs) {
+            Packet& p = link.queue.front();
+            const int length = static_cast<int>(p.data.size());
+
+            if (!link.stream) {
+                sendDatagram(link.sock, p.data.data(), length, link.peer);
+                link.stats.queuedBytes -= p.data.size();
+                link.stats.deliveredBytes += p.data.size();
+                link.queue.pop_front();
+                continue;
+            }
+
+            const int offset = static_cast<int>(link.sentOffset);
+            const int sent = sendStream(link.sock, p.data.data() + offset, length - offset);
+            if (sent < 0) {
+                // connection is gone, its owner finds out on its own
+                link.queue.clear();
+                link.sentOffset = 0;
+                link.stats.queuedBytes = 0;
+                break;
+            }
+
+            link.sentOffset += static_cast<size_t>(sent);
+            link.stats.queuedBytes -= static_cast<size_t>(sent);
+            link.stats.deliveredBytes += static_cast<uint64_t>(sent);
+
+            if (link.sentOffset < p.data.size()) {
+                blocked = true;
+                break;
+            }
+
+            link.sentOffset = 0;
+            link.queue.pop_front();
+        }
+
+        if (blocked) {
+            // socket buffer is full, try again shortly
+            next = std::min(next, nowMs + 1.0);
+        } else if (!link.queue.empty()) {
+            next = std::min(next, link.queue.front().releaseMs);
+        } else if (!mEnabled) {
+            it = mLinks.erase(it);
+            continue;
+        }
+        ++it;
+    }
+
+    return next;
+}
+
+double NetSim::nowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t NetSim::seedFor(uint64_t seed, uint32_t ordinal) {
+    return seed ^ (static_cast<uint64_t>(ordinal) * 0xD1B54A32D192ED03ull);
+}
@@ -0,0 +1,125 @@
+#include "util/resolver.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct CacheEntry {
+        uint32_t ip{};
+        Clock::time_point expires{};
+    };
+
+    struct Completion {
+        Net::Result result{};
+        Net::Address address{};
+        Resolver::Callback callback;
+    };
+
+    // Shared with the lookup threads, so it stays alive for a lookup that outlives the main loop
+    struct ResolverState {
+        std::mutex mutex;
+        std::unordered_map<std::string, CacheEntry> cache;
+        std::unordered_map<std::string, std::vector<std::pair<uint16_t, Resolver::Callback>>> pending;
+        std::vector<Completion> done;
+    };
+
+    std::shared_ptr<ResolverState>& getState() {
+        static std::shared_ptr<ResolverState> state = std::make_shared<ResolverState>();
+        return state;
+    }
+
+    void storeCache(ResolverState& state, const std::string& hostname, uint32_t ip) {
+        const Clock::time_point now = Clock::now();
+
+        if (state.cache.size() >= RESOLVER_CACHE_MAX) {
+            for (auto it = state.cache.begin(); it != state.cache.end();) {
+                it = it->second.expires <= now ? state.cache.erase(it) : std::next(it);
+            }
+            if (state.cache.size() >= RESOLVER_CACHE_MAX) state.cache.erase(state.cache.begin());
+        }
+
+        state.cache[hostname] = CacheEntry{ip, now + std::chrono::milliseconds(RESOLVER_CACHE_TTL_MS)};
+    }
+}
+
+/**
+ *
+ * Resolve a hostname without blocking. Numeric addresses and cached names call back right away,
+ * anything else calls back from a later dispatch() once the lookup finished
+ *
+ * @param hostname
+ * @param port
+ * @param callback gets NET_OK and the address, or NET_ERROR if the name could not be resolved
+ */
+void Resolver::resolve(const std::string& hostname, uint16_t port, Callback callback) {
+    Net::Address address{};
+    if (Net::parseAddress(hostname.c_str(), port, address)) {
+        callback(Net::Result::NET_OK, address);
+        return;
+    }
+
+    std::shared_ptr<ResolverState> state = getState();
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+
+        auto cached = state->cache.find(hostname);
+        if (cached != state->cache.end() && cached->second.expires > Clock::now()) {
+            address.ip = cached->second.ip;
+            address.port = port;
+        } else {
+            auto& waiting = state->pending[hostname];
+            waiting.emplace_back(port, std::move(callback));
+
+            // somebody else is already looking this name up
+            if (waiting.size() > 1) return;
+
+            std::thread([state, hostname] {
+                Net::Address resolved{};
+                const Net::Result result = Net::resolve(hostname.c_str(), 0, resolved);
+
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (result == Net::Result::NET_OK) storeCache(*state, hostname, resolved.ip);
+
+                for (auto& [waitingPort, waitingCallback] : state->pending[hostname]) {
+                    state->done.push_back(Completion{result, Net::Address{resolved.ip, waitingPort}, std::move(waitingCallback)});
+                }
+                state->pending.erase(hostname);
+            }).detach();
+            return;
+        }
+    }
+
+    callback(Net::Result::NET_OK, address);
+}
+
+/**
+ *
+ * Run the callbacks of every lookup that finished since the last call. Called once per frame by the main loop
+ *
+ */
+void Resolver::dispatch() {
+    std::vector<Completion> done;
+    {
+        std::shared_ptr<ResolverState>& state = getState();
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->done.empty()) return;
+        done.swap(state->done);
+    }
+
+    for (Completion& c : done) {
+        c.callback(c.result, c.address);
+    }
+}
+
+void Resolver::clearCache() {
+    std::shared_ptr<ResolverState>& state = getState();
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->cache.clear();
+}
@@ -0,0 +1,88 @@
+#include "util/tick_scheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+TickScheduler::TickScheduler(double rate, TickPolicy policy) {
+    mPolicy = policy;
+    setRate(rate);
+    reset();
+}
+
+/**
+ *
+ * Start counting from now with an empty accumulator. Used on start and after idling, so the time spent
+ * idle does not turn into a burst of catch-up ticks
+ *
+ */
+void TickScheduler::reset() {
+    mLast = Clock::now();
+    mAccumulatorMs = 0.0;
+}
+
+/**
+ *
+ * Change the tick rate. Time already accumulated is kept, it is simply measured in the new interval
+ *
+ * @param rate ticks per second, clamped to TICK_MIN_RATE..TICK_MAX_RATE
+ */
+void TickScheduler::setRate(double rate) {
+    mRate = std::clamp(rate, TICK_MIN_RATE, TICK_MAX_RATE);
+    mTickMs = 1000.0 / mRate;
+}
+
+/**
+ *
+ * @return milliseconds until the next tick is due, 0 if one is due already
+ */
+double TickScheduler::untilNextMs() const {
+    const double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - mLast).count();
+    return std::max(0.0, mTickMs - (mAccumulatorMs + elapsed));
+}
+
+/**
+ *
+ * Block until the next tick is due. Sleeps while the deadline is further away than TICK_SPIN_MARGIN_MS,
+ * because the os may oversleep by about that much, and yields in a loop for the remainder
+ *
+ */
+void TickScheduler::wait() {
+    double remaining = untilNextMs();
+
+    if (remaining > TICK_SPIN_MARGIN_MS) {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(remaining - TICK_SPIN_MARGIN_MS));
+    }
+
+    while (untilNextMs() > 0.0) {
+        std::this_thread::yield();
+    }
+}
+
+/**
+ *
+ * Take the ticks that are due now. If the loop fell behind, TICK_CATCH_UP runs the missed ticks back to back
+ * up to TICK_MAX_CATCH_UP and TICK_DROP runs only one. Whatever is over the limit is dropped for good
+ *
+ * @return the number of ticks to simulate now, 0 if the next one is not due yet
+ */
+int TickScheduler::collect() {
+    const Clock::time_point now = Clock::now();
+    mAccumulatorMs += std::chrono::duration<double, std::milli>(now - mLast).count();
+    mLast = now;
+
+    int due = static_cast<int>(mAccumulatorMs / mTickMs);
+    if (due <= 0) return 0;
+
+    const int limit = mPolicy == TickPolicy::TICK_DROP ? 1 : TICK_MAX_CATCH_UP;
+    if (due > limit) {
+        mDropped += static_cast<uint64_t>(due - limit);
+        mAccumulatorMs -= (due - limit) * mTickMs;
+        due = limit;
+    }
+
+    mAccumulatorMs -= due * mTickMs;
+    mCaughtUp += static_cast<uint64_t>(due - 1);
+    mTick += static_cast<uint64_t>(due);
+
+    return due;
+}
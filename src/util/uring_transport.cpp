@@ -0,0 +1,523 @@
+#include "util/uring_transport.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(MP_HAS_LIBURING)
+#include <cerrno>
+#include <liburing.h>
+#include <sys/uio.h>
+#endif
+
+// user data of cancel requests, everything that is not a slot index is skipped by reap()
+static constexpr uint64_t CANCEL_DATA = UINT64_MAX - 1;
+
+/**
+ *
+ * Create the ring and register the buffer pool with the kernel
+ *
+ * @param queueDepth number of submission queue entries
+ * @param bufferCount number of registered send buffers, this is the max number of queued sends
+ * @param bufferSize size of every registered buffer, a single send or receive can not be larger than this
+ * @param receiveCount number of registered receive buffers, one per socket passed to startReceive()
+ */
+UringTransport::UringTransport(unsigned queueDepth, int bufferCount, int bufferSize, int receiveCount) {
+    mBufferSize = bufferSize;
+
+#if defined(MP_HAS_LIBURING)
+    mRing = new io_uring{};
+    if (io_uring_queue_init(queueDepth, mRing, 0) != 0) {
+        delete mRing;
+        mRing = nullptr;
+        return;
+    }
+
+    const int total = bufferCount + receiveCount;
+    mBuffers.resize(static_cast<size_t>(total) * bufferSize);
+    mSlots.resize(total);
+    mFreeSlots.reserve(bufferCount);
+    mFreeReceives.reserve(receiveCount);
+
+    std::vector<iovec> iovecs(total);
+    for (int i = 0; i < total; i++) {
+        iovecs[i].iov_base = bufferOf(i);
+        iovecs[i].iov_len = bufferSize;
+    }
+    for (int i = bufferCount - 1; i >= 0; i--) mFreeSlots.push_back(i);
+    for (int i = total - 1; i >= bufferCount; i--) mFreeReceives.push_back(i);
+
+    if (io_uring_register_buffers(mRing, iovecs.data(), total) != 0) {
+        io_uring_queue_exit(mRing);
+        delete mRing;
+        mRing = nullptr;
+    }
+#else
+    (void)queueDepth;
+    (void)bufferCount;
+    (void)receiveCount;
+#endif
+}
+
+UringTransport::~UringTransport() {
+#if defined(MP_HAS_LIBURING)
+    if (!mRing) return;
+
+    drainSends();
+
+    // receives never finish on their own, the ring takes them down with it
+    io_uring_queue_exit(mRing);
+    delete mRing;
+
+    for (auto& [handle, stream] : mStreams) {
+        if (stream.closing) Socket::close(Socket{handle});
+    }
+#endif
+}
+
+/**
+ *
+ * @return true if this build has io_uring support and the kernel accepts a ring
+ */
+bool UringTransport::available() {
+#if defined(MP_HAS_LIBURING)
+    io_uring ring{};
+    if (io_uring_queue_init(2, &ring, 0) != 0) return false;
+    io_uring_queue_exit(&ring);
+    return true;
+#else
+    return false;
+#endif
+}
+
+int UringTransport::acquireSlot() {
+    if (mFreeSlots.empty()) return -1;
+
+    int slot = mFreeSlots.back();
+    mFreeSlots.pop_back();
+    return slot;
+}
+
+void UringTransport::freeSlot(int slot) {
+    const bool receive = mSlots[slot].receive;
+    mSlots[slot] = Slot{};
+
+    if (receive) {
+        mFreeReceives.push_back(slot);
+        return;
+    }
+    mFreeSlots.push_back(slot);
+    mInflightSends--;
+}
+
+/**
+ *
+ * The send at the head of a chain is done. The next one of the same socket becomes the head, after a failure
+ * the stream is broken and everything behind it is dropped
+ *
+ * @param slot
+ * @param failed
+ */
+void UringTransport::finishSend(int slot, bool failed) {
+    Stream& stream = mStreams[mSlots[slot].sock.handle];
+    int next = mSlots[slot].next;
+    freeSlot(slot);
+
+    while (failed && next >= 0) {
+        const int after = mSlots[next].next;
+        freeSlot(next);
+        next = after;
+    }
+
+    stream.head = next;
+    if (next < 0) {
+        stream.tail = -1;
+        return;
+    }
+    mReady.push_back(next);
+}
+
+/**
+ *
+ * A cancelled request came back and its buffer is free again. The socket of a closed stream is closed with
+ * the last one, before that its descriptor could be handed out again while the kernel still uses it
+ *
+ * @param slot
+ */
+void UringTransport::releaseDetached(int slot) {
+    const Socket sock = mSlots[slot].sock;
+    freeSlot(slot);
+
+    auto it = mStreams.find(sock.handle);
+    if (it == mStreams.end()) return;
+
+    Stream& stream = it->second;
+    if (--stream.detached > 0 || !stream.closing) return;
+
+    Socket::close(sock);
+    mStreams.erase(it);
+    mClosingSockets--;
+}
+
+/**
+ *
+ * Drop a request. One the kernel already has is cancelled and keeps its buffer until it comes back,
+ * the cancel goes out with the next submit()
+ *
+ * @param stream
+ * @param slot
+ */
+void UringTransport::cancelSlot(Stream& stream, int slot) {
+    Slot& s = mSlots[slot];
+
+    if (!s.inKernel) {
+        mReady.erase(std::remove(mReady.begin(), mReady.end(), slot), mReady.end());
+        freeSlot(slot);
+        return;
+    }
+
+    s.next = -1;
+    s.detached = true;
+    stream.detached++;
+
+#if defined(MP_HAS_LIBURING)
+    io_uring_sqe* sqe = io_uring_get_sqe(mRing);
+    if (!sqe) {
+        submit();
+        sqe = io_uring_get_sqe(mRing);
+    }
+    if (sqe) {
+        io_uring_prep_cancel64(sqe, static_cast<uint64_t>(slot), 0);
+        io_uring_sqe_set_data64(sqe, CANCEL_DATA);
+        mPending++;
+    }
+#endif
+}
+
+// drop every send of a stream
+void UringTransport::cancelSends(Stream& stream) {
+    for (int slot = stream.head; slot >= 0;) {
+        const int next = mSlots[slot].next;
+        cancelSlot(stream, slot);
+        slot = next;
+    }
+
+    stream.head = -1;
+    stream.tail = -1;
+}
+
+/**
+ *
+ * Put a send or receive into the submission queue. Nothing reaches the kernel before submit()
+ *
+ * @param slot
+ * @return false if the submission queue is full
+ */
+bool UringTransport::queueSlot(int slot) {
+#if defined(MP_HAS_LIBURING)
+    io_uring_sqe* sqe = io_uring_get_sqe(mRing);
+    if (!sqe) return false;
+
+    Slot& s = mSlots[slot];
+    const int fd = static_cast<int>(s.sock.handle);
+
+    if (s.receive) {
+        io_uring_prep_read_fixed(sqe, fd, bufferOf(slot), mBufferSize, 0, slot);
+    } else {
+        io_uring_prep_write_fixed(sqe, fd, bufferOf(slot) + s.offset, s.length - s.offset, 0, slot);
+    }
+    io_uring_sqe_set_data64(sqe, static_cast<uint64_t>(slot));
+
+    s.inKernel = true;
+    mPending++;
+    return true;
+#else
+    (void)slot;
+    return false;
+#endif
+}
+
+// everything in mReady that fits into the submission queue, the rest stays for the next round
+void UringTransport::queueReady() {
+    size_t queued = 0;
+    while (queued < mReady.size() && queueSlot(mReady[queued])) queued++;
+    mReady.erase(mReady.begin(), mReady.begin() + static_cast<std::ptrdiff_t>(queued));
+}
+
+/**
+ *
+ * Reserve a registered buffer for an outgoing send. The caller writes exactly length bytes into it before the
+ * next submit(). Sends of one socket leave in the order they were prepared
+ *
+ * @param sock
+ * @param length
+ * @return the buffer to write into, nullptr if the pool is exhausted or length does not fit
+ */
+uint8_t* UringTransport::prepareSend(Socket sock, int length) {
+    if (!mRing || length <= 0 || length > mBufferSize) return nullptr;
+
+    int slot = acquireSlot();
+    if (slot < 0) return nullptr;
+
+    Slot& s = mSlots[slot];
+    s = Slot{};
+    s.used = true;
+    s.sock = sock;
+    s.length = length;
+    mInflightSends++;
+
+    Stream& stream = mStreams[sock.handle];
+    if (stream.head < 0) {
+        stream.head = slot;
+        mReady.push_back(slot);
+    } else {
+        mSlots[stream.tail].next = slot;
+    }
+    stream.tail = slot;
+
+    return bufferOf(slot);
+}
+
+/**
+ *
+ * Keep a read in the kernel for this socket from the next submit() on, until it is closed or hung up
+ *
+ * @param sock
+ * @param key handed back with every receive completion
+ * @return false if every receive buffer is taken
+ */
+bool UringTransport::startReceive(Socket sock, uint64_t key) {
+    if (!mRing) return false;
+
+    Stream& stream = mStreams[sock.handle];
+    if (stream.receive >= 0) return true;
+    if (mFreeReceives.empty()) return false;
+
+    const int slot = mFreeReceives.back();
+    mFreeReceives.pop_back();
+
+    Slot& s = mSlots[slot];
+    s = Slot{};
+    s.used = true;
+    s.receive = true;
+    s.sock = sock;
+    s.key = key;
+
+    stream.receive = slot;
+    mReady.push_back(slot);
+    return true;
+}
+
+/**
+ *
+ * Hand every ready send and receive to the kernel. Meant to be called once per tick, only submits more than once
+ * when there are more ready requests than submission queue entries
+ *
+ * @return number of requests submitted, negative errno on failure
+ */
+int UringTransport::submit() {
+#if defined(MP_HAS_LIBURING)
+    if (!mRing) return 0;
+
+    int total = 0;
+    while (true) {
+        queueReady();
+        if (mPending == 0) break;
+
+        mSubmitCalls++;
+        const int res = io_uring_submit(mRing);
+        if (res <= 0) return total > 0 ? total : res;
+
+        mPending -= res;
+        total += res;
+        if (mReady.empty()) break;
+    }
+    return total;
+#else
+    return 0;
+#endif
+}
+
+/**
+ *
+ * Go through the completion queue. A short or would-block send is queued again for its tail and only reported
+ * once it completed or failed. A receive that got data keeps its buffer until reap() handed it out
+ *
+ * @param out completions are appended to this
+ */
+void UringTransport::collect(std::vector<Completion>& out) {
+#if defined(MP_HAS_LIBURING)
+    unsigned head;
+    unsigned seen = 0;
+    io_uring_cqe* cqe;
+    io_uring_for_each_cqe(mRing, head, cqe) {
+        seen++;
+
+        const uint64_t data = io_uring_cqe_get_data64(cqe);
+        if (data >= mSlots.size()) continue;
+
+        const int slot = static_cast<int>(data);
+        Slot& s = mSlots[slot];
+        if (!s.used || !s.inKernel) continue;
+        s.inKernel = false;
+
+        if (s.detached) {
+            releaseDetached(slot);
+            continue;
+        }
+
+        const int res = cqe->res;
+        if (s.receive) {
+            if (res == -EAGAIN) {
+                mReady.push_back(slot);
+                continue;
+            }
+
+            out.push_back(Completion{s.sock, res, true, s.key, res > 0 ? bufferOf(slot) : nullptr});
+            if (res > 0) continue;
+
+            // hung up or failed, the owner closes the socket
+            mStreams[s.sock.handle].receive = -1;
+            freeSlot(slot);
+            continue;
+        }
+
+        if (res == -EAGAIN || (res > 0 && s.offset + res < s.length)) {
+            if (res > 0) s.offset += res;
+            mReady.push_back(slot);
+            continue;
+        }
+
+        const bool failed = res <= 0;
+        out.push_back(Completion{s.sock, failed ? (res < 0 ? res : -EPIPE) : s.length, false, 0, nullptr});
+        finishSend(slot, failed);
+    }
+    io_uring_cq_advance(mRing, seen);
+#else
+    (void)out;
+#endif
+}
+
+/**
+ *
+ * Collect finished sends and receives without blocking. The reads of the receives handed out here go back to
+ * the kernel with the next submit(), their data has to be used before that
+ *
+ * @param out completions are appended to this
+ * @return number of completions appended
+ */
+int UringTransport::reap(std::vector<Completion>& out) {
+    if (!mRing) return 0;
+
+    const size_t before = out.size();
+
+    out.insert(out.end(), mDeferred.begin(), mDeferred.end());
+    mDeferred.clear();
+    collect(out);
+
+    for (size_t i = before; i < out.size(); i++) {
+        const Completion& c = out[i];
+        if (!c.receive || c.result <= 0) continue;
+
+        auto it = mStreams.find(c.sock.handle);
+        if (it != mStreams.end() && it->second.receive >= 0) mReady.push_back(it->second.receive);
+    }
+
+    return static_cast<int>(out.size() - before);
+}
+
+/**
+ *
+ * Submit, then block for at most timeoutMs until something completes. Completions go to mDeferred
+ *
+ * @param timeoutMs
+ */
+void UringTransport::waitOnce(double timeoutMs) {
+#if defined(MP_HAS_LIBURING)
+    submit();
+
+    const long long ns = static_cast<long long>(std::max(timeoutMs, 0.0) * 1e6);
+    __kernel_timespec timeout{};
+    timeout.tv_sec = ns / 1000000000LL;
+    timeout.tv_nsec = ns % 1000000000LL;
+
+    io_uring_cqe* cqe = nullptr;
+    io_uring_wait_cqe_timeout(mRing, &cqe, &timeout);
+
+    collect(mDeferred);
+#else
+    (void)timeoutMs;
+#endif
+}
+
+/**
+ *
+ * Wait until every queued send completed, at most URING_DRAIN_TIMEOUT_MS. What the kernel still has after that
+ * is cancelled, so a peer that stopped reading can not hold this up. Completions are handed out by the next reap(),
+ * receives stay armed
+ *
+ */
+void UringTransport::drainSends() {
+    if (!mRing) return;
+
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    auto remainingMs = [&]() {
+        return URING_DRAIN_TIMEOUT_MS - std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    while (mInflightSends > 0 && remainingMs() > 0) waitOnce(remainingMs());
+    if (mInflightSends == 0) return;
+
+    for (auto& [handle, stream] : mStreams) cancelSends(stream);
+
+    // cancelled sends complete right away, their buffers are free again afterwards
+    const auto cancelled = Clock::now();
+    while (mInflightSends > 0 &&
+           std::chrono::duration<double, std::milli>(Clock::now() - cancelled).count() < URING_DRAIN_TIMEOUT_MS) {
+        waitOnce(URING_DRAIN_TIMEOUT_MS);
+    }
+}
+
+/**
+ *
+ * Close a socket without waiting for it. Its receive and its sends that did not complete yet are dropped or
+ * cancelled, the socket itself is closed once the kernel gave back the last of them, which a later reap() sees.
+ * Nothing of the socket is reported anymore
+ *
+ * @param sock
+ */
+void UringTransport::closeSocket(Socket sock) {
+    auto it = mStreams.find(sock.handle);
+    if (it == mStreams.end()) {
+        Socket::close(sock);
+        return;
+    }
+
+    Stream& stream = it->second;
+    if (stream.closing) return;
+
+    cancelSends(stream);
+    if (stream.receive >= 0) {
+        cancelSlot(stream, stream.receive);
+        stream.receive = -1;
+    }
+
+    // whatever was already collected for it goes away too
+    mDeferred.erase(std::remove_if(mDeferred.begin(), mDeferred.end(), [&](const Completion& c) {
+        return c.sock.handle == sock.handle;
+    }), mDeferred.end());
+
+    if (stream.detached > 0) {
+        stream.closing = true;
+        mClosingSockets++;
+        return;
+    }
+
+    Socket::close(sock);
+    mStreams.erase(it);
+}
+
+bool UringTransport::sending(Socket sock) const {
+    auto it = mStreams.find(sock.handle);
+    return it != mStreams.end() && it->second.head >= 0;
+}